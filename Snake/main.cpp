@@ -13,15 +13,36 @@
 
 #include <Windows.h>
 #include <CommCtrl.h>
+#include <shellapi.h>
 #include <tchar.h>
 #include <vector>
 #include <limits>
-#include <random>
 #include <ctime>
+#include <cwchar>
+#include <cwctype>
+#include <cerrno>
 #include <memory>
 #include <algorithm>
 #include <numeric>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "resource.h"
+#include "../SnakeCore/SnakeCore.h"
+#include "../SnakeCore/Planner.h"
+#include "../SnakeCore/Mcts.h"
+#include "../SnakeCore/Replay.h"
+#include "../SnakeCore/Scores.h"
+#include "../SnakeCore/ScoreJournal.h"
+#include "../SnakeCore/Leaderboard.h"
+#include "../SnakeCore/Render.h"
+#include "../SnakeCore/Scheduler.h"
+#include "../SnakeCore/Input.h"
+#include "../SnakeCore/LockFree.h"
+#include "../SnakeCore/Metrics.h"
+#include "../SnakeCore/MetricsServer.h"
+#include "../SnakeCore/Trace.h"
 
 enum class Error 
 { 
@@ -78,121 +99,204 @@ struct AppGuard
     HandleManager mutex;
 };
 
-template<typename T>
-class RandGen
+struct ToolBar
 {
-public:
-    RandGen(T minVal = 0, T maxVal = std::numeric_limits<T>::max()) : defEngine((uint32_t)time(0)), intDistr(minVal, maxVal) {}
-    T operator () () { return intDistr(defEngine); }
+    enum ImgInd { OptImg, NewGameImg, UnpauseImg, PauseImg, AutopilotImg, CountImg };
+    ToolBar() = default;
+    ToolBar(DWORD style, int x, int y, int w, int h, HWND parent, UINT id, HINSTANCE hInst, UINT imgId);
+    void Destroy();
 
-private:
-    std::default_random_engine defEngine;
-    std::uniform_int_distribution<T> intDistr;
+    HWND hToolBar = nullptr;
+    HWND hStaticScore = nullptr;
+    HIMAGELIST hImgList = nullptr;
 };
 
-class Timer
+// What the window shows of the game, published by the simulation after every tick and command
+struct GameSnapshot
 {
-public:
-    Timer();
-    void Tick();
-    void Reset();
-    double Elapsed() const;
+    // Totals of the MCTS autopilot as of its last decision, threads is 0 when it isn't steering
+    struct Search
+    {
+        uint32_t threads = 0;
+        uint64_t rollouts = 0;
+        double seconds = 0;
+        uint64_t lookups = 0;
+        uint64_t hits = 0;
+    };
 
-private:
-    double freq;
-    LARGE_INTEGER startPoint;
-    LARGE_INTEGER curr;
+    Game game;
+    bool running = false;
+    bool paused = false;
+    Search search;
 };
 
-class Snake
+// A snapshot as it crosses to the window: the game as Game::Snapshot writes it, that is the size, the segments from
+// tail to head, the food and the score. Each slot of the triple buffer keeps its buffer, so publishing copies the
+// snake and allocates only when it outgrows every earlier one.
+struct PublishedSnapshot
 {
-public:
-    enum Direction { UP, DOWN, RIGHT, LEFT };
-
-    Snake();
-    ~Snake();
-
-    void Reset(uint32_t fieldWidth, uint32_t fieldHeight);
-    Direction GetDirection() const;
-    void SetDirection(Direction d);
-    POINT GetHead() const;
-    uint32_t BodySize() const;
-    void Eat();
-    bool Move(uint32_t fieldWidth, uint32_t fieldHeight);
-    bool IsValidDirection(Direction dir) const;
-    bool IsBody(POINT testPoint) const;
-    void Draw(HDC hdc) const;
-    const std::vector<POINT>& Body() const;
+    std::vector<uint8_t> game;
+    bool running = false;
+    bool paused = false;
+    GameSnapshot::Search search;
+};
 
-private:
-    void DrawBlock(HDC hdc, POINT p, int imgInd) const;
-    Direction GetDirection(POINT p1, POINT p2) const;
+// How a game ended, posted to the window with WM_GAME_OVER, which takes ownership
+struct GameOver
+{
+    enum Reason { Died, Won, ReplayEnded, FastForwarded };
 
-private:
-    std::vector<POINT> body;
-    HIMAGELIST hImgList = nullptr;
-    uint32_t headInd = (uint32_t)-1;
-    Direction dir = Direction::UP;
-    bool foodEaten = false;
+    Reason reason = Died;
+    uint32_t score = 0;
+    Replay replay;  // the game as played, empty when a replay was played back
 };
 
-class Food
+// A request of the window to the simulation, the fields past type belong to the types noted
+struct GameCommand
+{
+    enum Type { NewGame, SetPaused, Turn, SetStep, SetAutopilot, FastForward };
+
+    Type type;
+    uint32_t width;        // NewGame
+    uint32_t height;
+    bool on;               // SetPaused, SetAutopilot
+    bool mcts;             // SetAutopilot: MCTS rather than the path planner
+    Snake::Direction dir;  // Turn, pressed at time on the SteadyTickClock
+    int64_t time;
+    double step;           // SetStep, seconds
+};
+
+// Decides the autopilot's next move on a thread of its own while the current tick elapses. The game goes over as a
+// Game::Snapshot into a buffer kept from plan to plan and is restored into a game the thread keeps, so neither side
+// allocates unless the snake outgrows every earlier one.
+class PlanWorker
 {
 public:
-    Food();
-    ~Food();
-    POINT GetPos() const;
-    void SetPos(POINT p);
-    void Draw(HDC hdc) const;
+    PlanWorker() = default;
+    PlanWorker(const PlanWorker&) = delete;
+    PlanWorker& operator = (const PlanWorker&) = delete;
+    ~PlanWorker();
+
+    // Starts planning the move of policy in game, a plan still pending must have been taken
+    void Start(Policy* policy, const Game& game);
+    // A plan was started and not taken yet
+    bool Pending() const;
+    // Waits for the pending plan to finish and returns its move
+    Snake::Direction Take();
 
 private:
-    HBITMAP hBitMap = nullptr;
-    POINT pos;
+    void ThreadProc();
+
+    std::mutex guard;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<uint8_t> state;  // of the game to plan in
+    Policy* policy = nullptr;
+    Snake::Direction move = Snake::UP;
+    bool requested = false;
+    bool ready = false;
+    bool quit = false;
+    bool pending = false;        // caller's own
+    Game game;                   // the thread's own
+    std::thread thread;          // started by the first plan
 };
 
-struct ToolBar
+// Runs the game on a thread of its own, so modal dialogs, message boxes and slow paints of the window don't stall
+// the ticks. The window sends commands through a lock-free queue and reads the game from snapshots published through
+// a triple buffer, neither side ever waits for the other. The window learns of a new snapshot from WM_GAME_SNAPSHOT,
+// at most one of them is posted until it takes the snapshot.
+class Simulation
 {
-    enum ImgInd { OptImg, NewGameImg, UnpauseImg, PauseImg, CountImg };
-    ToolBar() = default;
-    ToolBar(DWORD style, int x, int y, int w, int h, HWND parent, UINT id, HINSTANCE hInst, UINT imgId);
-    void Destroy();
+public:
+    // playback is the replay to play back rather than new games, it must outlive the simulation, and so must metrics
+    Simulation(HWND hNotify, uint64_t sessionSeed, const Replay* playback, double step, Metrics& metrics);
+    Simulation(const Simulation&) = delete;
+    Simulation& operator = (const Simulation&) = delete;
+    ~Simulation();
+
+    // Window side
+    void Post(const GameCommand& cmd);
+    // Takes the latest snapshot, false if none was published since the last call
+    bool Refresh();
+    const GameSnapshot& Latest() const;
 
-    HWND hToolBar = nullptr;
-    HWND hStaticScore = nullptr;
-    HIMAGELIST hImgList = nullptr;
+private:
+    void ThreadProc();
+    void Execute(const GameCommand& cmd);
+    void Tick();
+    void End(GameOver::Reason reason);
+    void Publish();
+    void PlanNextMove();
+    void CancelPlanning();
+
+private:
+    HWND hNotify;
+    HandleManager hWake;   // set for every command and to quit
+    HandleManager hTimer;  // due at the next tick
+    std::atomic<bool> quit{ false };
+    std::atomic<bool> notified{ false };  // a WM_GAME_SNAPSHOT is on its way to the window
+    SpscQueue<GameCommand, 64> commands;
+    TripleBuffer<PublishedSnapshot> snapshots;
+    GameSnapshot latest;  // the window's own, restored from the snapshot it took last
+    Metrics& metrics;  // the simulation writes every phase but Paint
+
+    // The rest belongs to the simulation thread
+    Game game;
+    Replay replay;  // the game being played
+    std::unique_ptr<ReplayPlayer> player;  // set when playing a replay back
+    RandGen seeder;  // session generator, every new game takes its seed from it
+    uint64_t sessionSeed;
+    TickScheduler scheduler;  // ticks of the game, step apart
+    TurnQueue turns{ 0 };  // arrow keys waiting for their ticks, the age limit follows step
+    std::unique_ptr<Policy> autopilot;  // steers the snake while set
+    MctsPolicy* mcts = nullptr;  // the autopilot when it searches by MCTS
+    PlanWorker planner;  // autopilot decision for the next tick, computed while the current one elapses
+    GameSnapshot::Search search;  // read from mcts only while no search runs
+    double step;
+    bool running = false;
+    bool paused = false;
+
+    std::thread thread;  // last, it starts once everything above is constructed
 };
 
 class App
 {
 private:
-    static const uint32_t MaxRecordsCount = 10;
+    static const uint32_t MaxRecordsCount = 10;  // rows of the champions table of a field
+    static const uint32_t MaxNameLength = 15;
+    // Every score in the order of the journal, read in place. The id of a score on the board is its offset in saved,
+    // the ones made since start follow on in added.
     struct ScoresData
     {
-        struct Record
-        {
-            static const uint32_t MaxRecordStrLen = 40;
-            uint32_t width = 0;
-            uint32_t height = 0;
-            uint32_t score = 0;
-            uint32_t nameLength = 0;
-            uint32_t recordLength = 0;
-            std::unique_ptr<TCHAR[]> name;
-            std::unique_ptr<TCHAR[]> recordStr;
-
-            void  BuildRecordStr(bool bEmpty);
-            void* ReadRecord(void* pMem);
-            void* WriteRecord(void* pMem);
-        };
-        typedef std::unique_ptr<Record> RecordPtr;
-        uint32_t nRecords;
-        RecordPtr records[MaxRecordsCount];
+        ScoreView saved;     // the journal mapped at start, or the resource table of an old game being taken over
+        ScoreBuilder added;
+
+        ScoresData() = default;
+        ScoresData(const ScoresData&) = delete;
+        ScoresData& operator = (const ScoresData&) = delete;
+        ~ScoresData();
+
+        bool Get(uint32_t id, ScoreEntry& entry) const;
+        // Builds the board over the scores loaded so far on a thread of its own, so start-up only maps the journal.
+        // Nothing may touch the scores until Board returns.
+        void StartIndexing();
+        // The board over every score. Waits for the build, which is done long before the first game ends unless the
+        // journal is huge.
+        Leaderboard& Board();
+
+    private:
+        void Index();
+
+    private:
+        Leaderboard board;
+        std::thread indexer;
     };
 
 public:
     static HINSTANCE AppInstance();
     static App* GetApp();
 
-    App(HINSTANCE hInstance, LPTSTR lpCmdLine, int showCmd);
+    App(HINSTANCE hInstance, int showCmd);
     App(const App&) = delete;
     App(App&&) = default;
     App& operator = (const App&) = delete;
@@ -207,30 +311,37 @@ private:
     static INT_PTR CALLBACK ScoresDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
     static INT_PTR CALLBACK PlayerNameInputDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
-    BOOL SaveScoresData();
-    BOOL CreateScoresSaverExe();
-    BOOL LaunchScoresSaverExe();
-    BOOL SendDataToScoresSaver(HandleManager& pipe);
-    BOOL DeleteScoresSaverExe(LPCTSTR cmdLine);
+    BOOL SaveReplay(const Replay& record, uint32_t score) const;
+    BOOL LoadReplay(LPCTSTR fileName);
 
     LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
     void CreateMainWindow(int showCmd);
-    void EndGame();
+    void EndGame(const GameOver& over);
     bool LoadScoresData();
     void NewGame();
     void Options();
-    void OutScore() const;
+    void OutScore();
     void Pause();
-    void Records(bool bPushRecord);
+    void Records(uint32_t newScore);
+    void AddScore(uint32_t score, HWND hNameOwner);
+    bool IsRecordScore(uint32_t score) const;
     ATOM RegisterWindowClass();
     void ResizeGameArea(uint32_t w, uint32_t h);
-    void SpawnFood();
-    void Update();
+    void ScrollView();
+    void LoadFieldTiles();
+    void CreateFieldBitmap();
+    void DestroyFieldBitmap();
+    void RedrawField();
+    void TakeSnapshot();
+    void SetTimeStep(double step);
+    void ToggleAutopilot();
+    void SwitchAutopilot();
+    void UpdateTitle();
+    void FastForward();
+    void ToggleTrace();
 
-    int  KeyPressed(int vKey) const;
     void OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT code);
-    void OnKeyboardInput();
     void OnKeyDown(HWND hwnd, UINT vk, BOOL fDown, int cRepeat, UINT flags);
     void OnNotify(HWND hwnd, int id, LPNMHDR phdr);
     void OnPaint();
@@ -245,16 +356,33 @@ private:
     uint32_t vertIndent = 0;
     uint32_t width = 10;
     uint32_t height = 10;
-    uint32_t score = 0;
-
-    std::unique_ptr<Snake> snake;
-    std::unique_ptr<Food> food;
-    std::unique_ptr<Timer> timer;
+    // Fields larger than MaxViewWidth x MaxViewHeight are shown through a viewport kept centred on the head
+    uint32_t viewWidth = 10;
+    uint32_t viewHeight = 10;
+    Point viewOrigin = { 0, 0 };
+
+    // The field is drawn by the renderer straight into a DIB section kept selected into hFieldDC,
+    // OnPaint copies out the parts that need it
+    std::unique_ptr<FieldRenderer> field;
+    HDC hFieldDC = nullptr;
+    HBITMAP hFieldBM = nullptr;
+    HGDIOBJ hOldFieldBM = nullptr;
     std::unique_ptr<ScoresData> scoresData;
+    std::unique_ptr<ScoreJournal> journal;  // every score ever made, scoresData indexes them
+    Replay replay;  // the one played back when the app was started with -r file
+    Metrics metrics;  // timing of the session, D and exit write it to MetricsFileName
+    std::unique_ptr<MetricsServer> metricsServer;  // set when started with -m port
+    std::unique_ptr<Simulation> sim;  // plays the game, after replay so it stops before the replay goes
+    uint32_t shownScore = UINT32_MAX;
+
+    uint64_t sessionSeed = 0;
 
+    // What the window asked of the simulation, the snapshots tell what came of it
     bool running = false;
     bool paused = false;
-    bool scoresChanged = false;
+    bool playback = false;  // playing replay back
+    bool autopilotOn = false;
+    bool useMcts = false;  // the autopilot is the MCTS player rather than the path planner
 
     double speed = 0.3;
     double timeStep = 0.3;
@@ -263,57 +391,50 @@ private:
 App* App::pApp = nullptr;
 HINSTANCE App::hInst = nullptr;
 
-constexpr LPCTSTR PipeName = _T("\\\\.\\pipe\\SnakeGamePipe");
 constexpr LPCTSTR SnakeGameMutexName = _T("SnakeGameGuardMutex");
-constexpr LPCTSTR ScoresSaverExeName = _T("_SnakeGameEmbeddedExecutable.exe");
+constexpr double MctsBudgetShare = 0.5;  // part of every tick the MCTS autopilot spends searching
+constexpr int64_t TurnMaxAgeTicks = 3;  // a queued turn not applied within this many ticks is dropped
+constexpr UINT WM_GAME_SNAPSHOT = WM_APP + 1;  // the simulation published a snapshot
+constexpr UINT WM_GAME_OVER = WM_APP + 2;      // lParam is the GameOver, owned by the receiver
+constexpr char ScoresFileName[] = "Snake.scores";
+constexpr char MetricsFileName[] = "Snake-metrics.json";  // D or exit writes it
+constexpr char TraceFileName[] = "Snake-trace.json";  // T or exit writes it while tracing
 
 constexpr DWORD MainWindowStyle = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX;
-constexpr int nButtons = 3;
+constexpr int nButtons = 4;
 constexpr int BtnSize = 24;
 constexpr uint32_t BlockSize = 24;
-constexpr uint32_t MinWidth = 8;
-constexpr uint32_t MinHeight = 8;
-constexpr uint32_t MaxWidth = 32;
-constexpr uint32_t MaxHeight = 32;
-constexpr COLORREF BkColor = RGB(192, 192, 192);
+constexpr uint32_t MaxViewWidth = 32;
+constexpr uint32_t MaxViewHeight = 32;
+constexpr uint32_t BkPixel = 0xFFC0C0C0;  // field background, RGB(192, 192, 192) as a pixel of the field renderer
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002  // Windows 10 1803 and later, older SDKs lack it
+#endif
+
+inline int64_t StepNs(double seconds) { return (int64_t)(seconds * 1e9); }
+
+// A whole command line argument as a decimal number, false if anything else is in it
+inline bool ParseNumber(LPCWSTR arg, unsigned long long& value)
+{
+    wchar_t* end = nullptr;
+    errno = 0;
+    value = wcstoull(arg, &end, 10);
+    return iswdigit(*arg) && !*end && errno == 0;
+}
 
 AppGuard appGuard(SnakeGameMutexName);
 
 //########################################################################################################################
 
-inline bool operator == (const POINT& p1, const POINT& p2) { return p1.x == p2.x && p1.y == p2.y; }
-inline bool operator != (const POINT& p1, const POINT& p2) { return !(p1 == p2); }
-
-int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE, LPTSTR lpCmdLine, int nShowCmd)
+int WINAPI _tWinMain(HINSTANCE hInstance, HINSTANCE, LPTSTR, int nShowCmd)
 {
     if(!appGuard.mutex)
         return 0;
-    App app(hInstance, lpCmdLine, nShowCmd);
+    App app(hInstance, nShowCmd);
     return app.Run();
 }
 
-// Timer class methods ------------------------------------------------------------------------------------------------
-Timer::Timer()
-{
-    LARGE_INTEGER li;
-    QueryPerformanceFrequency(&li);
-    freq = static_cast<double>(li.QuadPart);
-    Reset();
-}
-inline void Timer::Tick() 
-{
-    QueryPerformanceCounter(&curr);
-}
-inline void Timer::Reset() 
-{
-    QueryPerformanceCounter(&startPoint);
-    curr.QuadPart = startPoint.QuadPart;
-}
-inline double Timer::Elapsed() const 
-{
-    return static_cast<double>(curr.QuadPart - startPoint.QuadPart) / freq; 
-}
-
 // Toolbar struct methods ------------------------------------------------------------------------------------------------
 ToolBar::ToolBar(DWORD style, int x, int y, int w, int h, HWND parent, UINT id, HINSTANCE hInst, UINT imgId)
 {
@@ -331,7 +452,8 @@ ToolBar::ToolBar(DWORD style, int x, int y, int w, int h, HWND parent, UINT id,
     {
         { 0, ID_OPT_BTN,      TBSTATE_ENABLED, BTNS_BUTTON | BTNS_NOPREFIX | BTNS_AUTOSIZE, {0}, 0, 0 },
         { 1, ID_NEW_GAME_BTN, TBSTATE_ENABLED, BTNS_BUTTON | BTNS_NOPREFIX | BTNS_AUTOSIZE, {0}, 0, 0 },
-        { 2, ID_PAUSE_BTN,    TBSTATE_ENABLED, BTNS_BUTTON | BTNS_NOPREFIX | BTNS_AUTOSIZE, {0}, 0, 0 }
+        { 2, ID_PAUSE_BTN,    TBSTATE_ENABLED, BTNS_BUTTON | BTNS_NOPREFIX | BTNS_AUTOSIZE, {0}, 0, 0 },
+        { 4, ID_AUTOPILOT_BTN, TBSTATE_ENABLED, BTNS_CHECK | BTNS_NOPREFIX | BTNS_AUTOSIZE, {0}, 0, 0 }
     };
 
     SendMessage(hToolBar, TB_BUTTONSTRUCTSIZE, (WPARAM)sizeof(TBBUTTON), 0);
@@ -340,7 +462,7 @@ ToolBar::ToolBar(DWORD style, int x, int y, int w, int h, HWND parent, UINT id,
     SendMessage(hToolBar, TB_AUTOSIZE, 0, 0);
 
     RECT rc;
-    SendMessage(hToolBar, TB_GETRECT, ID_PAUSE_BTN, (LPARAM)&rc);
+    SendMessage(hToolBar, TB_GETRECT, ID_AUTOPILOT_BTN, (LPARAM)&rc);
 
     hStaticScore = CreateWindowEx(0, WC_STATIC, _T("SCORE: 0"),
         WS_CHILD | WS_VISIBLE |  SS_LEFTNOWORDWRAP | SS_CENTERIMAGE, 
@@ -356,123 +478,307 @@ inline void ToolBar::Destroy()
     ImageList_Destroy(hImgList);
 }
 
-// Snake class methods ------------------------------------------------------------------------------------------------
-Snake::Snake()
+// PlanWorker class methods ------------------------------------------------------------------------------------------------
+PlanWorker::~PlanWorker()
 {
-    constexpr int ImgCnt = 9;
-
-    HBITMAP hSnakeBM = (HBITMAP)LoadImage(App::AppInstance(), MAKEINTRESOURCE(IDB_SNAKE_FULL), IMAGE_BITMAP, BlockSize * ImgCnt, BlockSize, 0);
-    HBITMAP hSnakeBMMask = (HBITMAP)LoadImage(App::AppInstance(), MAKEINTRESOURCE(IDB_SNAKE_FULL), IMAGE_BITMAP, BlockSize * ImgCnt, BlockSize, LR_MONOCHROME);
-
-    hImgList = ImageList_Create(BlockSize, BlockSize, ILC_COLOR32 | ILC_MASK, ImgCnt, 0);
-    ImageList_SetBkColor(hImgList, BkColor);
-    ImageList_Add(hImgList, hSnakeBM, hSnakeBMMask);
-
-    DeleteObject(hSnakeBM);
-    DeleteObject(hSnakeBMMask);
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        quit = true;
+    }
+    wake.notify_one();
+    if(thread.joinable())
+        thread.join();
 }
-Snake::~Snake() { ImageList_Destroy(hImgList); }
-inline Snake::Direction Snake::GetDirection() const { return dir; }
-inline void Snake::SetDirection(Direction d) { dir = d; }
-inline POINT Snake::GetHead() const { return body[headInd]; }
-inline const std::vector<POINT>& Snake::Body() const { return body; }
-inline uint32_t Snake::BodySize() const { return body.size(); }
-inline void Snake::Eat() { foodEaten = true; }
-inline void Snake::DrawBlock(HDC hdc, POINT p, int imgInd) const
-{
-    ImageList_Draw(hImgList, imgInd, hdc, p.x * BlockSize, p.y * BlockSize, ILD_NORMAL);
+void PlanWorker::Start(Policy* policy, const Game& game)
+{
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        state.resize(game.SnapshotSize());
+        game.Snapshot(state.data());
+        this->policy = policy;
+        requested = true;
+        ready = false;
+        if(!thread.joinable())
+            thread = std::thread(&PlanWorker::ThreadProc, this);
+    }
+    pending = true;
+    wake.notify_one();
 }
-void Snake::Reset(uint32_t fieldWidth, uint32_t fieldHeight)
+inline bool PlanWorker::Pending() const { return pending; }
+Snake::Direction PlanWorker::Take()
 {
-    body.clear();
-    POINT p = { (LONG)fieldWidth / 2, (LONG)fieldHeight / 2 + 2 };
-    for(int i = 0; i < 4; ++i, --p.y)
-        body.emplace_back(p);
-
-    headInd = body.size() - 1;
-    dir = Direction::UP;
-    foodEaten = false;
+    std::unique_lock<std::mutex> lock(guard);
+    done.wait(lock, [this] { return ready; });
+    ready = false;
+    pending = false;
+    return move;
 }
-bool Snake::Move(uint32_t fieldWidth, uint32_t fieldHeight)
+void PlanWorker::ThreadProc()
 {
-    POINT nextHead = body[headInd];
-    switch(dir)
+    Trace::NameThread("Planner");
+    std::unique_lock<std::mutex> lock(guard);
+    for(;;)
     {
-        case Snake::UP: --nextHead.y; break;
-        case Snake::DOWN: ++nextHead.y; break;
-        case Snake::LEFT: --nextHead.x; break;
-        case Snake::RIGHT: ++nextHead.x; break;
+        wake.wait(lock, [this] { return quit || requested; });
+        if(quit)
+            break;
+        requested = false;
+        // The caller leaves state and policy alone until it has taken the move
+        lock.unlock();
+        game.Restore(state.data());
+        Snake::Direction decided;
+        {
+            TraceSpan span("PlanWorker::Plan");
+            decided = policy->Decide(game);
+        }
+        lock.lock();
+        move = decided;
+        ready = true;
+        done.notify_one();
     }
+}
 
-    if(nextHead.x < 0 || nextHead.x == fieldWidth 
-        || nextHead.y < 0 || nextHead.y == fieldHeight 
-        || IsBody(nextHead))
+// Simulation class methods ------------------------------------------------------------------------------------------------
+Simulation::Simulation(HWND hNotify, uint64_t sessionSeed, const Replay* playback, double step, Metrics& metrics)
+    : hNotify(hNotify), hWake(CreateEvent(nullptr, FALSE, FALSE, nullptr)), metrics(metrics), seeder(sessionSeed),
+      sessionSeed(sessionSeed), scheduler(SteadyTickClock(), StepNs(step)), step(step)
+{
+    // A high resolution timer keeps ticks within a fraction of a millisecond of the grid without raising the system
+    // timer rate; where there is none the plain timer does with its 15 ms
+    hTimer = CreateWaitableTimerEx(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if(!hTimer)
+        hTimer = CreateWaitableTimer(nullptr, FALSE, nullptr);
+    if(!hWake || !hTimer)
+        throw std::bad_alloc();
+    if(playback)
+        player = std::make_unique<ReplayPlayer>(*playback);
+    thread = std::thread(&Simulation::ThreadProc, this);
+}
+Simulation::~Simulation()
+{
+    quit = true;
+    SetEvent(hWake.get());
+    thread.join();
+}
+void Simulation::Post(const GameCommand& cmd)
+{
+    // Far more commands fit than anyone sends between two wake-ups, one that doesn't is dropped
+    if(commands.Push(cmd))
+        SetEvent(hWake.get());
+}
+bool Simulation::Refresh()
+{
+    notified = false;
+    if(!snapshots.Update())
         return false;
+    const PublishedSnapshot& snapshot = snapshots.Front();
+    latest.game.Restore(snapshot.game.data());
+    latest.running = snapshot.running;
+    latest.paused = snapshot.paused;
+    latest.search = snapshot.search;
+    return true;
+}
+inline const GameSnapshot& Simulation::Latest() const { return latest; }
 
-    if(!foodEaten)
+void Simulation::ThreadProc()
+{
+    Trace::NameThread("Simulation");
+    HANDLE handles[] = { hWake.get(), hTimer.get() };
+    while(!quit)
     {
-        headInd = (headInd + 1) % body.size();
-        body[headInd] = nextHead;
+        {
+            TraceSpan span("Simulation::Wake");  // the work of one wake-up, the wait is left out
+            for(GameCommand cmd; commands.Pop(cmd); )
+                Execute(cmd);
+            scheduler.SetStep(StepNs(step));
+            turns.SetMaxAge(TurnMaxAgeTicks * scheduler.Step());
+            scheduler.SetPaused(!running || paused);
+            uint32_t due = scheduler.Due();
+            if(due)
+            {
+                metrics[Phase::TickLateness].Record(scheduler.Lateness());
+                metrics.SetTicks(scheduler.Ticks(), scheduler.Dropped());
+            }
+            for(; due && running && !paused; --due)
+                Tick();
+        }
+
+        // Sleeps until the next tick or a command, paused there is nothing to wake up for but commands
+        int64_t wait = scheduler.Wait();
+        if(wait == 0)
+            continue;
+        DWORD nHandles = 1;
+        if(wait != TickScheduler::Forever)
+        {
+            LARGE_INTEGER due;
+            due.QuadPart = -((wait + 99) / 100);  // relative, in 100 ns units
+            nHandles = SetWaitableTimer(hTimer.get(), &due, 0, nullptr, nullptr, FALSE) ? 2 : 1;
+        }
+        DWORD timeout = (wait == TickScheduler::Forever || nHandles == 2) ? INFINITE : (DWORD)((wait + 999999) / 1000000);
+        WaitForMultipleObjects(nHandles, handles, FALSE, timeout);
     }
-    else
+    CancelPlanning();
+}
+void Simulation::Execute(const GameCommand& cmd)
+{
+    switch(cmd.type)
     {
-        ++headInd;
-        body.insert(body.begin() + headInd, nextHead);
-        foodEaten = false;
+        case GameCommand::NewGame:
+            running = true;
+            paused = true;
+            turns.Clear();
+            CancelPlanning();
+            if(player)
+                player->Start(game);
+            else
+            {
+                game.Reset(cmd.width, cmd.height, seeder.Next64());
+                replay.Begin(game);
+            }
+            scheduler.Restart();
+            break;
+        case GameCommand::SetPaused:
+            if(!running)
+                return;
+            paused = cmd.on;
+            turns.Clear();
+            break;
+        case GameCommand::Turn:
+            if(running && !paused && !autopilot && !player)
+                turns.Push(cmd.dir, cmd.time);
+            return;
+        case GameCommand::SetStep:
+            step = cmd.step;
+            return;
+        case GameCommand::SetAutopilot:
+            if(player)
+                return;
+            CancelPlanning();
+            mcts = nullptr;
+            autopilot.reset();
+            if(cmd.on && cmd.mcts)
+            {
+                auto search = std::make_unique<MctsPolicy>(sessionSeed);
+                mcts = search.get();
+                mcts->SetBudget(step * MctsBudgetShare);
+                autopilot = std::move(search);
+            }
+            else if(cmd.on)
+                autopilot = std::make_unique<Planner>();
+            break;
+        case GameCommand::FastForward:
+            // Jumps to the end of the replay, the last tick shows how the game ended
+            if(player && running)
+            {
+                player->FastForward(game);
+                End(GameOver::FastForwarded);
+            }
+            return;
     }
-    return true;
+    Publish();
 }
-Snake::Direction Snake::GetDirection(POINT p1, POINT p2) const
+void Simulation::Tick()
 {
-    if(p1.x == p2.x)
-        return p1.y < p2.y ? Direction::UP : Direction::DOWN;
+    TraceSpan span("Simulation::Tick");
+    if(player && player->AtEnd())
+    {
+        End(GameOver::ReplayEnded);
+        return;
+    }
+
+    const TickClock& clock = SteadyTickClock();
+    Game::StepResult res;
+    if(player)
+    {
+        int64_t start = clock.Now();
+        res = player->Step(game);
+        int64_t end = clock.Now();
+        metrics[Phase::Simulate].Record(end - start);
+        if(Trace::Enabled())
+            Trace::Record("ReplayPlayer::Step", start, end);  // food included, the player steps whole ticks
+    }
     else
-        return p1.x < p2.x ? Direction::LEFT : Direction::RIGHT;
-}
-bool Snake::IsValidDirection(Direction testDir) const
-{
-    POINT prevHead = body[headInd == 0 ? body.size() - 1 : headInd - 1];
-    return (GetDirection(prevHead, body[headInd]) != testDir);
+    {
+        if(autopilot)
+            game.GetSnake().SetDirection(planner.Pending() ? planner.Take() : autopilot->Decide(game));
+        else if(turns.Apply(game.GetSnake(), clock.Now()))
+            metrics[Phase::InputToMove].Record(turns.Stats().lastLatencyNs);
+        replay.Record(game.GetSnake().GetDirection());
+        int64_t start = clock.Now();
+        res = game.Advance();
+        int64_t moved = clock.Now();
+        metrics[Phase::Simulate].Record(moved - start);
+        if(Trace::Enabled())
+            Trace::Record("Game::Advance", start, moved);
+        if(res == Game::Ate)
+        {
+            game.SpawnFood();
+            int64_t spawned = clock.Now();
+            metrics[Phase::Spawn].Record(spawned - moved);
+            if(Trace::Enabled())
+                Trace::Record("Game::SpawnFood", moved, spawned);
+        }
+    }
+    if(res == Game::Died || res == Game::Won)
+    {
+        End(res == Game::Died ? GameOver::Died : GameOver::Won);
+        return;
+    }
+    Publish();
+    if(autopilot)
+        PlanNextMove();
 }
-bool Snake::IsBody(POINT testPoint) const
+void Simulation::End(GameOver::Reason reason)
 {
-    for(const auto& p : body)
-        if(p == testPoint)
-            return true;
-    return false;
+    running = false;
+    CancelPlanning();
+    Publish();
+    auto over = std::make_unique<GameOver>();
+    over->reason = reason;
+    over->score = game.Score();
+    if(!player)
+        over->replay = replay;
+    if(PostMessage(hNotify, WM_GAME_OVER, 0, (LPARAM)over.get()))
+        over.release();
 }
-void Snake::Draw(HDC hdc) const
+void Simulation::Publish()
 {
-    uint32_t tailInd = (headInd + 1) % body.size();
-
-    for(uint32_t i = 0; i < body.size(); ++i)
+    // The search totals may only be read between searches
+    if(!planner.Pending())
     {
-        if(i != headInd && i != tailInd)
-            DrawBlock(hdc, body[i], 8);
+        search = GameSnapshot::Search();
+        if(mcts)
+        {
+            search.threads = mcts->Threads();
+            search.rollouts = mcts->Rollouts();
+            search.seconds = mcts->SearchSeconds();
+            search.lookups = mcts->TableLookups();
+            search.hits = mcts->TableHits();
+        }
     }
-    Direction tailDir = GetDirection(body[(tailInd + 1) % body.size()], body[tailInd]);
-    DrawBlock(hdc, body[headInd], (int)dir);
-    DrawBlock(hdc, body[tailInd], (int)tailDir + 4);
+    PublishedSnapshot& snapshot = snapshots.Back();
+    snapshot.game.resize(game.SnapshotSize());
+    game.Snapshot(snapshot.game.data());
+    snapshot.running = running;
+    snapshot.paused = paused;
+    snapshot.search = search;
+    snapshots.Publish();
+    if(!notified.exchange(true) && !PostMessage(hNotify, WM_GAME_SNAPSHOT, 0, 0))
+        notified = false;
 }
-
-// Food class methods ------------------------------------------------------------------------------------------------
-Food::Food()
+void Simulation::PlanNextMove()
 {
-    hBitMap = LoadBitmap(App::AppInstance(), MAKEINTRESOURCE(IDB_FOOD));
-    pos.x = pos.y = 0;
+    // The game doesn't change until the next tick, so plan on a copy in the background meanwhile
+    if(mcts)
+        mcts->SetBudget(step * MctsBudgetShare);
+    planner.Start(autopilot.get(), game);
 }
-Food::~Food() { DeleteObject(hBitMap); }
-inline POINT Food::GetPos() const { return pos; }
-inline void Food::SetPos(POINT p) { pos = p; }
-void Food::Draw(HDC hdc) const
+void Simulation::CancelPlanning()
 {
-    HDC dc = CreateCompatibleDC(hdc);
-    HBITMAP old = (HBITMAP)SelectObject(dc, hBitMap);
-
-    TransparentBlt(hdc, pos.x * BlockSize, pos.y * BlockSize, BlockSize, BlockSize, dc, 0, 0, 32, 32, RGB(255, 255, 255));
-
-    SelectObject(dc, old);
-    DeleteDC(dc);
+    if(planner.Pending())
+        planner.Take();
+    if(autopilot)
+        autopilot->Reset();
 }
 
 // App class methods ------------------------------------------------------------------------------------------------
@@ -489,24 +795,44 @@ LRESULT CALLBACK App::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         case WM_KEYDOWN: OnKeyDown(hwnd, (UINT)wParam, TRUE, (int)LOWORD(lParam), (UINT)HIWORD(lParam)); break;
         case WM_KEYUP:
             if(wParam == VK_SPACE)
-                timeStep = speed;
+                SetTimeStep(speed);
             break;
         case WM_NOTIFY: OnNotify(hwnd, (int)wParam, (LPNMHDR)lParam); break;
         case WM_COMMAND: OnCommand(hwnd, LOWORD(wParam), (HWND)lParam, (UINT)HIWORD(wParam)); break;
         case WM_CREATE:
         {
-            toolBar = ToolBar(WS_CHILD | WS_BORDER | TBSTYLE_TOOLTIPS, 0, 0, width * BlockSize, BtnSize, hwnd, ID_TOOLBAR, hInst, IDB_TOOLBAR);
+            toolBar = ToolBar(WS_CHILD | WS_BORDER | TBSTYLE_TOOLTIPS, 0, 0, viewWidth * BlockSize, BtnSize, hwnd, ID_TOOLBAR, hInst, IDB_TOOLBAR);
             RECT rc;
             GetWindowRect(toolBar.hToolBar, &rc);
             vertIndent = rc.bottom - rc.top - 1;
+            sim = std::make_unique<Simulation>(hwnd, sessionSeed, playback ? &replay : nullptr, timeStep, metrics);
             NewGame();
             break;
         }
+        case WM_GAME_SNAPSHOT:
+            TakeSnapshot();
+            RedrawField();
+            break;
+        case WM_GAME_OVER:
+        {
+            std::unique_ptr<GameOver> over((GameOver*)lParam);
+            EndGame(*over);
+            break;
+        }
         case WM_CLOSE:
             toolBar.Destroy();
             DestroyWindow(hwnd);
             break;
-        case WM_DESTROY: PostQuitMessage(0); break;
+        case WM_DESTROY:
+        {
+            sim.reset();
+            // Game overs the window no longer gets to are freed here, the simulation can't post any more of them
+            MSG pending;
+            while(PeekMessage(&pending, hwnd, WM_GAME_OVER, WM_GAME_OVER, PM_REMOVE))
+                delete (GameOver*)pending.lParam;
+            PostQuitMessage(0);
+            break;
+        }
         default: return DefWindowProc(hwnd, msg, wParam, lParam);
     }
     return 0;
@@ -564,60 +890,44 @@ INT_PTR CALLBACK App::OptionsDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPAR
 }
 INT_PTR CALLBACK App::ScoresDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
-    constexpr uint32_t BufferSize = 64;
     static uint32_t newScore;
 
     switch(msg)
     {
         case WM_INITDIALOG:
         {
+            TCHAR caption[64] = { 0 };
+            _stprintf_s(caption, _T("Top %u scores, %ux%u"), MaxRecordsCount, GetApp()->width, GetApp()->height);
+            SetWindowText(hwnd, caption);
             newScore = (uint32_t)lParam;
-            if(!newScore)
-                break;
-
-            uint32_t& nRecords = GetApp()->scoresData->nRecords;
-            auto& records = GetApp()->scoresData->records;
-
-            // create new record
-            auto newRecord = std::make_unique<ScoresData::Record>();
-            newRecord->score = newScore;
-            newRecord->width = GetApp()->width;
-            newRecord->height = GetApp()->height;
-            newRecord->nameLength = DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_NAME_INPUT_DIALOG), hwnd, PlayerNameInputDialogProc, (LPARAM)&newRecord->name);
-            newRecord->BuildRecordStr(false);
-
-            // insert new record
-            auto it1 = (nRecords == 0) ? std::begin(records) :
-                std::find_if(std::begin(records), std::begin(records) + nRecords,
-                    [score = newRecord->score](const ScoresData::RecordPtr& rec){ return rec->score <= score; });
-            if(it1 != std::begin(records) + nRecords)
-                std::move_backward(it1, std::begin(records) + (MaxRecordsCount - 1), std::begin(records) + MaxRecordsCount);
-            *it1 = std::move(newRecord);
-
-            if(nRecords < MaxRecordsCount)
-                ++nRecords;                  
+            if(newScore)
+                GetApp()->AddScore(newScore, hwnd);
             break;
         }
         case WM_PAINT:
-        {         
-            constexpr TCHAR header[] = _T(" N  Name        Field(WxH)  Score\n");
-            constexpr uint32_t headerSize = _countof(header);
-
-            auto& records = GetApp()->scoresData->records;
-            uint32_t recordsTextLen = std::accumulate(std::cbegin(records), std::cend(records), headerSize,
-                [](uint32_t sum, const ScoresData::RecordPtr& rec) {return sum + rec->recordLength; });
-            auto recordsText = std::make_unique<TCHAR[]>(recordsTextLen);
-
-            memcpy(recordsText.get(), header, headerSize * sizeof(TCHAR));
-            std::for_each(std::cbegin(records), std::cend(records),
-                [it = recordsText.get() + headerSize, i = uint32_t(0), end = recordsText.get() + recordsTextLen](const ScoresData::RecordPtr& rec) mutable
+        {
+            // The best of the current field, and where a new score stands among those of all fields
+            ScoresData& scores = *GetApp()->scoresData;
+            uint32_t ids[MaxRecordsCount];
+            size_t nRows = scores.Board().Top(GetApp()->width, GetApp()->height, ids, MaxRecordsCount);
+
+            TCHAR text[1024] = { 0 };
+            int len = _stprintf_s(text, _T(" N  Name        Field(WxH)  Score\n"));
+            for(uint32_t i = 0; i < MaxRecordsCount; ++i)
+            {
+                if(i < nRows)
                 {
-                    TCHAR buf[16];
-                    _stprintf_s(buf, _T("%2u"), ++i);
-                    memcpy(it, rec->recordStr.get(), rec->recordLength * sizeof(TCHAR));
-                    memcpy(it + 1, buf, 2 * sizeof(TCHAR));
-                    it += rec->recordLength;
-                });
+                    ScoreEntry rec = {};
+                    scores.Get(ids[i], rec);
+                    len += _stprintf_s(text + len, _countof(text) - len, _T("\n%2u  %-10.*s  %7ux%-2u  %5u"), i + 1,
+                        (int)std::min(rec.nameLength, 10u), rec.name ? rec.name : _T(""), rec.width, rec.height, rec.score);
+                }
+                else
+                    len += _stprintf_s(text + len, _countof(text) - len, _T("\n%2u  Empty             0x0       0"), i + 1);
+            }
+            if(newScore)
+                len += _stprintf_s(text + len, _countof(text) - len, _T("\n\nYour score: %u\nPlace on all fields: %llu of %llu"), newScore,
+                    (unsigned long long)scores.Board().Rank(newScore), (unsigned long long)scores.Board().Size());
 
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hwnd, &ps);
@@ -626,7 +936,7 @@ INT_PTR CALLBACK App::ScoresDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
             HFONT hFont = CreateFont(-12, 0, 0, 0, 0, 0, 0, 0, RUSSIAN_CHARSET, 0, 0, 0, FIXED_PITCH | FF_MODERN, _T("Consolas"));
             hFont = (HFONT)SelectObject(hdc, hFont);
             RECT rc = { 7, 7, 350, 350 };
-            DrawText(hdc, recordsText.get(), recordsTextLen, &rc, DT_NOPREFIX);
+            DrawText(hdc, text, len, &rc, DT_NOPREFIX);
 
             DeleteObject(SelectObject(hdc, hFont));
             EndPaint(hwnd, &ps);
@@ -636,13 +946,7 @@ INT_PTR CALLBACK App::ScoresDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
         {
             if(wParam == IDOK)
             {
-                if(newScore)
-                {
-                    GetApp()->scoresChanged = true;
-                    EndDialog(hwnd, 1);
-                }
-                else
-                    EndDialog(hwnd, 0);
+                EndDialog(hwnd, newScore ? 1 : 0);
             }
             break;
         }
@@ -653,18 +957,18 @@ INT_PTR CALLBACK App::ScoresDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
 }
 INT_PTR CALLBACK App::PlayerNameInputDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
-    static std::unique_ptr<TCHAR[]> *namePtr = nullptr;
+    static TCHAR *name = nullptr;  // MaxNameLength characters
     switch(msg)
     {
         case WM_INITDIALOG:
-            namePtr = (std::unique_ptr<TCHAR[]>*)lParam;          
+            name = (TCHAR*)lParam;
             PostMessage(hwnd, WM_NEXTDLGCTL, (WPARAM)GetDlgItem(hwnd, IDC_NAME_EDIT), MAKELPARAM(TRUE, 0));
             break;
         case WM_COMMAND:
             if(wParam == IDOK)
             {
-                TCHAR buf[16];
-                uint32_t nCh = GetDlgItemText(hwnd, IDC_NAME_EDIT, buf, 16);
+                TCHAR buf[MaxNameLength + 1];
+                uint32_t nCh = GetDlgItemText(hwnd, IDC_NAME_EDIT, buf, MaxNameLength + 1);
                 if(nCh == 0)
                     goto m;
                 TCHAR *itBeg, *itEnd;
@@ -673,8 +977,7 @@ INT_PTR CALLBACK App::PlayerNameInputDialogProc(HWND hwnd, UINT msg, WPARAM wPar
                     goto m;
                 for(itEnd = buf + nCh - 1; itBeg < itEnd && !_istgraph(*itEnd); --itEnd);
                 nCh = ++itEnd - itBeg;
-                *namePtr = std::make_unique<TCHAR[]>(nCh + 1);
-                memcpy(namePtr->get(), itBeg, nCh * sizeof(TCHAR));
+                memcpy(name, itBeg, nCh * sizeof(TCHAR));
                 EndDialog(hwnd, nCh);
                 break;
 m:
@@ -687,23 +990,66 @@ m:
     return TRUE;
 }
 
-App::App(HINSTANCE hInstance, LPTSTR lpCmdLine, int showCmd)
+App::App(HINSTANCE hInstance, int showCmd)
 {
-    if(_tcsstr(lpCmdLine, _T("-d")))
-    {
-        DeleteScoresSaverExe(lpCmdLine);
-        return;
-    }
-
     if(pApp)
         throw Error::AlreadyExistErr;
 
     pApp = this;
     hInst = hInstance;
 
-    snake = std::make_unique<Snake>();
-    food = std::make_unique<Food>();
-    timer = std::make_unique<Timer>();
+    // Snake [-s seed] [-r replayFile] [-m port] [-t]. Arguments are split by the shell's rules and flags matched
+    // whole, so a value, such as a quoted path with spaces or dashes in it, is never taken for a flag.
+    int argCount = 0;
+    std::unique_ptr<LPWSTR, HLOCAL(WINAPI*)(HLOCAL)> args(CommandLineToArgvW(GetCommandLineW(), &argCount), LocalFree);
+    LPCWSTR seedArg = nullptr, replayArg = nullptr, metricsArg = nullptr;
+    bool trace = false;
+    for(int i = 1; args && i < argCount; ++i)
+    {
+        LPCWSTR arg = args.get()[i], value = (i + 1 < argCount) ? args.get()[i + 1] : nullptr;
+        if(!wcscmp(arg, L"-t"))
+            trace = true;
+        else if(!value)
+            break;
+        else if(!wcscmp(arg, L"-s"))
+            seedArg = args.get()[++i];
+        else if(!wcscmp(arg, L"-r"))
+            replayArg = args.get()[++i];
+        else if(!wcscmp(arg, L"-m"))
+            metricsArg = args.get()[++i];
+    }
+
+    unsigned long long seed = 0;
+    if(seedArg && ParseNumber(seedArg, seed))
+        sessionSeed = seed;
+    else
+    {
+        LARGE_INTEGER li;
+        QueryPerformanceCounter(&li);
+        sessionSeed = ((uint64_t)time(0) << 32) ^ (uint64_t)li.QuadPart;
+    }
+
+    if(replayArg && LoadReplay(replayArg))
+    {
+        playback = true;
+        width = replay.Width();
+        height = replay.Height();
+    }
+
+    unsigned long long port = 0;
+    if(metricsArg && ParseNumber(metricsArg, port) && port <= 0xFFFF)
+    {
+        metricsServer = std::make_unique<MetricsServer>(metrics);
+        if(!metricsServer->Start((uint16_t)port))
+            metricsServer.reset();
+    }
+
+    Trace::NameThread("UI");
+    if(trace)
+        Trace::Start();
+
+    field = std::make_unique<FieldRenderer>(BlockSize, BkPixel);
+    LoadFieldTiles();
 
     LoadScoresData();
 
@@ -716,102 +1062,81 @@ App::App(HINSTANCE hInstance, LPTSTR lpCmdLine, int showCmd)
 }
 App::~App() 
 { 
+    DestroyFieldBitmap();
     UnregisterClass(_T("SnakeMainWndClass"), hInst);
     pApp = nullptr; 
 }
 
-BOOL App::CreateScoresSaverExe()
+BOOL App::SaveReplay(const Replay& record, uint32_t score) const
 {
-    HRSRC hRes = FindResource(hInst, MAKEINTRESOURCE(IDR_SCORES_SAVER_EXE), RT_RCDATA);
-    HGLOBAL hGlRes = LoadResource(hInst, hRes);
-    LPVOID pRes = LockResource(hGlRes);
-    DWORD resSize = SizeofResource(hInst, hRes);
-
-    HandleManager hExecFile = CreateFile(ScoresSaverExeName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_HIDDEN, nullptr);
-    if(!hExecFile)
-        return FALSE;
-    if(!WriteFile(hExecFile.get(), pRes, resSize, nullptr, nullptr))
-    {
-        DeleteFile(ScoresSaverExeName);
-        return FALSE;
-    }
-    return TRUE;
+    TraceSpan span("App::SaveReplay");
+    // Kept next to the scores under a name that tells the games apart
+    TCHAR fileName[64] = { 0 };
+    _stprintf_s(fileName, _T("Snake-%llu-%u.replay"), (unsigned long long)record.Seed(), score);
+
+    std::vector<uint8_t> data;
+    record.Write(data);
+    HandleManager hFile = CreateFile(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    DWORD written = 0;
+    return hFile && WriteFile(hFile.get(), data.data(), (DWORD)data.size(), &written, nullptr) && written == data.size();
 }
-BOOL App::DeleteScoresSaverExe(LPCTSTR cmdLine)
+BOOL App::LoadReplay(LPCTSTR fileName)
 {
-    size_t tmp = 0;
-    if(_stscanf_s(cmdLine, _T(" -d %zu"), &tmp) != 1)
+    HandleManager hFile = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size = {};
+    if(!hFile || !GetFileSizeEx(hFile.get(), &size) || size.QuadPart > std::numeric_limits<DWORD>::max())
         return FALSE;
-    HandleManager hSaverProcess((HANDLE)tmp);
-    WaitForSingleObject(hSaverProcess.get(), 1000);
-    return DeleteFile(ScoresSaverExeName);
-}
-BOOL App::LaunchScoresSaverExe()
-{
-    HandleManager hCurrProc = OpenProcess(PROCESS_ALL_ACCESS, TRUE, GetCurrentProcessId());
-    if(!hCurrProc)
+    std::vector<uint8_t> data((size_t)size.QuadPart);
+    DWORD read = 0;
+    if(!ReadFile(hFile.get(), data.data(), (DWORD)data.size(), &read, nullptr) || read != data.size())
         return FALSE;
-    TCHAR currExeName[MAX_PATH];
-    GetModuleFileName(hInst, currExeName, MAX_PATH);
-
-    auto cmdLine = std::make_unique<TCHAR[]>(2 * MAX_PATH + 32);
-    _stprintf_s(cmdLine.get(), 2 * MAX_PATH + 32, _T("\"%s\" -n \"%s\" -h %zu"), ScoresSaverExeName, currExeName, (size_t)hCurrProc.get());
-
-    STARTUPINFO si = { sizeof(STARTUPINFO) };
-    PROCESS_INFORMATION pi = {};
-    BOOL ret = CreateProcess(nullptr, cmdLine.get(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &si, &pi);
-    if(ret)
-    {
-        CloseHandle(pi.hThread);
-        CloseHandle(pi.hProcess);
-    }
-    return ret;
-}
-BOOL App::SaveScoresData()
-{ 
-    HandleManager pipe = CreateNamedPipe(PipeName, PIPE_ACCESS_OUTBOUND, PIPE_TYPE_BYTE | PIPE_WAIT, 2, 4096, 4096, 0, nullptr);
-    if( !(pipe && CreateScoresSaverExe() && LaunchScoresSaverExe() && SendDataToScoresSaver(pipe)) )
-        return FALSE;
-    return TRUE;
+    return replay.Read(data.data(), data.size());
 }
-BOOL App::SendDataToScoresSaver(HandleManager& pipe)
-{
-    uint32_t dataSize = std::accumulate(std::cbegin(scoresData->records), std::cbegin(scoresData->records) + scoresData->nRecords, uint32_t(sizeof(uint32_t)),
-        [](uint32_t sum, const ScoresData::RecordPtr& rec) { return sum + 4 * sizeof(uint32_t) + rec->nameLength * sizeof(TCHAR); });
-
-    auto data = std::make_unique<char[]>(dataSize + sizeof(uint32_t));
-    uint32_t *it = (uint32_t*)data.get();
-    *it++ = dataSize;
-    *it++ = scoresData->nRecords;
-    std::for_each(std::cbegin(scoresData->records), std::cbegin(scoresData->records) + scoresData->nRecords,
-        [&it](const ScoresData::RecordPtr& rec)
-        {
-            it = (uint32_t*)rec->WriteRecord(it);
-        });
-
-    ConnectNamedPipe(pipe.get(), nullptr);
-    return WriteFile(pipe.get(), data.get(), dataSize + sizeof(uint32_t), nullptr, nullptr);
-}
-
 inline HINSTANCE App::AppInstance() { return hInst; }
-inline void App::EndGame()
+void App::EndGame(const GameOver& over)
 {
-    running = false; 
+    TraceSpan span("App::EndGame");  // the message boxes and dialogs included, the UI stalls in them
+    // The snapshot of the final position was published before the game over was posted
+    TakeSnapshot();
+    RedrawField();
+    running = false;
     SendMessage(toolBar.hToolBar, TB_ENABLEBUTTON, (WPARAM)ID_PAUSE_BTN, MAKELPARAM(FALSE, 0));
-    Records(true);
+    if(over.reason == GameOver::Died)
+        MessageBox(hMainWnd, _T("GAME OVER!"), _T("Message"), MB_OK);
+    if(!playback && over.score)
+    {
+        // Every score is kept, a champion of the field also gets a name, the table and the replay saved
+        if(IsRecordScore(over.score))
+        {
+            SaveReplay(over.replay, over.score);
+            Records(over.score);
+        }
+        else
+            AddScore(over.score, nullptr);
+    }
+    if(over.reason == GameOver::Won)
+        MessageBox(hMainWnd, _T("You reached maximum snake length!"), _T("Message"), MB_OK);
+    else if(over.reason == GameOver::ReplayEnded)
+        MessageBox(hMainWnd, _T("End of replay"), _T("Message"), MB_OK);
 }
 inline App* App::GetApp() { return App::pApp; }
-inline int  App::KeyPressed(int vKey) const { return 0x8000 & GetAsyncKeyState(vKey); }
 inline void App::Options()
 {
+    if(playback)
+        return;
+    TraceSpan span("App::Options");
     if(DialogBox(hInst, MAKEINTRESOURCE(IDD_OPTIONS_DIALOG), hMainWnd, OptionsDialogProc))
     {
         ResizeGameArea(width, height);
         NewGame();
     }
 }
-inline void App::OutScore() const
+inline void App::OutScore()
 {
+    uint32_t score = sim->Latest().game.Score();
+    if(score == shownScore)
+        return;
+    shownScore = score;
     TCHAR buf[16] = { 0 };
     _stprintf_s(buf, _T("SCORE: %d"), score);
     SetWindowText(toolBar.hStaticScore, buf);
@@ -822,13 +1147,72 @@ inline void App::Pause()
     {
         SendMessage(toolBar.hToolBar, TB_CHANGEBITMAP, (WPARAM)ID_PAUSE_BTN, (LPARAM)(paused ? toolBar.PauseImg : toolBar.UnpauseImg));
         paused = !paused;
+        GameCommand cmd = { GameCommand::SetPaused };
+        cmd.on = paused;
+        sim->Post(cmd);
     }
 }
-inline void App::Records(bool bPushRecord)
+inline void App::Records(uint32_t newScore)
 {
-    if(bPushRecord && (score == 0 || scoresData->nRecords == MaxRecordsCount && score < scoresData->records[MaxRecordsCount - 1]->score))
-        return;
-    DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_SCORE_TABLE_DIALOG), hMainWnd, ScoresDialogProc, (LPARAM)(bPushRecord ? score : 0));
+    TraceSpan span("App::Records");
+    DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_SCORE_TABLE_DIALOG), hMainWnd, ScoresDialogProc, (LPARAM)newScore);
+}
+void App::AddScore(uint32_t score, HWND hNameOwner)
+{
+    // A score of the current field, named by the player if there's a window to ask over
+    TCHAR name[MaxNameLength];
+    INT_PTR nameLength = 0;
+    if(hNameOwner)
+        nameLength = DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_NAME_INPUT_DIALOG), hNameOwner, PlayerNameInputDialogProc, (LPARAM)name);
+    ScoreEntry entry = { width, height, score, nameLength > 0 ? (uint32_t)nameLength : 0, name };
+
+    ScoresData& scores = *scoresData;
+    Leaderboard& board = scores.Board();  // the build reads added, it is done before the score goes in
+    uint32_t id = (uint32_t)scores.saved.Size() + scores.added.Add(entry);
+    journal->Append(entry);
+    board.Insert(width, height, score, id);
+}
+inline bool App::ScoresData::Get(uint32_t id, ScoreEntry& entry) const
+{
+    return id < saved.Size() ? saved.Get(id, entry) : added.Get(id - (uint32_t)saved.Size(), entry);
+}
+App::ScoresData::~ScoresData()
+{
+    if(indexer.joinable())
+        indexer.join();
+}
+void App::ScoresData::StartIndexing()
+{
+    indexer = std::thread(&ScoresData::Index, this);
+}
+Leaderboard& App::ScoresData::Board()
+{
+    if(indexer.joinable())
+    {
+        TraceSpan span("App::ScoresData::Board");  // the UI stalls here only if the build is still running
+        indexer.join();
+    }
+    return board;
+}
+void App::ScoresData::Index()
+{
+    Trace::NameThread("Scores");
+    TraceSpan span("App::ScoresData::Index");
+    // The board is the only thing built per score, the records stay where they are
+    saved.ForEach([this](uint32_t id, const ScoreEntry& entry)
+    {
+        board.Insert(entry.width, entry.height, entry.score, id);
+    });
+    uint32_t addedBase = (uint32_t)saved.Size();
+    added.View().ForEach([this, addedBase](uint32_t offset, const ScoreEntry& entry)
+    {
+        board.Insert(entry.width, entry.height, entry.score, addedBase + offset);
+    });
+}
+inline bool App::IsRecordScore(uint32_t score) const
+{
+    // A new score goes before the equal ones, so it is on the table if fewer than a full table are better
+    return score != 0 && scoresData->Board().Rank(width, height, score) <= MaxRecordsCount;
 }
 
 void App::CreateMainWindow(int showCmd)
@@ -839,45 +1223,63 @@ void App::CreateMainWindow(int showCmd)
     if(!hMainWnd)
         throw Error::CreateWndErr;
 
+    UpdateTitle();
     ResizeGameArea(width, height);
     ShowWindow(hMainWnd, showCmd);
     UpdateWindow(hMainWnd);
 }
 bool App::LoadScoresData()
 {
-    HRSRC hScoreRes = FindResource(hInst, MAKEINTRESOURCE(IDR_SCOREDATA), RT_RCDATA);
-    HGLOBAL hLoadScoreRes = LoadResource(hInst, hScoreRes);
-    uint32_t *scoresResAddr = (uint32_t*)LockResource(hLoadScoreRes);
-
-    if(!scoresResAddr)
-        return false;
-
+    journal = std::make_unique<ScoreJournal>(ScoresFileName);
     scoresData = std::make_unique<ScoresData>();
-    scoresData->nRecords = *scoresResAddr++;
-
-    for(uint32_t i = 0; i < MaxRecordsCount; ++i)
+    ScoresData& scores = *scoresData;
+    if(!journal->Map(scores.saved))
     {
-        auto& record = scoresData->records[i];
-        record = std::make_unique<ScoresData::Record>();
-        if(i < scoresData->nRecords)
-            scoresResAddr = (uint32_t*)record->ReadRecord(scoresResAddr);
-        else
-            record->ReadRecord(nullptr);
+        // No journal yet: the table older versions kept in the executable's resource is taken over once. It holds at
+        // most MaxRecordsCount, best first and newer first among equal scores, so it goes in from the end to keep the
+        // journal oldest first.
+        HRSRC hScoreRes = FindResource(hInst, MAKEINTRESOURCE(IDR_SCOREDATA), RT_RCDATA);
+        HGLOBAL hLoadScoreRes = LoadResource(hInst, hScoreRes);
+        const void* scoresResAddr = LockResource(hLoadScoreRes);
+        ScoreView table(scoresResAddr, scoresResAddr ? SizeofResource(hInst, hScoreRes) : 0);
+        uint32_t offsets[MaxRecordsCount];
+        uint32_t count = 0;
+        table.ForEach([&](uint32_t offset, const ScoreEntry&)
+        {
+            if(count < MaxRecordsCount)
+                offsets[count++] = offset;
+        });
+        for(uint32_t i = count; i-- > 0;)
+        {
+            ScoreEntry entry;
+            table.Get(offsets[i], entry);
+            scores.added.Add(entry);
+        }
+        if(scores.added.Count())
+            journal->Append(scores.added);
+    }
+    scores.StartIndexing();
+    if(journal->Damaged())
+    {
+        TCHAR msg[256];
+        _stprintf_s(msg, _T("Part of %hs couldn't be read. It was moved to %hs, the scores in it are left out."),
+            ScoresFileName, journal->BadFileName().c_str());
+        MessageBox(0, msg, _T("Error"), MB_OK | MB_ICONWARNING);
     }
     return true;
 }
 void App::NewGame()
 {
+    // The field follows once the snapshot of the new game comes
     running = true;
     paused = true;
-    score = 0;
-    timeStep = speed;
-    snake->Reset(width, height);
-    timer->Reset();
-    SpawnFood();
+    SetTimeStep(speed);
+    GameCommand cmd = { GameCommand::NewGame };
+    cmd.width = width;
+    cmd.height = height;
+    sim->Post(cmd);
     SendMessage(toolBar.hToolBar, TB_CHANGEBITMAP, ID_PAUSE_BTN, (LPARAM)toolBar.UnpauseImg);
     SendMessage(toolBar.hToolBar, TB_ENABLEBUTTON, (WPARAM)ID_PAUSE_BTN, MAKELPARAM(TRUE, 0));
-    OutScore();
     RedrawWindow(hMainWnd, nullptr, nullptr, RDW_INVALIDATE);
 }
 ATOM App::RegisterWindowClass()
@@ -897,41 +1299,137 @@ void App::ResizeGameArea(uint32_t w, uint32_t h)
 {
     width = std::max(MinWidth, std::min(w, MaxWidth));
     height = std::max(MinHeight, std::min(h, MaxHeight));
-    RECT wndRect, adjRect = { 0, 0, (LONG)(width * BlockSize), (LONG)(height * BlockSize + vertIndent + GetSystemMetrics(SM_CYMENU)) };
+    viewWidth = std::min(width, MaxViewWidth);
+    viewHeight = std::min(height, MaxViewHeight);
+    RECT wndRect, adjRect = { 0, 0, (LONG)(viewWidth * BlockSize), (LONG)(viewHeight * BlockSize + vertIndent + GetSystemMetrics(SM_CYMENU)) };
     AdjustWindowRectEx(&adjRect, MainWindowStyle, FALSE, 0);
     GetWindowRect(hMainWnd, &wndRect);
     wndRect.right = adjRect.right - adjRect.left;
     wndRect.bottom = adjRect.bottom - adjRect.top;
     MoveWindow(hMainWnd, wndRect.left, wndRect.top, wndRect.right, wndRect.bottom, TRUE);
     SendMessage(toolBar.hToolBar, TB_AUTOSIZE, 0, 0);
+    CreateFieldBitmap();
+}
+void App::ScrollView()
+{
+    const Game& game = sim->Latest().game;
+    if(game.Width() != width || game.Height() != height)
+        return;
+    Point head = game.GetSnake().GetHead();
+    viewOrigin.x = std::max(0, std::min(head.x - (int32_t)viewWidth / 2, (int32_t)(width - viewWidth)));
+    viewOrigin.y = std::max(0, std::min(head.y - (int32_t)viewHeight / 2, (int32_t)(height - viewHeight)));
+}
+void App::LoadFieldTiles()
+{
+    // The images are drawn over white, which is their transparent color. The renderer scales them to BlockSize
+    // and premultiplies them once here.
+    constexpr uint32_t SnakeImgCnt = 9;
+    constexpr uint32_t KeyColor = 0xFFFFFF;
+    auto load = [](UINT id, BITMAP& bm, std::vector<uint32_t>& pixels)
+    {
+        HBITMAP hBM = (HBITMAP)LoadImage(hInst, MAKEINTRESOURCE(id), IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION);
+        if(!hBM || !GetObject(hBM, sizeof(bm), &bm))
+        {
+            DeleteObject(hBM);
+            return false;
+        }
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = bm.bmWidth;
+        bmi.bmiHeader.biHeight = -bm.bmHeight;
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        pixels.resize((size_t)bm.bmWidth * bm.bmHeight);
+        HDC hdc = GetDC(nullptr);
+        bool ok = GetDIBits(hdc, hBM, 0, bm.bmHeight, pixels.data(), &bmi, DIB_RGB_COLORS) == bm.bmHeight;
+        ReleaseDC(nullptr, hdc);
+        DeleteObject(hBM);
+        for(auto& p : pixels)
+            p |= 0xFF000000;  // the images have no alpha channel
+        return ok;
+    };
+
+    BITMAP bm;
+    std::vector<uint32_t> pixels;
+    if(load(IDB_SNAKE_FULL, bm, pixels))
+    {
+        uint32_t imgWidth = bm.bmWidth / SnakeImgCnt;
+        for(uint32_t i = 0; i < SnakeImgCnt; ++i)
+            field->SetTile(i, pixels.data() + i * imgWidth, imgWidth, bm.bmHeight, bm.bmWidth, KeyColor);
+    }
+    if(load(IDB_FOOD, bm, pixels))
+        field->SetTile(FieldRenderer::FoodTile, pixels.data(), bm.bmWidth, bm.bmHeight, bm.bmWidth, KeyColor);
+}
+void App::CreateFieldBitmap()
+{
+    DestroyFieldBitmap();
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = (LONG)(viewWidth * BlockSize);
+    bmi.bmiHeader.biHeight = -(LONG)(viewHeight * BlockSize);  // top-down, the rows in the renderer's order
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    void* bits = nullptr;
+    hFieldBM = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if(!hFieldBM)
+        throw std::bad_alloc();
+    hFieldDC = CreateCompatibleDC(nullptr);
+    hOldFieldBM = SelectObject(hFieldDC, hFieldBM);
+    field->SetView(viewWidth, viewHeight, (uint32_t*)bits);
+}
+void App::DestroyFieldBitmap()
+{
+    if(hFieldDC)
+    {
+        SelectObject(hFieldDC, hOldFieldBM);
+        DeleteDC(hFieldDC);
+        hFieldDC = nullptr;
+    }
+    if(hFieldBM)
+    {
+        DeleteObject(hFieldBM);
+        hFieldBM = nullptr;
+    }
+}
+void App::RedrawField()
+{
+    // Repaints the cells that changed since the last call and invalidates just those
+    if(!hFieldDC || !sim)
+        return;
+    // Until the first snapshot of a game resized by Options comes, the one there is doesn't fit the view
+    const GameSnapshot& snapshot = sim->Latest();
+    if(snapshot.game.Width() != width || snapshot.game.Height() != height)
+        return;
+    GdiFlush();  // GDI may still be reading the DIB section
+    field->Update(snapshot.game, viewOrigin, snapshot.running);
+    for(const auto& r : field->Dirty())
+    {
+        RECT rc = { (LONG)r.left, (LONG)(r.top + vertIndent), (LONG)r.right, (LONG)(r.bottom + vertIndent) };
+        InvalidateRect(hMainWnd, &rc, FALSE);
+    }
+    field->ClearDirty();
 }
 int  App::Run()
 {
     if(!pApp)
         return 0;
     MSG msg = { 0 };
-    timer->Reset();
     try
     {
-        while(msg.message != WM_QUIT)
+        // The game ticks on the simulation thread, this one only waits for messages
+        while(GetMessage(&msg, nullptr, 0, 0) > 0)
         {
-            if(PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
-            {
-                TranslateMessage(&msg);
-                DispatchMessage(&msg);
-            }
-
-            timer->Tick();
-            OnKeyboardInput();
-            if(timeStep < timer->Elapsed())
-            {
-                if(running && !paused)
-                    Update();
-                timer->Reset();
-            }
+            TraceSpan span("App::Run");  // one message, the idle time in GetMessage is left out
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
         }
-        if(scoresChanged)
-            SaveScoresData();
+        if(metricsServer)
+            metricsServer->Stop();
+        metrics.WriteFile(MetricsFileName);
+        if(Trace::Enabled())
+            Trace::WriteFile(TraceFileName);
     }
     catch(Error err)
     {
@@ -951,47 +1449,72 @@ int  App::Run()
     }
     return (int)msg.wParam;
 }
-void App::SpawnFood()
-{
-    std::vector<uint32_t> freeInd(width * height);
-    uint32_t val = 0;
-    for(auto& i : freeInd)
-        i = val++;
-    for(const auto& p : snake->Body())
-        freeInd[width * p.y + p.x] = std::numeric_limits<uint32_t>::max();
-    freeInd.erase(std::remove(freeInd.begin(), freeInd.end(), (uint32_t)-1), freeInd.end());
-
-    RandGen<uint32_t> rgen(0, freeInd.size() - 1);
-    val = freeInd[rgen()];
-    POINT p = { (LONG)(val % width), (LONG)(val / width) };
-    food->SetPos(p);
+void App::TakeSnapshot()
+{
+    // The field follows whatever the simulation published last
+    if(!sim || !sim->Refresh())
+        return;
+    ScrollView();
+    OutScore();
+    if(autopilotOn && useMcts)
+        UpdateTitle();
 }
-void App::Update()
+void App::SetTimeStep(double step)
 {
-    if(!snake->Move(width, height))
-    {
-        MessageBox(hMainWnd, _T("GAME OVER!"), _T("Message"), MB_OK);
-        EndGame();
+    timeStep = step;
+    GameCommand cmd = { GameCommand::SetStep };
+    cmd.step = step;
+    sim->Post(cmd);
+}
+void App::ToggleAutopilot()
+{
+    if(playback)
         return;
+    autopilotOn = !autopilotOn;
+    GameCommand cmd = { GameCommand::SetAutopilot };
+    cmd.on = autopilotOn;
+    cmd.mcts = useMcts;
+    sim->Post(cmd);
+    SendMessage(toolBar.hToolBar, TB_CHECKBUTTON, (WPARAM)ID_AUTOPILOT_BTN, MAKELPARAM(autopilotOn, 0));
+    UpdateTitle();
+}
+void App::SwitchAutopilot()
+{
+    // Chooses between the planner and MCTS, an autopilot that is on switches right away
+    useMcts = !useMcts;
+    if(autopilotOn)
+    {
+        ToggleAutopilot();
+        ToggleAutopilot();
     }
-    RECT rc = { 0, (LONG)vertIndent, (LONG)(width * BlockSize), (LONG)(height * BlockSize + vertIndent) };
-    if(snake->GetHead() == food->GetPos())
+}
+void App::UpdateTitle()
+{
+    TCHAR title[128] = { 0 };
+    int n = playback ? _stprintf_s(title, _T("Snake replay (seed %llu)"), (unsigned long long)replay.Seed())
+        : _stprintf_s(title, _T("Snake game (seed %llu)"), (unsigned long long)sessionSeed);
+    const GameSnapshot::Search& search = sim->Latest().search;
+    if(autopilotOn && useMcts && search.threads && search.seconds > 0)
+        _stprintf_s(title + n, _countof(title) - n, _T(" - MCTS %u threads, %.0f rollouts/s, %.1f%% table hits"), search.threads,
+            search.rollouts / search.seconds, 100.0 * search.hits / std::max<uint64_t>(1, search.lookups));
+    SetWindowText(hMainWnd, title);
+}
+void App::FastForward()
+{
+    if(playback && running)
+        sim->Post(GameCommand{ GameCommand::FastForward });
+}
+void App::ToggleTrace()
+{
+    // The first press starts recording, the next writes what was recorded and stops
+    if(!Trace::Enabled())
     {
-        snake->Eat();
-        ++score;
-        OutScore();        
-        if(snake->BodySize() == width * height)
-        {
-            EndGame();
-            InvalidateRect(hMainWnd, &rc, FALSE);
-            MessageBox(hMainWnd, _T("You reached maximum snake length!"), _T("Message"), MB_OK);
-            return;
-        }
-        else
-            SpawnFood();
-
+        Trace::Start();
+        return;
     }
-    InvalidateRect(hMainWnd, &rc, FALSE);
+    Trace::Stop();
+    if(!Trace::WriteFile(TraceFileName))
+        MessageBox(hMainWnd, _T("Can't write the trace file."), _T("Error"), MB_OK);
 }
 
 void App::OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT code)
@@ -1001,39 +1524,51 @@ void App::OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT code)
         switch(id)
         {
             case ID_GAME_OPTIONS: Options(); break;
-            case ID_GAME_CHAMPIONS: Records(false); break;
+            case ID_GAME_CHAMPIONS: Records(0); break;
             case ID_GAME_EXIT: PostMessage(hwnd, WM_CLOSE, 0, 0);
         }
     }
 }
-void App::OnKeyboardInput()
-{
-    if(paused)
-        return;
-    if(KeyPressed(VK_LEFT) && snake->IsValidDirection(Snake::Direction::LEFT))
-        snake->SetDirection(Snake::Direction::LEFT);
-    else if(KeyPressed(VK_RIGHT) && snake->IsValidDirection(Snake::Direction::RIGHT))
-        snake->SetDirection(Snake::Direction::RIGHT);
-    else if(KeyPressed(VK_UP) && snake->IsValidDirection(Snake::Direction::UP))
-        snake->SetDirection(Snake::Direction::UP);
-    else if(KeyPressed(VK_DOWN) && snake->IsValidDirection(Snake::Direction::DOWN))
-        snake->SetDirection(Snake::Direction::DOWN);
-}
 void App::OnKeyDown(HWND hwnd, UINT vk, BOOL fDown, int cRepeat, UINT flags)
 {
     _CRT_UNUSED(hwnd);
     _CRT_UNUSED(fDown);
     _CRT_UNUSED(cRepeat);
-    _CRT_UNUSED(flags);
 
+    TraceSpan span("App::OnKeyDown");
     if(vk == VK_SPACE)
-        timeStep = std::max(0.1, speed / 3.0);
+        SetTimeStep(std::min(speed, std::max(0.1, speed / 3.0)));
     else if(vk == 'P')
         Pause();
     else if(vk == 'O')
         Options();
     else if(vk == 'N')
         NewGame();
+    else if(vk == 'A')
+        ToggleAutopilot();
+    else if(vk == 'M')
+        SwitchAutopilot();
+    else if(vk == 'D' && !metrics.WriteFile(MetricsFileName))
+        MessageBox(hMainWnd, _T("Can't write the metrics file."), _T("Error"), MB_OK);
+    else if(vk == 'T')
+        ToggleTrace();
+    else if(playback && (vk == VK_ADD || vk == VK_OEM_PLUS))
+        SetTimeStep(speed = std::max(0.005, speed / 2.0));
+    else if(playback && (vk == VK_SUBTRACT || vk == VK_OEM_MINUS))
+        SetTimeStep(speed = std::min(2.0, speed * 2.0));
+    else if(vk == VK_END)
+        FastForward();
+    else if(vk == VK_LEFT || vk == VK_RIGHT || vk == VK_UP || vk == VK_DOWN)
+    {
+        // The turn waits in the simulation's queue for its tick. Auto-repeat of a held arrow adds nothing.
+        if(!(flags & KF_REPEAT) && running && !paused && !autopilotOn && !playback)
+        {
+            GameCommand cmd = { GameCommand::Turn };
+            cmd.dir = (vk == VK_LEFT) ? Snake::LEFT : (vk == VK_RIGHT) ? Snake::RIGHT : (vk == VK_UP) ? Snake::UP : Snake::DOWN;
+            cmd.time = SteadyTickClock().Now();
+            sim->Post(cmd);
+        }
+    }
 }
 void App::OnNotify(HWND hwnd, int id, LPNMHDR phdr)
 {
@@ -1056,6 +1591,9 @@ void App::OnNotify(HWND hwnd, int id, LPNMHDR phdr)
                 case ID_PAUSE_BTN:
                     ptbit->pszText = paused ? _T("Resume (P)") : _T("Pause (P)");
                     break;
+                case ID_AUTOPILOT_BTN:
+                    ptbit->pszText = autopilotOn ? _T("Autopilot off (A)") : _T("Autopilot on (A)");
+                    break;
             }
             ptbit->cchTextMax = _tcslen(ptbit->pszText) + 1;
         }
@@ -1067,78 +1605,43 @@ void App::OnNotify(HWND hwnd, int id, LPNMHDR phdr)
                 case ID_OPT_BTN: Options(); break;
                 case ID_NEW_GAME_BTN: NewGame(); break;
                 case ID_PAUSE_BTN: Pause(); break;
+                case ID_AUTOPILOT_BTN: ToggleAutopilot(); break;
             }
         }
     }
 }
 void App::OnPaint()
 {
+    int64_t start = SteadyTickClock().Now();
+    // Bring the frame up to date first, the cells it repaints join the update region before BeginPaint takes it
+    TakeSnapshot();
+    RedrawField();
+    HRGN hRgn = CreateRectRgn(0, 0, 0, 0);
+    GetUpdateRgn(hMainWnd, hRgn, FALSE);
+
     PAINTSTRUCT ps;
     HDC hdc = BeginPaint(hMainWnd, &ps);
-    HDC hMemDC = CreateCompatibleDC(hdc);
-
-    uint32_t pw = width * BlockSize, ph = height * BlockSize;
 
-    HBITMAP hBitMap = CreateCompatibleBitmap(hdc, pw, ph);
-    hBitMap = (HBITMAP)SelectObject(hMemDC, hBitMap);
-
-    //Fill bitmap with BkColor color
+    // Copy out only the rectangles of the field that are invalid
+    DWORD rgnSize = GetRegionData(hRgn, 0, nullptr);
+    std::vector<BYTE> rgnBuf(rgnSize);
+    RGNDATA* rgnData = (RGNDATA*)rgnBuf.data();
+    if(rgnSize && hFieldDC && GetRegionData(hRgn, rgnSize, rgnData))
     {
-        HBRUSH hBr = CreateSolidBrush(BkColor);
-        RECT rc = { 0, 0, (LONG)pw, (LONG)ph };
-        FillRect(hMemDC, &rc, hBr);
-        DeleteObject(hBr);
+        RECT fieldRect = { 0, (LONG)vertIndent, (LONG)field->PixelWidth(), (LONG)(field->PixelHeight() + vertIndent) };
+        const RECT* rects = (const RECT*)rgnData->Buffer;
+        for(DWORD i = 0; i < rgnData->rdh.nCount; ++i)
+        {
+            RECT rc;
+            if(IntersectRect(&rc, &rects[i], &fieldRect))
+                BitBlt(hdc, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, hFieldDC, rc.left, rc.top - vertIndent, SRCCOPY);
+        }
     }
-
-    snake->Draw(hMemDC);
-    if(running)
-        food->Draw(hMemDC);
-
-    // Copy bitmap to device
-    BitBlt(hdc, 0, vertIndent, pw, ph, hMemDC, 0, 0, SRCCOPY);
-
-    DeleteObject(SelectObject(hMemDC, hBitMap));
-    DeleteDC(hMemDC);
+    DeleteObject(hRgn);
 
     EndPaint(hMainWnd, &ps);
-}
-
-void  App::ScoresData::Record::BuildRecordStr(bool bEmpty)
-{
-    if(!recordStr)
-        recordStr = std::make_unique<TCHAR[]>(MaxRecordStrLen + 1);
-    recordLength = (bEmpty) ?
-        _stprintf_s(recordStr.get(), MaxRecordStrLen, _T("\n    Empty             0x0       0")) :
-        _stprintf_s(recordStr.get(), MaxRecordStrLen, _T("\n    %-10.10s  %7dx%-2d  %5d"), name.get(), width, height, score);    
-}
-void* App::ScoresData::Record::ReadRecord(void* pMem)
-{
-    if(pMem)
-    {
-        uint32_t *it = (uint32_t*)pMem;
-        width = *it++;
-        height = *it++;
-        score = *it++;
-        nameLength = *it++;
-        name = std::make_unique<TCHAR[]>(nameLength + 1);
-        memcpy(name.get(), it, nameLength * sizeof(TCHAR));
-
-        BuildRecordStr(false);
-        return (TCHAR*)it + nameLength;
-    }
-    else
-    {
-        BuildRecordStr(true);
-        return nullptr;
-    }
-}
-void* App::ScoresData::Record::WriteRecord(void* pMem)
-{
-    uint32_t *it = (uint32_t*)pMem;
-    *it++ = width;
-    *it++ = height;
-    *it++ = score;
-    *it++ = nameLength;
-    memcpy(it, name.get(), nameLength * sizeof(TCHAR));
-    return (TCHAR*)it + nameLength;
+    int64_t end = SteadyTickClock().Now();
+    metrics[Phase::Paint].Record(end - start);
+    if(Trace::Enabled())
+        Trace::Record("App::OnPaint", start, end);
 }
@@ -0,0 +1,634 @@
+// Benchmarks of the engine, food spawning, drawing, score serialization and whole games. Everything runs from fixed
+// seeds and the results are written as CSV or JSON, so runs on different commits can be diffed.
+//
+// SnakeBench [-f csv|json] [-o file] [-t ms] [-s seed] [-r filter]
+//
+// Each case runs in batches of doubling size until one batch takes at least -t ms (200 by default) and that batch is
+// reported: name, iterations, seconds, ns per iteration and iterations per second. -r runs only the cases whose name
+// contains filter.
+//
+//   snake_move/WxH/fill=P     Snake::Move along a cycle through the field, with P percent of the field covered
+//   snake_isbody/WxH/fill=P   Snake::IsBody at random cells
+//   spawn_food/WxH/fill=P     Game::SpawnFood
+//   blend_cell/KERNEL         BlendOver of one premultiplied BlockSize sprite onto a cell, blend_cell/reference the
+//                             same with BlendOverReference (BlendTest checks they agree)
+//   flood_fill/KERNEL         Bitboard FloodFill and count over a half covered 32x32 field with each kernel built,
+//                             flood_fill/reference the same with CountReachable (FloodFillTest checks they agree)
+//   render_full/WxH           FieldRenderer repainting every cell of a half covered field, as after a new game
+//   render_tick/WxH           one tick along the cycle and the FieldRenderer update after it, in frames per second
+//                             (RenderTest checks the updates against a full render)
+//   scores_view/N, scores_build/N   a ScoreView over a table of N records read through, and a ScoreBuilder of them
+//   journal_load/N            ScoreJournal::Map of a compacted journal of N records and a read through it,
+//                             journal_compact/N its rewrite
+//   leaderboard_insert/N      Leaderboard::Insert of N scores over 25 field sizes, timed once as the board is built;
+//                             leaderboard_rank/N, leaderboard_field_rank/N and leaderboard_top10/N query that board
+//   game/POLICY/WxH           whole games, game_tick/POLICY/WxH is the same run counted per tick
+//   autopilot_tick/WxH        one Planner decision and Game::Step, on fields of 32 to 4096 cells square. One game is
+//                             carried on from batch to batch and started over from the same seed when it ends or
+//                             after AutopilotTicks ticks, so every run averages the same stretch of play.
+//   metrics_record            LatencyHistogram::Record of durations spread over six decades, metrics_timed the same
+//                             with the two SteadyTickClock reads that time a phase
+//   trace_span/on, trace_span/off   an empty TraceSpan with tracing on, recording into the ring, and off
+
+#include "../SnakeCore/SnakeCore.h"
+#include "../SnakeCore/Policies.h"
+#include "../SnakeCore/Planner.h"
+#include "../SnakeCore/Bitboard.h"
+#include "../SnakeCore/Scores.h"
+#include "../SnakeCore/ScoreJournal.h"
+#include "../SnakeCore/Leaderboard.h"
+#include "../SnakeCore/Render.h"
+#include "../SnakeCore/Blit.h"
+#include "../SnakeCore/Metrics.h"
+#include "../SnakeCore/Scheduler.h"
+#include "../SnakeCore/Trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <cmath>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+    struct Options
+    {
+        bool json = false;
+        std::string outFile;  // empty - stdout
+        uint32_t minMs = 200;
+        uint64_t seed = 1;
+        std::string filter;
+    };
+
+    struct Result
+    {
+        std::string name;
+        uint64_t iterations;
+        double seconds;
+    };
+
+    // Results go here so the compiler can't drop the work that produced them
+    volatile uint64_t sink = 0;
+
+    const uint32_t FillPercents[] = { 0, 10, 50, 90, 99 };  // 0 - the snake as a game starts
+    constexpr size_t FillCount = sizeof(FillPercents) / sizeof(FillPercents[0]);
+    constexpr uint32_t BlockSize = 24;         // as in the game
+    constexpr uint32_t BkColor = 0xFFC0C0C0;
+    constexpr uint32_t ScoreRecords = 10;      // App::MaxRecordsCount
+    constexpr uint32_t JournalRecords = 100000;
+    constexpr uint32_t LeaderboardRecords = 10000000;
+    constexpr uint64_t AutopilotTicks = 200000;
+    constexpr char JournalFileName[] = "SnakeBench.scores";  // made in the working directory and removed
+
+    void PrintUsage()
+    {
+        printf("usage: SnakeBench [-f csv|json] [-o file] [-t ms] [-s seed] [-r filter]\n");
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& opt)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            const char* arg = argv[i];
+            const char* val = (i + 1 < argc) ? argv[i + 1] : nullptr;
+            if(!val || arg[0] != '-' || arg[1] == 0 || arg[2] != 0)
+                return false;
+            switch(arg[1])
+            {
+                case 'f':
+                    if(strcmp(val, "json") != 0 && strcmp(val, "csv") != 0)
+                        return false;
+                    opt.json = strcmp(val, "json") == 0;
+                    break;
+                case 'o': opt.outFile = val; break;
+                case 't': opt.minMs = (uint32_t)strtoul(val, nullptr, 10); break;
+                case 's': opt.seed = strtoull(val, nullptr, 10); break;
+                case 'r': opt.filter = val; break;
+                default: return false;
+            }
+            ++i;
+        }
+        return true;
+    }
+
+    // Runs body(n) for n = 1, 2, 4... until one call takes opt.minMs and records that call.
+    // False if the case is filtered out.
+    bool Measure(const Options& opt, const std::string& name, const std::function<void(uint64_t)>& body, std::vector<Result>& results)
+    {
+        if(!opt.filter.empty() && name.find(opt.filter) == std::string::npos)
+            return false;
+        for(uint64_t n = 1; ; n *= 2)
+        {
+            auto start = std::chrono::steady_clock::now();
+            body(n);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if(seconds * 1000 >= opt.minMs || n >= (1ull << 40))
+            {
+                results.push_back({ name, n, seconds });
+                return true;
+            }
+        }
+    }
+
+    std::string BoardName(uint32_t width, uint32_t height)
+    {
+        return std::to_string(width) + "x" + std::to_string(height);
+    }
+
+    // Direction along a cycle through every cell of a field of even height: the rows are walked right and left
+    // over columns 1 and up, column 0 leads back up to the first row
+    Snake::Direction CycleDirection(Point p, uint32_t width, uint32_t height)
+    {
+        if(p.x == 0)
+            return p.y == 0 ? Snake::RIGHT : Snake::UP;
+        if(p.y % 2 == 0)
+            return (uint32_t)p.x + 1 == width ? Snake::DOWN : Snake::RIGHT;
+        if(p.x > 1)
+            return Snake::LEFT;
+        return (uint32_t)p.y + 1 == height ? Snake::LEFT : Snake::DOWN;
+    }
+
+    // Games steered along the cycle, which eats the food wherever it lies, up to each of FillPercents in turn.
+    // The start-up body lies across the cycle and may still be hit in the first ticks, then the next seed is tried.
+    std::vector<Game> CycleStates(uint32_t width, uint32_t height, uint64_t seed)
+    {
+        std::vector<Game> states;
+        Game game;
+        for(uint64_t s = seed; states.size() < FillCount; ++s)
+        {
+            states.clear();
+            game.Reset(width, height, s);
+            Game::StepResult res = Game::Moved;
+            for(uint32_t percent : FillPercents)
+            {
+                uint32_t length = std::max(game.GetSnake().BodySize(), width * height * percent / 100);
+                while(game.GetSnake().BodySize() < length && res != Game::Died)
+                {
+                    Snake& snake = game.GetSnake();
+                    snake.SetDirection(CycleDirection(snake.GetHead(), width, height));
+                    res = game.Step();
+                }
+                if(res == Game::Died)
+                    break;
+                states.push_back(game);
+            }
+        }
+        return states;
+    }
+
+    void EngineCases(const Options& opt, uint32_t width, uint32_t height, std::vector<Result>& results)
+    {
+        std::vector<Game> states = CycleStates(width, height, opt.seed);
+        RandGen rng(opt.seed, 1);
+        Point points[1024];  // a power of two, so the index wraps cheaply
+        for(auto& p : points)
+            p = { (int32_t)rng.Below(width), (int32_t)rng.Below(height) };
+
+        for(size_t i = 0; i < states.size(); ++i)
+        {
+            std::string suffix = "/" + BoardName(width, height) + "/fill=" + std::to_string(FillPercents[i]);
+
+            Measure(opt, "snake_move" + suffix, [&](uint64_t n)
+            {
+                Snake snake = states[i].GetSnake();
+                uint64_t moved = 0;
+                for(uint64_t k = 0; k < n; ++k)
+                {
+                    snake.SetDirection(CycleDirection(snake.GetHead(), width, height));
+                    moved += snake.Move(width, height);
+                }
+                sink += moved;
+            }, results);
+
+            const Snake& snake = states[i].GetSnake();
+            Measure(opt, "snake_isbody" + suffix, [&](uint64_t n)
+            {
+                uint64_t hits = 0;
+                for(uint64_t k = 0; k < n; ++k)
+                    hits += snake.IsBody(points[k % 1024]);
+                sink += hits;
+            }, results);
+
+            Measure(opt, "spawn_food" + suffix, [&](uint64_t n)
+            {
+                Game game = states[i];
+                uint64_t sum = 0;
+                for(uint64_t k = 0; k < n; ++k)
+                {
+                    game.SpawnFood();
+                    sum += (uint32_t)game.GetFood().x;
+                }
+                sink += sum;
+            }, results);
+        }
+    }
+
+    void BlendCases(const Options& opt, std::vector<Result>& results)
+    {
+        // A round sprite with soft edges, as the atlas makes of the game's images
+        SpriteAtlas atlas(BlockSize, 1);
+        std::vector<uint32_t> image(4 * BlockSize * BlockSize);
+        for(uint32_t y = 0; y < 2 * BlockSize; ++y)
+            for(uint32_t x = 0; x < 2 * BlockSize; ++x)
+            {
+                int32_t dx = 2 * (int32_t)x + 1 - 2 * (int32_t)BlockSize, dy = 2 * (int32_t)y + 1 - 2 * (int32_t)BlockSize;
+                image[y * 2 * BlockSize + x] = dx * dx + dy * dy <= (int32_t)(4 * BlockSize * BlockSize) ? 0xFF208020 : 0xFFFFFFFF;
+            }
+        atlas.Set(0, image.data(), 2 * BlockSize, 2 * BlockSize, 2 * BlockSize, 0xFFFFFF);
+
+        std::vector<uint32_t> cell(BlockSize * BlockSize, BkColor);
+        auto blend = [&](const char* name, void (*kernel)(uint32_t*, uint32_t, const uint32_t*, uint32_t, uint32_t, uint32_t))
+        {
+            Measure(opt, std::string("blend_cell/") + name, [&](uint64_t n)
+            {
+                for(uint64_t k = 0; k < n; ++k)
+                    kernel(cell.data(), BlockSize, atlas.Sprite(0), BlockSize, BlockSize, BlockSize);
+                sink += cell[BlockSize * BlockSize / 2];
+            }, results);
+        };
+        blend(BlitKernel(), BlendOver);
+        blend("reference", BlendOverReference);
+    }
+
+    void FloodFillCases(const Options& opt, std::vector<Result>& results)
+    {
+        Game game = CycleStates(BitboardSize, BitboardSize, opt.seed)[2];  // half of the field covered
+        const Snake& snake = game.GetSnake();
+        Bitboard free = Bitboard::FreeCells(snake, BitboardSize, BitboardSize);
+        Point start = game.GetFood();
+        for(uint32_t k = 0; k < FloodFillKernelCount(); ++k)
+            Measure(opt, std::string("flood_fill/") + FloodFillKernelName(k), [&](uint64_t n)
+            {
+                uint64_t cells = 0;
+                for(uint64_t i = 0; i < n; ++i)
+                    cells += FloodFill(free, start, k).Count();
+                sink += cells;
+            }, results);
+        Measure(opt, "flood_fill/reference", [&](uint64_t n)
+        {
+            uint64_t cells = 0;
+            for(uint64_t i = 0; i < n; ++i)
+                cells += CountReachable(snake, BitboardSize, BitboardSize, start, false);
+            sink += cells;
+        }, results);
+    }
+
+    void RenderCases(const Options& opt, std::vector<Result>& results)
+    {
+        const uint32_t sizes[] = { 8, 16, 32, 64 };
+        for(uint32_t size : sizes)
+        {
+            Game start = CycleStates(size, size, opt.seed)[2];  // half of the field covered
+            FieldRenderer renderer(BlockSize, BkColor);
+            renderer.SetView(size, size);
+            Measure(opt, "render_full/" + BoardName(size, size), [&](uint64_t n)
+            {
+                for(uint64_t k = 0; k < n; ++k)
+                {
+                    renderer.Invalidate();
+                    renderer.Update(start, { 0, 0 }, true);
+                    renderer.ClearDirty();
+                }
+                sink += renderer.Pixels()[renderer.PixelWidth() * renderer.PixelHeight() / 2];
+            }, results);
+
+            Measure(opt, "render_tick/" + BoardName(size, size), [&](uint64_t n)
+            {
+                Game game = start;
+                renderer.Update(game, { 0, 0 }, true);
+                uint64_t rects = 0;
+                for(uint64_t k = 0; k < n; ++k)
+                {
+                    Snake& snake = game.GetSnake();
+                    snake.SetDirection(CycleDirection(snake.GetHead(), size, size));
+                    if(game.Step() == Game::Won)
+                        game = start;
+                    renderer.Update(game, { 0, 0 }, true);
+                    rects += renderer.Dirty().size();
+                    renderer.ClearDirty();
+                }
+                sink += rects;
+            }, results);
+        }
+    }
+
+    // A record of a square field of 8 to 32 with a name of 3 to 10 letters
+    void AddRandomScore(RandGen& rng, uint32_t score, ScoreBuilder& records)
+    {
+        ScoreChar name[10];
+        uint32_t size = 8 + rng.Below(25);
+        ScoreEntry entry = { size, size, score, 3 + rng.Below(8), name };
+        for(uint32_t k = 0; k < entry.nameLength; ++k)
+            name[k] = (ScoreChar)('a' + rng.Below(26));
+        records.Add(entry);
+    }
+
+    void ScoreCases(const Options& opt, std::vector<Result>& results)
+    {
+        // A full table of names of 3 to 10 characters in the resource layout
+        RandGen rng(opt.seed, 2);
+        ScoreBuilder records;
+        for(uint32_t i = 0; i < ScoreRecords; ++i)
+            AddRandomScore(rng, 1000 - 50 * i, records);
+        std::vector<uint8_t> resource(sizeof(uint32_t) + records.Size());
+        memcpy(resource.data(), &ScoreRecords, sizeof(uint32_t));
+        memcpy(resource.data() + sizeof(uint32_t), records.Data(), records.Size());
+        std::string suffix = "/" + std::to_string(ScoreRecords);
+
+        Measure(opt, "scores_view" + suffix, [&](uint64_t n)
+        {
+            // As App::LoadScoresData: the table is checked once, then the records are read in place
+            uint64_t sum = 0;
+            for(uint64_t k = 0; k < n; ++k)
+            {
+                ScoreView view(resource.data(), resource.size());
+                view.ForEach([&sum](uint32_t, const ScoreEntry& entry) { sum += entry.score + entry.name[0]; });
+            }
+            sink += sum;
+        }, results);
+
+        std::vector<ScoreEntry> entries;
+        records.View().ForEach([&entries](uint32_t, const ScoreEntry& entry) { entries.push_back(entry); });
+        ScoreBuilder out;
+        Measure(opt, "scores_build" + suffix, [&](uint64_t n)
+        {
+            for(uint64_t k = 0; k < n; ++k)
+            {
+                out.Clear();
+                for(const auto& entry : entries)
+                    out.Add(entry);
+            }
+            sink += out.Data()[out.Size() / 2];
+        }, results);
+    }
+
+    bool JournalCases(const Options& opt, std::vector<Result>& results)
+    {
+        std::string suffix = "/" + std::to_string(JournalRecords);
+        if(!opt.filter.empty() && ("journal_load" + suffix).find(opt.filter) == std::string::npos
+            && ("journal_compact" + suffix).find(opt.filter) == std::string::npos)
+            return true;
+
+        remove(JournalFileName);
+        ScoreJournal journal(JournalFileName);
+        RandGen rng(opt.seed, 4);
+        {
+            ScoreBuilder records;
+            for(uint32_t i = 0; i < JournalRecords; ++i)
+                AddRandomScore(rng, rng.Below(100000), records);
+            journal.Append(records);
+        }
+        if(!journal.Flush())
+        {
+            fprintf(stderr, "can't write %s\n", JournalFileName);
+            return false;
+        }
+
+        uint32_t loaded = 0;
+        Measure(opt, "journal_load" + suffix, [&](uint64_t n)
+        {
+            uint64_t sum = 0;
+            for(uint64_t k = 0; k < n; ++k)
+            {
+                ScoreView view;
+                journal.Map(view);
+                view.ForEach([&sum](uint32_t, const ScoreEntry& entry) { sum += entry.score; });
+                loaded = view.Count();
+            }
+            sink += sum;
+        }, results);
+        bool ok = loaded == 0 || loaded == JournalRecords;
+
+        Measure(opt, "journal_compact" + suffix, [&](uint64_t n)
+        {
+            for(uint64_t k = 0; k < n; ++k)
+                journal.Compact();
+            ok = journal.Flush() && ok;
+        }, results);
+        remove(JournalFileName);
+        if(!ok)
+            fprintf(stderr, "journal of %u records read back wrong\n", JournalRecords);
+        return ok;
+    }
+
+    void GameCases(const Options& opt, std::vector<Result>& results)
+    {
+        const char* policies[] = { "greedy", "autopilot" };
+        const uint32_t sizes[] = { 8, 16, 32 };
+        for(const char* policyName : policies)
+            for(uint32_t size : sizes)
+            {
+                // Game i always gets the same seed, as in SnakeSim
+                std::string suffix = std::string("/") + policyName + "/" + BoardName(size, size);
+                uint64_t ticks = 0;
+                bool ran = Measure(opt, "game" + suffix, [&](uint64_t n)
+                {
+                    Game game;
+                    ticks = 0;
+                    for(uint64_t i = 0; i < n; ++i)
+                    {
+                        uint64_t gameSeed = RandGen(opt.seed, i).Next64();
+                        auto policy = CreatePolicy(policyName, gameSeed);
+                        game.Reset(size, size, gameSeed);
+                        uint32_t lastMeal = 0;
+                        while(game.Ticks() - lastMeal < 4 * size * size)
+                        {
+                            game.GetSnake().SetDirection(policy->Decide(game));
+                            Game::StepResult res = game.Step();
+                            if(res == Game::Died || res == Game::Won)
+                                break;
+                            if(res == Game::Ate)
+                                lastMeal = game.Ticks();
+                        }
+                        ticks += game.Ticks();
+                    }
+                    sink += ticks;
+                }, results);
+                if(ran)
+                    results.push_back({ "game_tick" + suffix, ticks, results.back().seconds });
+            }
+    }
+
+    void AutopilotCases(const Options& opt, std::vector<Result>& results)
+    {
+        const uint32_t sizes[] = { 32, 256, 1024, 4096 };
+        for(uint32_t size : sizes)
+        {
+            Game game;
+            Planner planner;
+            uint64_t seed = RandGen(opt.seed, size).Next64(), ticks = 0;
+            game.Reset(size, size, seed);
+            Measure(opt, "autopilot_tick/" + BoardName(size, size), [&](uint64_t n)
+            {
+                for(uint64_t k = 0; k < n; ++k)
+                {
+                    game.GetSnake().SetDirection(planner.Decide(game));
+                    Game::StepResult res = game.Step();
+                    if(res == Game::Died || res == Game::Won || ++ticks == AutopilotTicks)
+                    {
+                        planner.Reset();
+                        game.Reset(size, size, seed);
+                        ticks = 0;
+                    }
+                }
+                sink += game.Score();
+            }, results);
+        }
+    }
+
+    void LeaderboardCases(const Options& opt, std::vector<Result>& results)
+    {
+        std::string suffix = "/" + std::to_string(LeaderboardRecords);
+        const char* names[] = { "leaderboard_insert", "leaderboard_rank", "leaderboard_field_rank", "leaderboard_top10" };
+        if(!opt.filter.empty() && std::none_of(std::begin(names), std::end(names),
+            [&](const char* name) { return (name + suffix).find(opt.filter) != std::string::npos; }))
+            return;
+
+        // Square fields of 8 to 32 with scores up to their area, ids in the order of insertion as in the journal
+        RandGen rng(opt.seed, 5);
+        Leaderboard board;
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t id = 0; id < LeaderboardRecords; ++id)
+        {
+            uint32_t size = 8 + rng.Below(25);
+            board.Insert(size, size, rng.Below(size * size), id);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(opt.filter.empty() || ("leaderboard_insert" + suffix).find(opt.filter) != std::string::npos)
+            results.push_back({ "leaderboard_insert" + suffix, LeaderboardRecords, seconds });
+
+        std::vector<uint32_t> queries(4096);
+        for(auto& q : queries)
+            q = rng.Below(32 * 32);
+        Measure(opt, "leaderboard_rank" + suffix, [&](uint64_t n)
+        {
+            uint64_t sum = 0;
+            for(uint64_t k = 0; k < n; ++k)
+                sum += board.Rank(queries[k % queries.size()]);
+            sink += sum;
+        }, results);
+        Measure(opt, "leaderboard_field_rank" + suffix, [&](uint64_t n)
+        {
+            uint64_t sum = 0;
+            for(uint64_t k = 0; k < n; ++k)
+            {
+                uint32_t q = queries[k % queries.size()], size = 8 + q % 25;
+                sum += board.Rank(size, size, q % (size * size));
+            }
+            sink += sum;
+        }, results);
+        Measure(opt, "leaderboard_top10" + suffix, [&](uint64_t n)
+        {
+            uint64_t sum = 0;
+            uint32_t ids[10];
+            for(uint64_t k = 0; k < n; ++k)
+            {
+                uint32_t size = 8 + (uint32_t)(k % 25);
+                sum += board.Top(size, size, ids, 10) + ids[0];
+            }
+            sink += sum;
+        }, results);
+    }
+
+    void MetricsCases(const Options& opt, std::vector<Result>& results)
+    {
+        // Durations from 100 ns to 100 ms, so the records hit buckets all over the histogram as ticks and paints do
+        RandGen rng(opt.seed, 3);
+        std::vector<int64_t> samples(4096);
+        for(auto& s : samples)
+            s = (int64_t)(100 * std::pow(10.0, rng.Below(6000) / 1000.0));
+        LatencyHistogram histogram;
+
+        Measure(opt, "metrics_record", [&](uint64_t n)
+        {
+            for(uint64_t k = 0; k < n; ++k)
+                histogram.Record(samples[k % samples.size()]);
+            sink += histogram.Count();
+        }, results);
+
+        const TickClock& clock = SteadyTickClock();
+        Measure(opt, "metrics_timed", [&](uint64_t n)
+        {
+            for(uint64_t k = 0; k < n; ++k)
+            {
+                int64_t start = clock.Now();
+                histogram.Record(clock.Now() - start);
+            }
+            sink += histogram.Count();
+        }, results);
+    }
+
+    void TraceCases(const Options& opt, std::vector<Result>& results)
+    {
+        for(bool on : { true, false })
+        {
+            if(on)
+                Trace::Start();
+            Measure(opt, on ? "trace_span/on" : "trace_span/off", [](uint64_t n)
+            {
+                for(uint64_t k = 0; k < n; ++k)
+                    TraceSpan span("bench");
+            }, results);
+            Trace::Stop();
+        }
+    }
+
+    void WriteResults(FILE* file, const Options& opt, const std::vector<Result>& results)
+    {
+        if(opt.json)
+        {
+            fprintf(file, "{\n  \"seed\": %" PRIu64 ",\n  \"min_ms\": %u,\n  \"results\": [", opt.seed, opt.minMs);
+            for(size_t i = 0; i < results.size(); ++i)
+            {
+                const Result& r = results[i];
+                fprintf(file, "%s\n    { \"name\": \"%s\", \"iterations\": %" PRIu64 ", \"seconds\": %.6f, \"ns_per_iter\": %.3f, \"iters_per_sec\": %.1f }",
+                    i ? "," : "", r.name.c_str(), r.iterations, r.seconds, r.seconds * 1e9 / r.iterations, r.iterations / r.seconds);
+            }
+            fprintf(file, "\n  ]\n}\n");
+        }
+        else
+        {
+            fprintf(file, "name,iterations,seconds,ns_per_iter,iters_per_sec\n");
+            for(const auto& r : results)
+                fprintf(file, "%s,%" PRIu64 ",%.6f,%.3f,%.1f\n", r.name.c_str(), r.iterations, r.seconds, r.seconds * 1e9 / r.iterations, r.iterations / r.seconds);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if(!ParseOptions(argc, argv, opt))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<Result> results;
+    EngineCases(opt, 16, 16, results);
+    EngineCases(opt, 64, 64, results);
+    BlendCases(opt, results);
+    FloodFillCases(opt, results);
+    RenderCases(opt, results);
+    ScoreCases(opt, results);
+    if(!JournalCases(opt, results))
+        return 1;
+    LeaderboardCases(opt, results);
+    GameCases(opt, results);
+    AutopilotCases(opt, results);
+    MetricsCases(opt, results);
+    TraceCases(opt, results);
+
+    FILE* file = opt.outFile.empty() ? stdout : fopen(opt.outFile.c_str(), "w");
+    if(!file)
+    {
+        fprintf(stderr, "can't write %s\n", opt.outFile.c_str());
+        return 1;
+    }
+    WriteResults(file, opt, results);
+    return (file == stdout || fclose(file) == 0) ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+#include "BatchEnv.h"
+#include "Bits.h"
+
+// BatchEnv class methods ------------------------------------------------------------------------------------------------
+BatchEnv::BatchEnv(uint32_t nGames, uint32_t fieldWidth, uint32_t fieldHeight, uint64_t seed)
+    : nGames(nGames), width(fieldWidth), height(fieldHeight), cells(fieldWidth * fieldHeight), words((cells + 63) / 64), linkBytes((cells + 3) / 4),
+    headX(nGames), headY(nGames), dir(nGames), growing(nGames), food(nGames), length(nGames), score(nGames), ticks(nGames),
+    finalScore(nGames), finalLength(nGames), finalTicks(nGames), headCell(nGames), tailCell(nGames),
+    links((size_t)nGames * linkBytes), occupancy((size_t)nGames * words), rng(nGames), nextCell(nGames), blocked(nGames)
+{
+    Reset(seed);
+}
+void BatchEnv::Reset(uint64_t seed)
+{
+    for(uint32_t i = 0; i < nGames; ++i)
+    {
+        rng[i].Seed(seed, i);
+        finalScore[i] = finalLength[i] = finalTicks[i] = 0;
+        ResetGame(i);
+    }
+}
+void BatchEnv::Step(const Snake::Direction* actions, Game::StepResult* results)
+{
+    // The loops work on local copies of the sizes and array pointers: the byte arrays may alias anything,
+    // so stores through them would otherwise make the compiler reload every member on each iteration.
+    const uint32_t n = nGames, w = width, h = height, nCells = cells, nWords = words;
+    int32_t* hx = headX.data();
+    int32_t* hy = headY.data();
+    uint8_t* d = dir.data();
+    uint8_t* grow = growing.data();
+    uint32_t* next = nextCell.data();
+    uint8_t* hit = blocked.data();
+    uint32_t* len = length.data();
+    uint32_t* head = headCell.data();
+    uint32_t* tail = tailCell.data();
+    uint64_t* occ = occupancy.data();
+    uint8_t* link = links.data();
+    const uint32_t nLinkBytes = linkBytes;
+    const int32_t cellStep[4] = { -(int32_t)w, (int32_t)w, 1, -1 };
+
+    // Next head and wall hits of all games. Directions map to offsets arithmetically rather than through
+    // a switch or a table so the loop has no branches or gathers and vectorizes. The head is stored right away,
+    // a game that hit something is reset below anyway.
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        int32_t a = actions[i];
+        int32_t vertical = 1 - (a >> 1);  // UP and DOWN
+        int32_t x = hx[i] + (a >> 1) * (5 - 2 * a);  // RIGHT +1, LEFT -1
+        int32_t y = hy[i] + vertical * (2 * a - 1);  // UP -1, DOWN +1
+        uint32_t inside = ((uint32_t)x < w) & ((uint32_t)y < h);
+        next[i] = inside * (uint32_t)(y * (int32_t)w + x);
+        hit[i] = (uint8_t)(inside ^ 1);
+        d[i] = (uint8_t)a;
+        hx[i] = x;
+        hy[i] = y;
+    }
+
+    // Body hits: one bit load per game. The tail is still in the bitmap, so moving into it is a collision as in Snake::Move.
+    for(uint32_t i = 0; i < n; ++i)
+        hit[i] |= (uint8_t)((occ[(size_t)i * nWords + next[i] / 64] >> (next[i] % 64)) & 1);
+
+    // Moves without branches on the common path: the old head links to the new one, a growing snake keeps its tail
+    // and the others free the tail cell and follow its link
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        ++ticks[i];
+        if(hit[i])
+        {
+            results[i] = Game::Died;
+            EndGame(i);
+            continue;
+        }
+
+        uint64_t* gameOcc = occ + (size_t)i * nWords;
+        uint8_t* gameLink = link + (size_t)i * nLinkBytes;
+        uint32_t cell = next[i], neck = head[i], shift = neck % 4 * 2;
+        gameLink[neck / 4] = (uint8_t)((gameLink[neck / 4] & ~(3u << shift)) | (uint32_t)d[i] << shift);
+
+        uint32_t moveTail = grow[i] ^ 1, t = tail[i];
+        gameOcc[t / 64] &= ~((uint64_t)moveTail << (t % 64));
+        tail[i] = t + moveTail * cellStep[(gameLink[t / 4] >> (t % 4 * 2)) & 3];
+        len[i] += grow[i];
+        grow[i] = 0;
+        head[i] = cell;
+        gameOcc[cell / 64] |= 1ull << (cell % 64);
+
+        if(cell != food[i])
+        {
+            results[i] = Game::Moved;
+            continue;
+        }
+        grow[i] = 1;
+        ++score[i];
+        if(len[i] == nCells)
+        {
+            results[i] = Game::Won;
+            EndGame(i);
+            continue;
+        }
+        SpawnFood(i);
+        results[i] = Game::Ate;
+    }
+}
+void BatchEnv::EndGame(uint32_t game)
+{
+    finalScore[game] = score[game];
+    finalLength[game] = length[game];
+    finalTicks[game] = ticks[game];
+    ResetGame(game);
+}
+void BatchEnv::ResetGame(uint32_t game)
+{
+    // Same start as Snake::Reset: four segments in the middle column, heading up
+    uint64_t* occ = occupancy.data() + (size_t)game * words;
+    for(uint32_t w = 0; w < words; ++w)
+        occ[w] = 0;
+    uint8_t* link = links.data() + (size_t)game * linkBytes;
+    int32_t x = (int32_t)width / 2, y = (int32_t)height / 2 + 2;
+    for(uint32_t i = 0; i < 4; ++i, --y)
+    {
+        uint32_t cell = (uint32_t)(y * (int32_t)width + x), shift = cell % 4 * 2;
+        link[cell / 4] = (uint8_t)((link[cell / 4] & ~(3u << shift)) | Snake::UP << shift);
+        SetCell(game, cell);
+    }
+
+    headX[game] = x;
+    headY[game] = y + 1;
+    headCell[game] = (uint32_t)((y + 1) * (int32_t)width + x);
+    tailCell[game] = headCell[game] + 3 * width;
+    dir[game] = Snake::UP;
+    growing[game] = 0;
+    length[game] = 4;
+    score[game] = 0;
+    ticks[game] = 0;
+    SpawnFood(game);
+}
+void BatchEnv::SpawnFood(uint32_t game)
+{
+    // Uniform over the free cells: pick a rank, then find the free cell of that rank word by word
+    const uint64_t* occ = Occupancy(game);
+    uint32_t n = rng[game].Below(cells - length[game]);
+    for(uint32_t w = 0; ; ++w)
+    {
+        uint64_t free = ~occ[w];
+        if(w == words - 1 && cells % 64)
+            free &= (1ull << (cells % 64)) - 1;
+        uint32_t count = PopCount(free);
+        if(n < count)
+        {
+            food[game] = w * 64 + SelectBit(free, n);
+            return;
+        }
+        n -= count;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+// Many independent games of one field size stepped together, for training and evaluating policies in bulk.
+// The state is kept as structure of arrays: one array per field with an entry per game, so a step runs over
+// flat arrays instead of chasing separate Game objects.
+//
+// The rules are those of Game::Step: moving into a wall or any body cell, the tail included, ends the game,
+// eating grows the snake on the next move and the game is won once the body fills the field.
+// A game that ended is reset on the same step, its generator continues so the run stays reproducible.
+// The food is drawn uniformly from the free cells like in Game, but not in the same order, so a game here
+// doesn't replay the Game with the same seed.
+
+#include "SnakeCore.h"
+#include <cstddef>
+#include <vector>
+
+class BatchEnv
+{
+public:
+    BatchEnv(uint32_t nGames, uint32_t fieldWidth, uint32_t fieldHeight, uint64_t seed);
+
+    // Restarts every game, game i draws from stream i of seed
+    void Reset(uint64_t seed);
+    // Moves game i in direction actions[i] and stores the outcome in results[i]. Games that died or won are
+    // already reset when Step returns, so the state seen afterwards is the first tick of their next round.
+    void Step(const Snake::Direction* actions, Game::StepResult* results);
+
+    uint32_t Size() const;
+    uint32_t Width() const;
+    uint32_t Height() const;
+    Point GetHead(uint32_t game) const;
+    Point GetFood(uint32_t game) const;
+    Snake::Direction GetDirection(uint32_t game) const;
+    uint32_t BodySize(uint32_t game) const;
+    uint32_t Score(uint32_t game) const;
+    uint32_t Ticks(uint32_t game) const;
+    // Score, length and ticks a game had when its last round ended, 0 before the first round ends
+    uint32_t FinalScore(uint32_t game) const;
+    uint32_t FinalBodySize(uint32_t game) const;
+    uint32_t FinalTicks(uint32_t game) const;
+    // Body cells of a game as a bitmap of WordsPerGame() words, cell y * width + x is bit (cell % 64) of word cell / 64
+    const uint64_t* Occupancy(uint32_t game) const;
+    uint32_t WordsPerGame() const;
+
+private:
+    void EndGame(uint32_t game);
+    void ResetGame(uint32_t game);
+    void SpawnFood(uint32_t game);
+    void SetCell(uint32_t game, uint32_t cell);
+    void ClearCell(uint32_t game, uint32_t cell);
+
+private:
+    uint32_t nGames;
+    uint32_t width;
+    uint32_t height;
+    uint32_t cells;
+    uint32_t words;
+    uint32_t linkBytes;
+
+    std::vector<int32_t> headX;
+    std::vector<int32_t> headY;
+    std::vector<uint8_t> dir;
+    std::vector<uint8_t> growing;      // the food was eaten and the next move doesn't move the tail
+    std::vector<uint32_t> food;        // cell index
+    std::vector<uint32_t> length;
+    std::vector<uint32_t> score;
+    std::vector<uint32_t> ticks;
+    std::vector<uint32_t> finalScore;
+    std::vector<uint32_t> finalLength;
+    std::vector<uint32_t> finalTicks;
+    std::vector<uint32_t> headCell;
+    std::vector<uint32_t> tailCell;
+    // Direction from every body cell but the head to the next segment, 2 bits per cell and linkBytes per game.
+    // The tail follows it when it moves, so the body is stored in a quarter of a byte per cell instead of a ring
+    // of cell indices, which keeps a batch of thousands of games in cache.
+    std::vector<uint8_t> links;
+    std::vector<uint64_t> occupancy;   // words entries per game
+    std::vector<RandGen> rng;
+
+    // Per step scratch, kept to avoid allocating on every call
+    std::vector<uint32_t> nextCell;
+    std::vector<uint8_t> blocked;
+};
+
+// BatchEnv class methods ------------------------------------------------------------------------------------------------
+inline uint32_t BatchEnv::Size() const { return nGames; }
+inline uint32_t BatchEnv::Width() const { return width; }
+inline uint32_t BatchEnv::Height() const { return height; }
+inline Point BatchEnv::GetHead(uint32_t game) const { return { headX[game], headY[game] }; }
+inline Point BatchEnv::GetFood(uint32_t game) const { return { (int32_t)(food[game] % width), (int32_t)(food[game] / width) }; }
+inline Snake::Direction BatchEnv::GetDirection(uint32_t game) const { return (Snake::Direction)dir[game]; }
+inline uint32_t BatchEnv::BodySize(uint32_t game) const { return length[game]; }
+inline uint32_t BatchEnv::Score(uint32_t game) const { return score[game]; }
+inline uint32_t BatchEnv::Ticks(uint32_t game) const { return ticks[game]; }
+inline uint32_t BatchEnv::FinalScore(uint32_t game) const { return finalScore[game]; }
+inline uint32_t BatchEnv::FinalBodySize(uint32_t game) const { return finalLength[game]; }
+inline uint32_t BatchEnv::FinalTicks(uint32_t game) const { return finalTicks[game]; }
+inline const uint64_t* BatchEnv::Occupancy(uint32_t game) const { return occupancy.data() + (size_t)game * words; }
+inline uint32_t BatchEnv::WordsPerGame() const { return words; }
+inline void BatchEnv::SetCell(uint32_t game, uint32_t cell) { occupancy[(size_t)game * words + cell / 64] |= 1ull << (cell % 64); }
+inline void BatchEnv::ClearCell(uint32_t game, uint32_t cell) { occupancy[(size_t)game * words + cell / 64] &= ~(1ull << (cell % 64)); }
@@ -0,0 +1,229 @@
+#include "Bitboard.h"
+#include "Bits.h"
+
+#if defined(SNAKE_BITBOARD_AVX2)
+#include <immintrin.h>
+#elif defined(SNAKE_BITBOARD_SSE2)
+#include <emmintrin.h>
+#endif
+
+// Every kernel the target can run is built: SSE2 along with AVX2, and the scalar one always. FloodFill runs the widest.
+
+// The fill alternates two steps until nothing changes:
+//  - every row is filled along its runs of free cells in both directions at once (Kogge-Stone occluded fill,
+//    five shift-and-mask rounds per direction);
+//  - the region spreads one row up and one row down, masked by the free cells.
+// So each round covers a whole horizontal run and the number of rounds is about the number of vertical turns
+// on the longest path through the region.
+
+namespace
+{
+#if defined(SNAKE_BITBOARD_AVX2)
+    inline __m256i FillRows(__m256i seed, __m256i free)
+    {
+        __m256i up = seed, down = seed, gUp = free, gDown = free;
+#define SNAKE_FILL_ROUND(n) \
+        up = _mm256_or_si256(up, _mm256_and_si256(gUp, _mm256_slli_epi32(up, n))); \
+        down = _mm256_or_si256(down, _mm256_and_si256(gDown, _mm256_srli_epi32(down, n))); \
+        gUp = _mm256_and_si256(gUp, _mm256_slli_epi32(gUp, n)); \
+        gDown = _mm256_and_si256(gDown, _mm256_srli_epi32(gDown, n));
+        SNAKE_FILL_ROUND(1) SNAKE_FILL_ROUND(2) SNAKE_FILL_ROUND(4) SNAKE_FILL_ROUND(8)
+#undef SNAKE_FILL_ROUND
+        up = _mm256_or_si256(up, _mm256_and_si256(gUp, _mm256_slli_epi32(up, 16)));
+        down = _mm256_or_si256(down, _mm256_and_si256(gDown, _mm256_srli_epi32(down, 16)));
+        return _mm256_or_si256(up, down);
+    }
+
+    void FloodFillRowsAvx2(const uint32_t* freeRows, uint32_t* regionRows)
+    {
+        constexpr int nRegs = BitboardSize / 8;
+        const __m256i toNext = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);  // lane i takes lane i + 1
+        const __m256i toPrev = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);  // lane i takes lane i - 1
+        __m256i free[nRegs], region[nRegs];
+        for(int k = 0; k < nRegs; ++k)
+        {
+            free[k] = _mm256_load_si256((const __m256i*)freeRows + k);
+            region[k] = _mm256_load_si256((const __m256i*)regionRows + k);
+        }
+        for(;;)
+        {
+            __m256i next[nRegs + 1], prev[nRegs + 1];
+            for(int k = 0; k < nRegs; ++k)
+            {
+                region[k] = FillRows(region[k], free[k]);
+                next[k] = _mm256_permutevar8x32_epi32(region[k], toNext);
+                prev[k + 1] = _mm256_permutevar8x32_epi32(region[k], toPrev);
+            }
+            next[nRegs] = prev[0] = _mm256_setzero_si256();
+
+            __m256i added = _mm256_setzero_si256();
+            for(int k = 0; k < nRegs; ++k)
+            {
+                // Row y receives rows y + 1 and y - 1, crossing register borders through the neighbour's rotated lanes
+                __m256i below = _mm256_blend_epi32(next[k], next[k + 1], 0x80);
+                __m256i above = _mm256_blend_epi32(prev[k + 1], prev[k], 0x01);
+                __m256i grown = _mm256_andnot_si256(region[k], _mm256_and_si256(free[k], _mm256_or_si256(below, above)));
+                region[k] = _mm256_or_si256(region[k], grown);
+                added = _mm256_or_si256(added, grown);
+            }
+            if(_mm256_testz_si256(added, added))
+                break;
+        }
+        for(int k = 0; k < nRegs; ++k)
+            _mm256_store_si256((__m256i*)regionRows + k, region[k]);
+    }
+#endif
+
+#if defined(SNAKE_BITBOARD_AVX2) || defined(SNAKE_BITBOARD_SSE2)
+    inline __m128i FillRows(__m128i seed, __m128i free)
+    {
+        __m128i up = seed, down = seed, gUp = free, gDown = free;
+#define SNAKE_FILL_ROUND(n) \
+        up = _mm_or_si128(up, _mm_and_si128(gUp, _mm_slli_epi32(up, n))); \
+        down = _mm_or_si128(down, _mm_and_si128(gDown, _mm_srli_epi32(down, n))); \
+        gUp = _mm_and_si128(gUp, _mm_slli_epi32(gUp, n)); \
+        gDown = _mm_and_si128(gDown, _mm_srli_epi32(gDown, n));
+        SNAKE_FILL_ROUND(1) SNAKE_FILL_ROUND(2) SNAKE_FILL_ROUND(4) SNAKE_FILL_ROUND(8)
+#undef SNAKE_FILL_ROUND
+        up = _mm_or_si128(up, _mm_and_si128(gUp, _mm_slli_epi32(up, 16)));
+        down = _mm_or_si128(down, _mm_and_si128(gDown, _mm_srli_epi32(down, 16)));
+        return _mm_or_si128(up, down);
+    }
+
+    void FloodFillRowsSse2(const uint32_t* freeRows, uint32_t* regionRows)
+    {
+        constexpr int nRegs = BitboardSize / 4;
+        __m128i free[nRegs], region[nRegs + 2];
+        region[0] = region[nRegs + 1] = _mm_setzero_si128();
+        for(int k = 0; k < nRegs; ++k)
+        {
+            free[k] = _mm_load_si128((const __m128i*)freeRows + k);
+            region[k + 1] = _mm_load_si128((const __m128i*)regionRows + k);
+        }
+        for(;;)
+        {
+            for(int k = 1; k <= nRegs; ++k)
+                region[k] = FillRows(region[k], free[k - 1]);
+
+            __m128i added = _mm_setzero_si128();
+            __m128i prevRegion = region[0];
+            for(int k = 1; k <= nRegs; ++k)
+            {
+                // Row y receives rows y + 1 and y - 1, the byte shifts carry the border rows over from the neighbours
+                __m128i below = _mm_or_si128(_mm_srli_si128(region[k], 4), _mm_slli_si128(region[k + 1], 12));
+                __m128i above = _mm_or_si128(_mm_slli_si128(region[k], 4), _mm_srli_si128(prevRegion, 12));
+                __m128i grown = _mm_andnot_si128(region[k], _mm_and_si128(free[k - 1], _mm_or_si128(below, above)));
+                prevRegion = region[k];
+                region[k] = _mm_or_si128(region[k], grown);
+                added = _mm_or_si128(added, grown);
+            }
+            if(_mm_movemask_epi8(_mm_cmpeq_epi32(added, _mm_setzero_si128())) == 0xFFFF)
+                break;
+        }
+        for(int k = 0; k < nRegs; ++k)
+            _mm_store_si128((__m128i*)regionRows + k, region[k + 1]);
+    }
+#endif
+
+    inline uint32_t FillRow(uint32_t seed, uint32_t free)
+    {
+        uint32_t up = seed, down = seed, gUp = free, gDown = free;
+        for(int n = 1; n < 32; n <<= 1)
+        {
+            up |= gUp & (up << n);
+            down |= gDown & (down >> n);
+            gUp &= gUp << n;
+            gDown &= gDown >> n;
+        }
+        return up | down;
+    }
+
+    void FloodFillRowsScalar(const uint32_t* freeRows, uint32_t* regionRows)
+    {
+        for(;;)
+        {
+            for(uint32_t y = 0; y < BitboardSize; ++y)
+                regionRows[y] = FillRow(regionRows[y], freeRows[y]);
+
+            uint32_t added = 0, prevRow = 0;
+            for(uint32_t y = 0; y < BitboardSize; ++y)
+            {
+                uint32_t below = (y + 1 < BitboardSize) ? regionRows[y + 1] : 0;
+                uint32_t grown = freeRows[y] & (below | prevRow) & ~regionRows[y];
+                prevRow = regionRows[y];
+                regionRows[y] |= grown;
+                added |= grown;
+            }
+            if(!added)
+                break;
+        }
+    }
+
+    struct Kernel
+    {
+        const char* name;
+        void (*fill)(const uint32_t* freeRows, uint32_t* regionRows);
+    };
+    const Kernel Kernels[] =
+    {
+#if defined(SNAKE_BITBOARD_AVX2)
+        { "avx2", FloodFillRowsAvx2 },
+#endif
+#if defined(SNAKE_BITBOARD_AVX2) || defined(SNAKE_BITBOARD_SSE2)
+        { "sse2", FloodFillRowsSse2 },
+#endif
+        { "scalar", FloodFillRowsScalar },
+    };
+}
+
+// Bitboard struct methods ------------------------------------------------------------------------------------------------
+Bitboard Bitboard::Field(uint32_t width, uint32_t height)
+{
+    Bitboard b;
+    uint32_t rowMask = (width >= 32) ? ~0u : (1u << width) - 1;
+    for(uint32_t y = 0; y < BitboardSize; ++y)
+        b.rows[y] = (y < height) ? rowMask : 0;
+    return b;
+}
+Bitboard Bitboard::FreeCells(const Snake& snake, uint32_t width, uint32_t height)
+{
+    Bitboard b = Field(width, height);
+    for(Point p : snake.Body())
+        b.Clear(p);
+    return b;
+}
+uint32_t Bitboard::Count() const
+{
+    uint32_t n = 0;
+    for(uint32_t row : rows)
+        n += PopCount(row);
+    return n;
+}
+
+Bitboard FloodFill(const Bitboard& free, Point start)
+{
+    return FloodFill(free, start, 0);
+}
+Bitboard FloodFill(const Bitboard& free, Point start, uint32_t kernel)
+{
+    Bitboard region = {};
+    region.Set(start);
+    Kernels[kernel].fill(free.rows, region.rows);
+    return region;
+}
+uint32_t ReachableArea(const Bitboard& free, Point start)
+{
+    return FloodFill(free, start).Count();
+}
+const char* FloodFillKernel()
+{
+    return Kernels[0].name;
+}
+uint32_t FloodFillKernelCount()
+{
+    return (uint32_t)(sizeof(Kernels) / sizeof(Kernels[0]));
+}
+const char* FloodFillKernelName(uint32_t kernel)
+{
+    return Kernels[kernel].name;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// One bit per field cell for fields of at most 32x32: row y is rows[y], column x is bit x.
+// Flood fills run on whole rows at once with SIMD when the build targets it.
+
+#include "SnakeCore.h"
+
+#if defined(__AVX2__)
+#define SNAKE_BITBOARD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SNAKE_BITBOARD_SSE2
+#endif
+
+constexpr uint32_t BitboardSize = 32;
+
+// Larger fields have to be searched cell by cell instead
+inline bool FitsBitboard(uint32_t width, uint32_t height) { return width <= BitboardSize && height <= BitboardSize; }
+
+struct Bitboard
+{
+    alignas(32) uint32_t rows[BitboardSize];
+
+    // All cells of a width x height field set
+    static Bitboard Field(uint32_t width, uint32_t height);
+    // Field cells not covered by the snake body
+    static Bitboard FreeCells(const Snake& snake, uint32_t width, uint32_t height);
+
+    bool Test(Point p) const { return (rows[p.y] >> p.x) & 1; }
+    void Set(Point p) { rows[p.y] |= 1u << p.x; }
+    void Clear(Point p) { rows[p.y] &= ~(1u << p.x); }
+    uint32_t Count() const;
+};
+
+// Cells of free connected to start through steps between side neighbours, start itself must be in free
+Bitboard FloodFill(const Bitboard& free, Point start);
+// The same with kernel number kernel, below FloodFillKernelCount(), to check the kernels against each other
+Bitboard FloodFill(const Bitboard& free, Point start, uint32_t kernel);
+// Number of cells in FloodFill(free, start)
+uint32_t ReachableArea(const Bitboard& free, Point start);
+// Name of the flood fill kernel FloodFill runs: "avx2", "sse2" or "scalar"
+const char* FloodFillKernel();
+// Kernels built for the target, the one FloodFill runs first and "scalar" last
+uint32_t FloodFillKernelCount();
+const char* FloodFillKernelName(uint32_t kernel);
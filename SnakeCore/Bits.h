@@ -0,0 +1,69 @@
+#pragma once
+
+// Counting and finding the set bits of 64-bit words with the compiler's intrinsics. The POPCNT instruction is used
+// only where the build targets it (-mpopcnt or an -march that has it, /arch:AVX and up with MSVC): elsewhere
+// __builtin_popcountll is a library call and __popcnt64 faults on CPUs without it, so a few shifts and a multiply
+// count instead.
+
+#include <cstdint>
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+// Number of set bits of v
+inline uint32_t PopCount(uint64_t v)
+{
+#if defined _MSC_VER && defined _M_X64 && defined __AVX__
+    return (uint32_t)__popcnt64(v);
+#elif defined __POPCNT__
+    return (uint32_t)__builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    return (uint32_t)((((v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full) * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+// Position of the lowest set bit of v, v must not be 0
+inline uint32_t LowBit(uint64_t v)
+{
+#if defined _MSC_VER && (defined _M_X64 || defined _M_ARM64)
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return i;
+#elif defined _MSC_VER
+    unsigned long i;
+    if(_BitScanForward(&i, (unsigned long)v))
+        return i;
+    _BitScanForward(&i, (unsigned long)(v >> 32));
+    return i + 32;
+#else
+    return (uint32_t)__builtin_ctzll(v);
+#endif
+}
+
+// Position of the highest set bit of v, v must not be 0
+inline uint32_t HighBit(uint64_t v)
+{
+#if defined _MSC_VER && (defined _M_X64 || defined _M_ARM64)
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return i;
+#elif defined _MSC_VER
+    unsigned long i;
+    if(_BitScanReverse(&i, (unsigned long)(v >> 32)))
+        return i + 32;
+    _BitScanReverse(&i, (unsigned long)v);
+    return i;
+#else
+    return 63 - (uint32_t)__builtin_clzll(v);
+#endif
+}
+
+// Position of the n-th (from 0) set bit of v, v must have more than n bits set
+inline uint32_t SelectBit(uint64_t v, uint32_t n)
+{
+    for(; n; --n)
+        v &= v - 1;
+    return LowBit(v);
+}
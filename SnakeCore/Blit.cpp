@@ -0,0 +1,170 @@
+#include "Blit.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(SNAKE_BLIT_AVX2)
+#include <immintrin.h>
+#elif defined(SNAKE_BLIT_SSE2)
+#include <emmintrin.h>
+#endif
+
+// The kernels compute x * a / 255 rounded to nearest as (t + (t >> 8)) >> 8 with t = x * a + 128, which is exact
+// for all x and a in [0, 255] and keeps every intermediate within 16 bits.
+
+namespace
+{
+    struct Tap
+    {
+        uint32_t first;               // first source pixel covered
+        std::vector<double> weights;  // share of each covered source pixel, summing to 1
+    };
+
+    // Area covered by each of n destination pixels on a line of size source pixels
+    std::vector<Tap> BoxTaps(uint32_t size, uint32_t n)
+    {
+        std::vector<Tap> taps(n);
+        double scale = (double)size / n;
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            double lo = i * scale, hi = (i + 1) * scale;
+            Tap& tap = taps[i];
+            tap.first = (uint32_t)lo;
+            for(uint32_t j = tap.first; j < size && j < hi; ++j)
+                tap.weights.push_back((std::min(hi, j + 1.0) - std::max(lo, (double)j)) / scale);
+        }
+        return taps;
+    }
+
+    inline uint32_t MulDiv255(uint32_t x, uint32_t a)
+    {
+        uint32_t t = x * a + 128;
+        return (t + (t >> 8)) >> 8;
+    }
+
+    inline uint32_t BlendPixel(uint32_t d, uint32_t s)
+    {
+        uint32_t ia = 255 - (s >> 24), res = 0;
+        for(uint32_t shift = 0; shift < 32; shift += 8)
+        {
+            uint32_t c = ((s >> shift) & 0xFF) + MulDiv255((d >> shift) & 0xFF, ia);
+            res |= std::min(c, 255u) << shift;
+        }
+        return res;
+    }
+
+#if defined(SNAKE_BLIT_AVX2)
+    constexpr uint32_t PixelsPerStep = 8;
+
+    inline __m256i ScaleHalf(__m256i d16, __m256i ia16)
+    {
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(d16, ia16), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+    // Unpacking and packing both work within 128-bit lanes, so the pixels come back in their order
+    inline void BlendStep(uint32_t* dst, const uint32_t* src)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i*)src);
+        __m256i d = _mm256_loadu_si256((const __m256i*)dst);
+        __m256i zero = _mm256_setzero_si256();
+        __m256i ia = _mm256_sub_epi32(_mm256_set1_epi32(255), _mm256_srli_epi32(s, 24));
+        ia = _mm256_or_si256(ia, _mm256_slli_epi32(ia, 16));
+        __m256i lo = ScaleHalf(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi32(ia, ia));
+        __m256i hi = ScaleHalf(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi32(ia, ia));
+        _mm256_storeu_si256((__m256i*)dst, _mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi)));
+    }
+#elif defined(SNAKE_BLIT_SSE2)
+    constexpr uint32_t PixelsPerStep = 4;
+
+    inline __m128i ScaleHalf(__m128i d16, __m128i ia16)
+    {
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(d16, ia16), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+    inline void BlendStep(uint32_t* dst, const uint32_t* src)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)src);
+        __m128i d = _mm_loadu_si128((const __m128i*)dst);
+        __m128i zero = _mm_setzero_si128();
+        __m128i ia = _mm_sub_epi32(_mm_set1_epi32(255), _mm_srli_epi32(s, 24));
+        ia = _mm_or_si128(ia, _mm_slli_epi32(ia, 16));
+        __m128i lo = ScaleHalf(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(ia, ia));
+        __m128i hi = ScaleHalf(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(ia, ia));
+        _mm_storeu_si128((__m128i*)dst, _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+#else
+    constexpr uint32_t PixelsPerStep = 1;
+
+    inline void BlendStep(uint32_t* dst, const uint32_t* src) { *dst = BlendPixel(*dst, *src); }
+#endif
+}
+
+// SpriteAtlas class methods ------------------------------------------------------------------------------------------------
+SpriteAtlas::SpriteAtlas(uint32_t cellSize, uint32_t count)
+    : cellSize(cellSize), count(count), pixels((size_t)count * cellSize * cellSize, 0)
+{
+}
+void SpriteAtlas::Set(uint32_t index, const uint32_t* src, uint32_t width, uint32_t height, uint32_t stride, uint32_t keyColor)
+{
+    // Premultiplied before averaging, so transparent pixels add nothing of their color
+    std::vector<Tap> tapsX = BoxTaps(width, cellSize), tapsY = BoxTaps(height, cellSize);
+    uint32_t* dst = &pixels[(size_t)index * cellSize * cellSize];
+    for(uint32_t y = 0; y < cellSize; ++y)
+        for(uint32_t x = 0; x < cellSize; ++x)
+        {
+            double sum[4] = {};  // B, G, R, A
+            const Tap& ty = tapsY[y];
+            const Tap& tx = tapsX[x];
+            for(size_t j = 0; j < ty.weights.size(); ++j)
+                for(size_t i = 0; i < tx.weights.size(); ++i)
+                {
+                    uint32_t p = src[(size_t)(ty.first + j) * stride + tx.first + i];
+                    if((p & 0xFFFFFF) == keyColor)
+                        continue;
+                    double w = ty.weights[j] * tx.weights[i], a = (p >> 24) / 255.0;
+                    for(uint32_t c = 0; c < 3; ++c)
+                        sum[c] += w * a * ((p >> (8 * c)) & 0xFF);
+                    sum[3] += w * (p >> 24);
+                }
+            uint32_t alpha = (uint32_t)std::lround(std::min(sum[3], 255.0)), res = alpha << 24;
+            for(uint32_t c = 0; c < 3; ++c)
+                res |= std::min((uint32_t)std::lround(sum[c]), alpha) << (8 * c);
+            dst[y * cellSize + x] = res;
+        }
+}
+
+void BlendOver(uint32_t* dst, uint32_t dstStride, const uint32_t* src, uint32_t srcStride, uint32_t width, uint32_t height)
+{
+    uint32_t vectorWidth = width - width % PixelsPerStep;
+    for(uint32_t y = 0; y < height; ++y, dst += dstStride, src += srcStride)
+    {
+        uint32_t x = 0;
+        for(; x < vectorWidth; x += PixelsPerStep)
+            BlendStep(dst + x, src + x);
+        for(; x < width; ++x)
+            dst[x] = BlendPixel(dst[x], src[x]);
+    }
+}
+void BlendOverReference(uint32_t* dst, uint32_t dstStride, const uint32_t* src, uint32_t srcStride, uint32_t width, uint32_t height)
+{
+    for(uint32_t y = 0; y < height; ++y, dst += dstStride, src += srcStride)
+        for(uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t s = src[x], d = dst[x], ia = 255 - (s >> 24), res = 0;
+            for(uint32_t shift = 0; shift < 32; shift += 8)
+            {
+                uint32_t c = ((s >> shift) & 0xFF) + (2 * ((d >> shift) & 0xFF) * ia + 255) / 510;
+                res |= std::min(c, 255u) << shift;
+            }
+            dst[x] = res;
+        }
+}
+const char* BlitKernel()
+{
+#if defined(SNAKE_BLIT_AVX2)
+    return "avx2";
+#elif defined(SNAKE_BLIT_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Sprites and the blitter that composites them. Pixels are 32-bit 0xAARRGGBB. A SpriteAtlas holds square sprites
+// of one cell size, scaled and premultiplied by their alpha once when they are added, so drawing one is a single
+// "over" blend: dst = src + dst * (255 - src alpha) / 255 per channel. The blend runs 8 pixels per step with AVX2,
+// 4 with SSE2, or one at a time, whichever the build targets, and rounds exactly as BlendOverReference does.
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX2__)
+#define SNAKE_BLIT_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SNAKE_BLIT_SSE2
+#endif
+
+// Color key that matches no pixel
+constexpr uint32_t NoColorKey = 0xFF000000;
+
+class SpriteAtlas
+{
+public:
+    SpriteAtlas(uint32_t cellSize, uint32_t count);
+
+    // Replaces sprite index with the width x height image at pixels (straight alpha, stride in pixels). Pixels of
+    // keyColor (compared without alpha) are transparent. The image is scaled to the cell by averaging the area
+    // each sprite pixel covers, which leaves partly transparent edges where a color key had hard ones.
+    void Set(uint32_t index, const uint32_t* pixels, uint32_t width, uint32_t height, uint32_t stride, uint32_t keyColor = NoColorKey);
+
+    // Premultiplied pixels of the sprite, CellSize() rows of CellSize() pixels
+    const uint32_t* Sprite(uint32_t index) const;
+    uint32_t CellSize() const;
+    uint32_t Count() const;
+
+private:
+    uint32_t cellSize;
+    uint32_t count;
+    std::vector<uint32_t> pixels;
+};
+
+// Composites the premultiplied width x height block src over dst, strides in pixels
+void BlendOver(uint32_t* dst, uint32_t dstStride, const uint32_t* src, uint32_t srcStride, uint32_t width, uint32_t height);
+// The same blend a pixel at a time with plain rounding division, to check BlendOver against
+void BlendOverReference(uint32_t* dst, uint32_t dstStride, const uint32_t* src, uint32_t srcStride, uint32_t width, uint32_t height);
+// Name of the blend kernel compiled in: "avx2", "sse2" or "scalar"
+const char* BlitKernel();
+
+// SpriteAtlas class methods ------------------------------------------------------------------------------------------------
+inline const uint32_t* SpriteAtlas::Sprite(uint32_t index) const { return &pixels[(size_t)index * cellSize * cellSize]; }
+inline uint32_t SpriteAtlas::CellSize() const { return cellSize; }
+inline uint32_t SpriteAtlas::Count() const { return count; }
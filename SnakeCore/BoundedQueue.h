@@ -0,0 +1,53 @@
+#pragma once
+
+// Queue of at most a fixed number of items between threads. Push waits while the queue is full and Pop while it is
+// empty, so a fast producer can't run ahead of a slow consumer by more than the capacity. Close ends the stream:
+// Pop drains what is left and then returns false.
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator = (const BoundedQueue&) = delete;
+
+    void Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(guard);
+        notFull.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+    // False once the queue is closed and empty
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(guard);
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+        if(items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex guard;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
@@ -0,0 +1,46 @@
+#include "Input.h"
+#include <algorithm>
+
+// TurnQueue class methods ------------------------------------------------------------------------------------------------
+constexpr uint32_t TurnQueue::Capacity;
+
+TurnQueue::TurnQueue(int64_t maxAgeNs) : maxAge(maxAgeNs)
+{
+}
+void TurnQueue::Push(Snake::Direction d, int64_t time)
+{
+    if(count && turns[(first + count - 1) % Capacity].dir == d)
+        return;
+    if(count == Capacity)
+    {
+        first = (first + 1) % Capacity;
+        --count;
+        ++stats.overflowed;
+    }
+    turns[(first + count) % Capacity] = { d, time };
+    ++count;
+}
+bool TurnQueue::Apply(Snake& snake, int64_t now)
+{
+    for(; count; first = (first + 1) % Capacity, --count)
+    {
+        const Turn& turn = turns[first];
+        if(now - turn.time > maxAge)
+            ++stats.stale;
+        else if(turn.dir == snake.GetDirection() || !snake.IsValidDirection(turn.dir))
+            ++stats.ignored;
+        else
+        {
+            snake.SetDirection(turn.dir);
+            int64_t latency = now - turn.time;
+            ++stats.applied;
+            stats.totalLatencyNs += latency;
+            stats.maxLatencyNs = std::max(stats.maxLatencyNs, latency);
+            stats.lastLatencyNs = latency;
+            first = (first + 1) % Capacity;
+            --count;
+            return true;
+        }
+    }
+    return false;
+}
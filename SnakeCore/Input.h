@@ -0,0 +1,67 @@
+#pragma once
+
+// Turns pressed by the player, kept in the order they arrive with the time they arrived, so a quick sequence such as
+// up then left within one tick becomes two moves instead of only the last key counting. Before every tick the
+// frontend applies the queue to the snake: the oldest turn that changes the direction is taken, checked against
+// where the snake actually is at that tick, and the rest wait for later ticks. A turn older than the age limit when
+// its tick comes is dropped, so a burst of keys doesn't steer the snake long after the player has moved on.
+// Times are nanoseconds on a TickClock scale.
+
+#include "SnakeCore.h"
+
+// What became of the turns pushed so far
+struct TurnStats
+{
+    uint64_t applied = 0;
+    uint64_t ignored = 0;     // wouldn't have changed the direction, or would have reversed it
+    uint64_t stale = 0;       // older than the age limit when their tick came
+    uint64_t overflowed = 0;  // pushed out by newer turns while the queue was full
+    // From the arrival of an applied turn to the tick that moved the snake with it
+    int64_t totalLatencyNs = 0;
+    int64_t maxLatencyNs = 0;
+    int64_t lastLatencyNs = 0;  // of the turn applied last
+
+    double MeanLatencyMs() const;
+    double MaxLatencyMs() const;
+};
+
+class TurnQueue
+{
+public:
+    static constexpr uint32_t Capacity = 4;
+
+    explicit TurnQueue(int64_t maxAgeNs);
+
+    void SetMaxAge(int64_t maxAgeNs);
+    // Adds a turn unless it repeats the last one queued, the oldest goes if the queue is full
+    void Push(Snake::Direction d, int64_t time);
+    // Turns the snake by the oldest useful turn for the tick about to run at now, true if it did
+    bool Apply(Snake& snake, int64_t now);
+    void Clear();
+
+    uint32_t Size() const;
+    const TurnStats& Stats() const;
+
+private:
+    struct Turn
+    {
+        Snake::Direction dir;
+        int64_t time;
+    };
+
+    Turn turns[Capacity];
+    uint32_t first = 0;
+    uint32_t count = 0;
+    int64_t maxAge;
+    TurnStats stats;
+};
+
+// TurnStats struct methods ------------------------------------------------------------------------------------------------
+inline double TurnStats::MeanLatencyMs() const { return applied ? totalLatencyNs / 1e6 / applied : 0.0; }
+inline double TurnStats::MaxLatencyMs() const { return maxLatencyNs / 1e6; }
+
+// TurnQueue class methods ------------------------------------------------------------------------------------------------
+inline void TurnQueue::SetMaxAge(int64_t maxAgeNs) { maxAge = maxAgeNs; }
+inline void TurnQueue::Clear() { count = 0; }
+inline uint32_t TurnQueue::Size() const { return count; }
+inline const TurnStats& TurnQueue::Stats() const { return stats; }
@@ -0,0 +1,41 @@
+#include "Leaderboard.h"
+
+// Leaderboard class methods ------------------------------------------------------------------------------------------------
+void Leaderboard::Insert(uint32_t width, uint32_t height, uint32_t score, uint32_t id)
+{
+    fields[FieldKey(width, height)].Insert(EntryKey(score, id));
+    all.Insert(~score);
+}
+void Leaderboard::Clear()
+{
+    fields.clear();
+    all.Clear();
+}
+uint64_t Leaderboard::Size(uint32_t width, uint32_t height) const
+{
+    auto it = fields.find(FieldKey(width, height));
+    return it == fields.end() ? 0 : it->second.Size();
+}
+uint64_t Leaderboard::Rank(uint32_t score) const
+{
+    return all.CountLess(~score) + 1;
+}
+uint64_t Leaderboard::Rank(uint32_t width, uint32_t height, uint32_t score) const
+{
+    // Every key of a better score is less than that of score with the greatest id
+    auto it = fields.find(FieldKey(width, height));
+    return it == fields.end() ? 1 : it->second.CountLess(EntryKey(score, UINT32_MAX)) + 1;
+}
+size_t Leaderboard::Top(uint32_t width, uint32_t height, uint32_t* ids, size_t count) const
+{
+    auto it = fields.find(FieldKey(width, height));
+    if(it == fields.end() || count == 0)
+        return 0;
+    size_t n = 0;
+    it->second.Visit(0, [ids, count, &n](uint64_t key)
+    {
+        ids[n++] = ~(uint32_t)key;
+        return n < count;
+    });
+    return n;
+}
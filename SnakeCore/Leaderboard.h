@@ -0,0 +1,42 @@
+#pragma once
+
+// Every score ever made, indexed for the champions table: one RankTree per field size and one over all fields. Adding
+// a score, the place a score takes on its field or among all, and the best K of a field are each O(log n), K more for
+// the best K. The board keeps only numbers; a score is named by an id the caller gives it, such as its position in
+// the score journal.
+
+#include "RankTree.h"
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+
+class Leaderboard
+{
+public:
+    // Adds the score of a game on a width x height field. Ids must grow with time, the newer of equal scores ranks first.
+    void Insert(uint32_t width, uint32_t height, uint32_t score, uint32_t id);
+    void Clear();
+
+    uint64_t Size() const;
+    uint64_t Size(uint32_t width, uint32_t height) const;
+    // The place score would take among the scores of all fields, or of one field, 1 for the best. A new score goes
+    // before the equal ones, so this is 1 + the number of better scores.
+    uint64_t Rank(uint32_t score) const;
+    uint64_t Rank(uint32_t width, uint32_t height, uint32_t score) const;
+    // Stores the ids of the best scores of the field, at most count of them, best first and newer first among equal
+    // ones. Returns how many it stored.
+    size_t Top(uint32_t width, uint32_t height, uint32_t* ids, size_t count) const;
+
+private:
+    // Field trees order by score down, then by id down: (~score, ~id). The tree of all fields needs only the scores.
+    static uint64_t FieldKey(uint32_t width, uint32_t height);
+    static uint64_t EntryKey(uint32_t score, uint32_t id);
+
+    std::unordered_map<uint64_t, RankTree<uint64_t>> fields;
+    RankTree<uint32_t> all;  // ~score
+};
+
+// Leaderboard class methods ------------------------------------------------------------------------------------------------
+inline uint64_t Leaderboard::Size() const { return all.Size(); }
+inline uint64_t Leaderboard::FieldKey(uint32_t width, uint32_t height) { return (uint64_t)width << 32 | height; }
+inline uint64_t Leaderboard::EntryKey(uint32_t score, uint32_t id) { return (uint64_t)~score << 32 | ~id; }
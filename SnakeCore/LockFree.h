@@ -0,0 +1,83 @@
+#pragma once
+
+// Hand-offs between two threads that never make either of them wait.
+//
+// TripleBuffer passes the latest state of something from one writer to one reader. The writer fills its own slot
+// and publishes it by swapping it with the middle slot; the reader takes the middle slot in exchange for its own
+// when a new one has been published. Each side only ever touches its own slot, so a slow reader just skips states
+// and a slow writer just leaves the reader looking at the last one.
+//
+// SpscQueue is a fixed ring of items from one producer to one consumer, Push fails when it is full.
+
+#include <cstdint>
+#include <atomic>
+
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator = (const TripleBuffer&) = delete;
+
+    // Writer side: the slot to fill, then hand it over
+    T& Back() { return slots[back]; }
+    void Publish()
+    {
+        back = middle.exchange((uint8_t)(back | Fresh), std::memory_order_acq_rel) & IndexMask;
+    }
+
+    // Reader side: takes the latest published slot, false if nothing was published since the last call
+    bool Update()
+    {
+        if(!(middle.load(std::memory_order_relaxed) & Fresh))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+    const T& Front() const { return slots[front]; }
+
+private:
+    enum : uint8_t { IndexMask = 3, Fresh = 4 };  // Fresh - the middle slot holds a publish the reader hasn't taken
+
+    T slots[3];
+    std::atomic<uint8_t> middle{ 1 };
+    uint8_t back = 0;   // writer's own
+    uint8_t front = 2;  // reader's own
+};
+
+// Capacity must be a power of two
+template<typename T, uint32_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator = (const SpscQueue&) = delete;
+
+    bool Push(const T& item)
+    {
+        uint32_t tail = this->tail.load(std::memory_order_relaxed);
+        if(tail - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[tail % Capacity] = item;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool Pop(T& item)
+    {
+        uint32_t head = this->head.load(std::memory_order_relaxed);
+        if(head == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[head % Capacity];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[Capacity];
+    std::atomic<uint32_t> head{ 0 };  // next to pop, advanced by the consumer
+    std::atomic<uint32_t> tail{ 0 };  // next to push, advanced by the producer
+};
@@ -0,0 +1,308 @@
+#include "Mcts.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+
+namespace
+{
+    const Snake::Direction AllDirections[] = { Snake::UP, Snake::DOWN, Snake::RIGHT, Snake::LEFT };
+
+    constexpr uint32_t BucketSize = 4;      // entries probed for one key
+    constexpr uint32_t MaxDepth = 64;       // ticks walked down the tree before a rollout takes over
+    constexpr uint32_t RolloutTicks = 48;
+    constexpr double Discount = 0.97;       // per tick, so food eaten sooner counts for more
+    constexpr double Exploration = 0.7;     // UCB1 constant, outcomes lie in [0, 1]
+    constexpr double RewardScale = 65536.0;
+
+    // Zobrist keys are computed from the cell index by the SplitMix64 finalizer instead of being looked up,
+    // so a 4096x4096 field doesn't need a table of millions of random keys
+    enum KeyKind { BodyKey, HeadKey, FoodKey, DirKey, GrowKey };
+
+    inline uint64_t ZobristKey(KeyKind kind, uint64_t index)
+    {
+        uint64_t v = (index << 3 | kind) + 0x9E3779B97F4A7C15ull;
+        v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+        v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+        return v ^ (v >> 31);
+    }
+    uint64_t CellsKey(const Snake& snake)
+    {
+        uint64_t key = 0;
+        for(auto p : snake.Body())
+            key ^= ZobristKey(BodyKey, snake.ToCell(p));
+        return key;
+    }
+    // Key of the whole state given the key of its occupied cells, never 0 as that marks an empty entry
+    uint64_t StateKey(const Game& game, uint64_t cells)
+    {
+        const Snake& snake = game.GetSnake();
+        uint64_t key = cells ^ ZobristKey(HeadKey, snake.ToCell(snake.GetHead())) ^ ZobristKey(FoodKey, snake.ToCell(game.GetFood()))
+            ^ ZobristKey(DirKey, snake.GetDirection()) ^ (snake.IsGrowing() ? ZobristKey(GrowKey, 0) : 0);
+        return key ? key : 1;
+    }
+
+    // Outcome in [0, 1] of a walk that ate food (discounted sum) and survived or not. Surviving with nothing
+    // eaten is always worth more than dying after a meal.
+    double Outcome(double food, bool died)
+    {
+        double v = 0.5 * food / (1.0 + food);
+        return died ? v : 0.5 + v;
+    }
+}
+
+// MctsPolicy class methods ------------------------------------------------------------------------------------------------
+MctsPolicy::MctsPolicy(uint64_t seed, uint32_t nThreads, uint32_t tableBits)
+    : table((size_t)1 << tableBits), tableMask(((uint64_t)1 << tableBits) - 1)
+{
+    static_assert(sizeof(Entry) == 64, "a table entry should fill one cache line");
+    if(nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    workers.resize(nThreads);
+    for(uint32_t i = 0; i < nThreads; ++i)
+        workers[i].rng.Seed(seed, i);
+    if(nThreads > 1)
+        pool = std::make_unique<TaskPool>(nThreads);
+}
+void MctsPolicy::Reset()
+{
+    for(auto& e : table)
+    {
+        e.key.store(0, std::memory_order_relaxed);
+        e.age.store(0, std::memory_order_relaxed);
+    }
+    age = 0;
+}
+Snake::Direction MctsPolicy::Decide(const Game& game)
+{
+    auto start = std::chrono::steady_clock::now();
+    ++age;
+    root.resize(game.SnapshotSize());
+    game.Snapshot(root.data());
+    rootCells = CellsKey(game.GetSnake());
+    uint64_t key = StateKey(game, rootCells);
+    rootEntry = Find(key);
+    if(!rootEntry)
+        rootEntry = Insert(key);
+    deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(budget));
+    started = 0;
+
+    if(pool)
+    {
+        for(auto& w : workers)
+            pool->Submit([this, &w](uint32_t) { Search(w); });
+        pool->Wait();
+    }
+    else
+        Search(workers[0]);
+
+    for(auto& w : workers)
+    {
+        rollouts += w.rollouts;
+        lookups += w.lookups;
+        hits += w.hits;
+        w.rollouts = w.lookups = w.hits = 0;
+    }
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The most visited safe move; without any visits (no room for the root or no time) go for the food
+    Snake::Direction best = game.GetSnake().GetDirection();
+    uint32_t bestVisits = 0;
+    if(rootEntry)
+        for(auto d : AllDirections)
+        {
+            uint32_t n = rootEntry->visits[d].load(std::memory_order_relaxed);
+            if(n > bestVisits && IsSafeDirection(game, d))
+            {
+                best = d;
+                bestVisits = n;
+            }
+        }
+    return bestVisits ? best : GreedyPolicy().Decide(game);
+}
+void MctsPolicy::Search(Worker& worker)
+{
+    for(;;)
+    {
+        if(rolloutLimit && started.fetch_add(1, std::memory_order_relaxed) >= rolloutLimit)
+            return;
+        if(budget > 0 && std::chrono::steady_clock::now() >= deadline)
+            return;
+        Iterate(worker);
+        ++worker.rollouts;
+        if(!rolloutLimit && budget <= 0)
+            return;
+    }
+}
+void MctsPolicy::Iterate(Worker& worker)
+{
+    Game& game = worker.game;
+    Snake& snake = game.GetSnake();
+    game.Restore(root.data());
+    game.ReseedFood(worker.rng.Next64());
+    worker.path.clear();
+
+    uint64_t cells = rootCells;
+    double food = 0;
+    double outcome = 0;
+    Entry* entry = rootEntry;
+    for(uint32_t tick = 0; ; )
+    {
+        if(!entry || tick == MaxDepth)
+        {
+            outcome = Rollout(worker, tick, food);
+            break;
+        }
+        Snake::Direction d;
+        if(!Select(worker, *entry, d))
+        {
+            outcome = Outcome(food, true);
+            break;
+        }
+        entry->visits[d].fetch_add(1, std::memory_order_relaxed);
+        worker.path.push_back({ entry, d });
+
+        Point tail = snake.GetTail();
+        bool growing = snake.IsGrowing();
+        snake.SetDirection(d);
+        Game::StepResult res = game.Step();
+        ++tick;
+        if(res == Game::Won)
+        {
+            outcome = 1;
+            break;
+        }
+        cells ^= ZobristKey(BodyKey, snake.ToCell(snake.GetHead()));
+        if(!growing)
+            cells ^= ZobristKey(BodyKey, snake.ToCell(tail));
+        if(res == Game::Ate)
+            food += std::pow(Discount, tick);
+
+        uint64_t key = StateKey(game, cells);
+        ++worker.lookups;
+        entry = Find(key);
+        if(entry)
+            ++worker.hits;
+        else
+            Insert(key);  // the new leaf, its moves get statistics from the next walk that reaches it
+    }
+
+    uint64_t reward = (uint64_t)(outcome * RewardScale);
+    for(const auto& step : worker.path)
+        step.entry->reward[step.dir].fetch_add(reward, std::memory_order_relaxed);
+}
+double MctsPolicy::Rollout(Worker& worker, uint32_t tick, double food) const
+{
+    // Mostly greedy towards the food with a random safe move now and then
+    Game& game = worker.game;
+    Snake& snake = game.GetSnake();
+    for(uint32_t i = 0; i < RolloutTicks; ++i)
+    {
+        Snake::Direction safe[4];
+        uint32_t nSafe = 0;
+        for(auto d : AllDirections)
+            if(IsSafeDirection(game, d))
+                safe[nSafe++] = d;
+        if(nSafe == 0)
+            return Outcome(food, true);
+
+        Snake::Direction d = safe[0];
+        if(worker.rng.Below(4) == 0)
+            d = safe[worker.rng.Below(nSafe)];
+        else
+        {
+            Point head = snake.GetHead(), target = game.GetFood();
+            int32_t bestDist = std::numeric_limits<int32_t>::max();
+            for(uint32_t k = 0; k < nSafe; ++k)
+            {
+                Point p = Snake::Advance(head, safe[k]);
+                int32_t dist = std::abs(p.x - target.x) + std::abs(p.y - target.y);
+                if(dist < bestDist)
+                {
+                    d = safe[k];
+                    bestDist = dist;
+                }
+            }
+        }
+
+        snake.SetDirection(d);
+        Game::StepResult res = game.Step();
+        ++tick;
+        if(res == Game::Won)
+            return 1;
+        if(res == Game::Ate)
+            food += std::pow(Discount, tick);
+    }
+    return Outcome(food, false);
+}
+bool MctsPolicy::Select(Worker& worker, const Entry& entry, Snake::Direction& d) const
+{
+    Snake::Direction safe[4], unvisited[4];
+    uint32_t visits[4];
+    uint32_t nSafe = 0, nUnvisited = 0;
+    double total = 0;
+    for(auto dir : AllDirections)
+        if(IsSafeDirection(worker.game, dir))
+        {
+            visits[nSafe] = entry.visits[dir].load(std::memory_order_relaxed);
+            total += visits[nSafe];
+            if(visits[nSafe] == 0)
+                unvisited[nUnvisited++] = dir;
+            safe[nSafe++] = dir;
+        }
+    if(nSafe == 0)
+        return false;
+    if(nUnvisited)
+    {
+        d = unvisited[worker.rng.Below(nUnvisited)];
+        return true;
+    }
+
+    double logTotal = std::log(total), bestScore = -1;
+    for(uint32_t i = 0; i < nSafe; ++i)
+    {
+        double mean = entry.reward[safe[i]].load(std::memory_order_relaxed) / RewardScale / visits[i];
+        double score = mean + Exploration * std::sqrt(logTotal / visits[i]);
+        if(score > bestScore)
+        {
+            d = safe[i];
+            bestScore = score;
+        }
+    }
+    return true;
+}
+MctsPolicy::Entry* MctsPolicy::Find(uint64_t key)
+{
+    Entry* bucket = &table[key & tableMask & ~(uint64_t)(BucketSize - 1)];
+    for(uint32_t i = 0; i < BucketSize; ++i)
+        if(bucket[i].key.load(std::memory_order_acquire) == key)
+        {
+            if(bucket[i].age.load(std::memory_order_relaxed) != age)
+                bucket[i].age.store(age, std::memory_order_relaxed);
+            return &bucket[i];
+        }
+    return nullptr;
+}
+MctsPolicy::Entry* MctsPolicy::Insert(uint64_t key)
+{
+    // An entry is free if it was never used or not touched by this search or the previous one
+    Entry* bucket = &table[key & tableMask & ~(uint64_t)(BucketSize - 1)];
+    for(uint32_t i = 0; i < BucketSize; ++i)
+    {
+        Entry& e = bucket[i];
+        uint64_t old = e.key.load(std::memory_order_relaxed);
+        if(old != 0 && age - e.age.load(std::memory_order_relaxed) <= 1)
+            continue;
+        if(!e.key.compare_exchange_strong(old, key, std::memory_order_acq_rel))
+            continue;
+        for(uint32_t d = 0; d < 4; ++d)
+        {
+            e.visits[d].store(0, std::memory_order_relaxed);
+            e.reward[d].store(0, std::memory_order_relaxed);
+        }
+        e.age.store(age, std::memory_order_relaxed);
+        return &e;
+    }
+    return nullptr;
+}
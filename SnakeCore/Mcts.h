@@ -0,0 +1,108 @@
+#pragma once
+
+// Monte Carlo tree search player. Every iteration forks the game from a snapshot, walks down the search tree
+// by UCB1, adds the first state it hasn't seen, plays a short heuristic rollout from there and adds the outcome to
+// every move on the way. The food the snake would find after eating is unknown to a real player, so each iteration
+// draws it from a generator of its own.
+//
+// The tree is kept as a transposition table: a node is the table entry of a state's Zobrist hash (occupied cells,
+// head, direction, food), so states reached by different move orders share their statistics, and nodes of the
+// states the game actually goes through carry over to the next decision.
+//
+// With several threads the search is tree parallel: all workers share the table, which is lock free. Entries are
+// claimed by compare-and-swap on the key and the counters are updated with atomic adds, a walk adds a visit to each
+// move it takes before its outcome is known (virtual loss) so concurrent walks spread over different moves.
+// Racing claims of one stale entry may mix a few visits between two states, which only blurs the statistics.
+
+#include "Policies.h"
+#include "TaskPool.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class MctsPolicy : public Policy
+{
+public:
+    // nThreads 0 - one per core. The table holds 2^tableBits entries of 64 bytes.
+    MctsPolicy(uint64_t seed, uint32_t nThreads = 0, uint32_t tableBits = 18);
+
+    Snake::Direction Decide(const Game& game) override;
+    // Forgets all statistics, for a new game
+    void Reset() override;
+
+    // Each decision runs until the time budget or the number of rollouts is used up, whichever comes first;
+    // 0 leaves that limit off. Without any limit a decision plays a single rollout.
+    void SetBudget(double seconds);
+    void SetRolloutLimit(uint64_t rollouts);
+
+    uint32_t Threads() const;
+    // Totals over all decisions so far
+    uint64_t Rollouts() const;
+    double SearchSeconds() const;
+    // Lookups of states below the root and how many of them found the state already in the table
+    uint64_t TableLookups() const;
+    uint64_t TableHits() const;
+
+private:
+    struct Entry
+    {
+        std::atomic<uint64_t> key;
+        std::atomic<uint32_t> age;            // search that last used the entry
+        std::atomic<uint32_t> visits[4];      // per direction, including walks still under way
+        std::atomic<uint64_t> reward[4];      // per direction, sum of outcomes in units of 1 / RewardScale
+    };
+    struct PathStep
+    {
+        Entry* entry;
+        Snake::Direction dir;
+    };
+    struct Worker
+    {
+        Game game;
+        RandGen rng;
+        std::vector<PathStep> path;
+        uint64_t rollouts = 0;
+        uint64_t lookups = 0;
+        uint64_t hits = 0;
+    };
+
+    void Search(Worker& worker);
+    void Iterate(Worker& worker);
+    double Rollout(Worker& worker, uint32_t tick, double food) const;
+    // Direction to take from the worker's game by UCB1 over the safe ones, false if there is none
+    bool Select(Worker& worker, const Entry& entry, Snake::Direction& d) const;
+    Entry* Find(uint64_t key);
+    Entry* Insert(uint64_t key);
+
+private:
+    std::vector<Worker> workers;
+    std::unique_ptr<TaskPool> pool;  // only with more than one thread, a single worker runs on the caller's thread
+    std::vector<Entry> table;
+    uint64_t tableMask = 0;
+    uint32_t age = 0;
+
+    double budget = 0;
+    uint64_t rolloutLimit = 0;
+
+    // Current decision
+    std::vector<uint8_t> root;       // snapshot of the game being decided
+    uint64_t rootCells = 0;          // hash of the occupied cells of the root
+    Entry* rootEntry = nullptr;      // nullptr if the table had no room for the root
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<uint64_t> started{ 0 };
+
+    uint64_t rollouts = 0;
+    double seconds = 0;
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+};
+
+// MctsPolicy class methods ------------------------------------------------------------------------------------------------
+inline void MctsPolicy::SetBudget(double seconds) { budget = seconds; }
+inline void MctsPolicy::SetRolloutLimit(uint64_t rollouts) { rolloutLimit = rollouts; }
+inline uint32_t MctsPolicy::Threads() const { return (uint32_t)workers.size(); }
+inline uint64_t MctsPolicy::Rollouts() const { return rollouts; }
+inline double MctsPolicy::SearchSeconds() const { return seconds; }
+inline uint64_t MctsPolicy::TableLookups() const { return lookups; }
+inline uint64_t MctsPolicy::TableHits() const { return hits; }
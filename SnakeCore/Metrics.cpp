@@ -0,0 +1,133 @@
+#include "Metrics.h"
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <cinttypes>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const char* const PhaseNames[] = { "simulate", "spawn", "paint", "input_to_move", "tick_lateness" };
+    static_assert(sizeof(PhaseNames) / sizeof(PhaseNames[0]) == (size_t)Phase::Count, "a phase without a name");
+
+    // Quantiles of the exports, as fractions for the text and as names for the JSON
+    const double Quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    const char* const QuantileNames[] = { "p50", "p90", "p99", "p999" };
+
+    void Append(std::string& out, const char* format, ...)
+    {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        if(n > 0)
+            out.append(buf, std::min((size_t)n, sizeof(buf) - 1));
+    }
+}
+
+const char* PhaseName(Phase phase)
+{
+    return phase < Phase::Count ? PhaseNames[(uint32_t)phase] : "";
+}
+
+// LatencyHistogram class methods ------------------------------------------------------------------------------------------------
+constexpr uint32_t LatencyHistogram::SubBits;
+constexpr uint32_t LatencyHistogram::MaxBits;
+constexpr uint32_t LatencyHistogram::SubCount;
+constexpr uint32_t LatencyHistogram::BucketCount;
+
+LatencyHistogram::LatencyHistogram()
+{
+    for(auto& c : counts)
+        c.store(0, std::memory_order_relaxed);
+}
+void LatencyHistogram::Reset()
+{
+    for(auto& c : counts)
+        c.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    min.store(UINT64_MAX, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+int64_t LatencyHistogram::Min() const
+{
+    uint64_t v = min.load(std::memory_order_relaxed);
+    return v == UINT64_MAX ? 0 : (int64_t)v;
+}
+double LatencyHistogram::Mean() const
+{
+    uint64_t n = Count();
+    return n ? (double)sum.load(std::memory_order_relaxed) / n : 0.0;
+}
+uint64_t LatencyHistogram::BucketTop(uint32_t index)
+{
+    if(index < 2 * SubCount)
+        return index;
+    uint32_t shift = index / SubCount - 1;
+    return ((uint64_t)(index % SubCount + SubCount) << shift) + (1ull << shift) - 1;
+}
+int64_t LatencyHistogram::Percentile(double percent) const
+{
+    uint64_t n = Count();
+    if(!n)
+        return 0;
+    uint64_t target = std::max<uint64_t>(1, (uint64_t)std::ceil(n * std::min(std::max(percent, 0.0), 100.0) / 100.0));
+    uint64_t seen = 0;
+    for(uint32_t i = 0; i < BucketCount; ++i)
+    {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if(seen >= target)
+            return std::min((int64_t)BucketTop(i), Max());
+    }
+    return Max();  // a sample in flight was counted but not yet bucketed
+}
+
+// Metrics class methods ------------------------------------------------------------------------------------------------
+std::string Metrics::Text() const
+{
+    std::string out;
+    for(uint32_t p = 0; p < (uint32_t)Phase::Count; ++p)
+    {
+        const char* name = PhaseNames[p];
+        const LatencyHistogram& h = phases[p];
+        Append(out, "# TYPE snake_%s_seconds summary\n", name);
+        for(double q : Quantiles)
+            Append(out, "snake_%s_seconds{quantile=\"%g\"} %.9f\n", name, q, h.Percentile(q * 100) / 1e9);
+        Append(out, "snake_%s_seconds_sum %.9f\n", name, h.Mean() * h.Count() / 1e9);
+        Append(out, "snake_%s_seconds_count %" PRIu64 "\n", name, h.Count());
+        Append(out, "# TYPE snake_%s_seconds_max gauge\n", name);
+        Append(out, "snake_%s_seconds_max %.9f\n", name, h.Max() / 1e9);
+    }
+    Append(out, "# TYPE snake_ticks_total counter\nsnake_ticks_total %" PRIu64 "\n", Ticks());
+    Append(out, "# TYPE snake_dropped_ticks_total counter\nsnake_dropped_ticks_total %" PRIu64 "\n", DroppedTicks());
+    return out;
+}
+std::string Metrics::Json() const
+{
+    std::string out;
+    Append(out, "{\n  \"ticks\": %" PRIu64 ",\n  \"dropped_ticks\": %" PRIu64 ",\n  \"phases\": {", Ticks(), DroppedTicks());
+    for(uint32_t p = 0; p < (uint32_t)Phase::Count; ++p)
+    {
+        const LatencyHistogram& h = phases[p];
+        Append(out, "%s\n    \"%s\": { \"count\": %" PRIu64 ", \"mean_ns\": %.1f, \"min_ns\": %" PRId64, p ? "," : "",
+            PhaseNames[p], h.Count(), h.Mean(), h.Min());
+        for(size_t q = 0; q < sizeof(Quantiles) / sizeof(Quantiles[0]); ++q)
+            Append(out, ", \"%s_ns\": %" PRId64, QuantileNames[q], h.Percentile(Quantiles[q] * 100));
+        Append(out, ", \"max_ns\": %" PRId64 " }", h.Max());
+    }
+    out += "\n  }\n}\n";
+    return out;
+}
+bool Metrics::WriteFile(const char* fileName) const
+{
+    size_t len = strlen(fileName);
+    std::string data = (len >= 5 && strcmp(fileName + len - 5, ".json") == 0) ? Json() : Text();
+    FILE* file = fopen(fileName, "wb");
+    if(!file)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
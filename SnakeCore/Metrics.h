@@ -0,0 +1,129 @@
+#pragma once
+
+// Always-on timing of the frontends. Every phase of a tick or frame records its duration into a log-linear histogram
+// in the manner of HdrHistogram: values below 128 ns have a bucket each, above that every power of two is split into
+// 64 buckets, so a percentile read back is within 1/64 of the true value from nanoseconds up to minutes. Recording
+// is a bucket lookup and a few relaxed stores, a handful of nanoseconds, so it stays on in release builds.
+//
+// A histogram has one writer: the thread that runs its phase. Any thread may read it meanwhile; a reader sees every
+// sample recorded before it started and perhaps part of one in flight, which only blurs the last sample.
+
+#include "Bits.h"
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+class LatencyHistogram
+{
+public:
+    static constexpr uint32_t SubBits = 6;   // 64 buckets per power of two
+    static constexpr uint32_t MaxBits = 40;  // values up to 2^40 ns, about 18 minutes, larger ones count as that
+    static constexpr uint32_t SubCount = 1u << SubBits;
+    static constexpr uint32_t BucketCount = (MaxBits - SubBits + 1) * SubCount;
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator = (const LatencyHistogram&) = delete;
+
+    // Writer side, negative durations count as 0
+    void Record(int64_t ns);
+    void Reset();
+
+    uint64_t Count() const;
+    int64_t Min() const;  // 0 while empty
+    int64_t Max() const;
+    double Mean() const;
+    // The smallest value at or below which percent of the samples lie, to the precision of its bucket
+    int64_t Percentile(double percent) const;
+
+private:
+    static uint32_t BucketOf(uint64_t v);
+    static uint64_t BucketTop(uint32_t index);
+    // Single writer, so a load and a store do instead of a locked read-modify-write
+    static void Add(std::atomic<uint64_t>& counter, uint64_t n);
+
+    std::atomic<uint64_t> counts[BucketCount];
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> sum{ 0 };
+    std::atomic<uint64_t> min{ UINT64_MAX };
+    std::atomic<uint64_t> max{ 0 };
+};
+
+// The phases the frontends time
+enum class Phase : uint32_t
+{
+    Simulate,      // a tick of the game, without placing new food
+    Spawn,         // placing the food after a meal
+    Paint,         // bringing the screen up to date
+    InputToMove,   // from a key press to the tick that turned the snake with it
+    TickLateness,  // from a tick's place on the schedule to the moment it ran
+    Count
+};
+
+const char* PhaseName(Phase phase);
+
+// Histograms of every phase and the tick counters of one game session
+class Metrics
+{
+public:
+    Metrics() = default;
+    Metrics(const Metrics&) = delete;
+    Metrics& operator = (const Metrics&) = delete;
+
+    LatencyHistogram& operator [] (Phase phase);
+    const LatencyHistogram& operator [] (Phase phase) const;
+    // Counters follow the scheduler, the thread that runs it copies them over after every Due
+    void SetTicks(uint64_t ticks, uint64_t dropped);
+    uint64_t Ticks() const;
+    uint64_t DroppedTicks() const;
+
+    // Prometheus text exposition: a summary per phase with the usual quantiles, plus max, and the counters
+    std::string Text() const;
+    std::string Json() const;
+    // JSON when the name ends in .json, text otherwise
+    bool WriteFile(const char* fileName) const;
+
+private:
+    LatencyHistogram phases[(uint32_t)Phase::Count];
+    std::atomic<uint64_t> ticks{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+// LatencyHistogram class methods ------------------------------------------------------------------------------------------------
+inline uint32_t LatencyHistogram::BucketOf(uint64_t v)
+{
+    if(v < 2 * SubCount)
+        return (uint32_t)v;
+    if(v >> MaxBits)
+        v = (1ull << MaxBits) - 1;
+    uint32_t shift = HighBit(v) - SubBits;
+    return shift * SubCount + (uint32_t)(v >> shift);
+}
+inline void LatencyHistogram::Add(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+inline void LatencyHistogram::Record(int64_t ns)
+{
+    uint64_t v = ns > 0 ? (uint64_t)ns : 0;
+    Add(counts[BucketOf(v)], 1);
+    Add(count, 1);
+    Add(sum, v);
+    if(v < min.load(std::memory_order_relaxed))
+        min.store(v, std::memory_order_relaxed);
+    if(v > max.load(std::memory_order_relaxed))
+        max.store(v, std::memory_order_relaxed);
+}
+inline uint64_t LatencyHistogram::Count() const { return count.load(std::memory_order_relaxed); }
+inline int64_t LatencyHistogram::Max() const { return (int64_t)max.load(std::memory_order_relaxed); }
+
+// Metrics class methods ------------------------------------------------------------------------------------------------
+inline LatencyHistogram& Metrics::operator [] (Phase phase) { return phases[(uint32_t)phase]; }
+inline const LatencyHistogram& Metrics::operator [] (Phase phase) const { return phases[(uint32_t)phase]; }
+inline void Metrics::SetTicks(uint64_t ticks, uint64_t dropped)
+{
+    this->ticks.store(ticks, std::memory_order_relaxed);
+    this->dropped.store(dropped, std::memory_order_relaxed);
+}
+inline uint64_t Metrics::Ticks() const { return ticks.load(std::memory_order_relaxed); }
+inline uint64_t Metrics::DroppedTicks() const { return dropped.load(std::memory_order_relaxed); }
@@ -0,0 +1,171 @@
+#include "MetricsServer.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if defined _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#if defined _WIN32
+    typedef SOCKET Socket;
+    const Socket NoSocket = INVALID_SOCKET;
+    const int SendFlags = 0;
+
+    void CloseSocket(Socket s) { closesocket(s); }
+    void SetReceiveTimeout(Socket s, uint32_t ms)
+    {
+        DWORD timeout = ms;
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    }
+#else
+    typedef int Socket;
+    const Socket NoSocket = -1;
+#if defined MSG_NOSIGNAL
+    const int SendFlags = MSG_NOSIGNAL;  // a client gone before the answer mustn't kill the game with SIGPIPE
+#else
+    const int SendFlags = 0;
+#endif
+
+    void CloseSocket(Socket s) { close(s); }
+    void SetReceiveTimeout(Socket s, uint32_t ms)
+    {
+        timeval timeout = { (time_t)(ms / 1000), (suseconds_t)(ms % 1000 * 1000) };
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+#endif
+
+    constexpr uint32_t PollMs = 200;         // how soon Stop is noticed
+    constexpr uint32_t RequestTimeoutMs = 1000;
+    constexpr size_t MaxRequestSize = 4096;  // only the request line is looked at, the headers are read to be polite
+}
+
+// MetricsServer class methods ------------------------------------------------------------------------------------------------
+MetricsServer::MetricsServer(const Metrics& metrics) : metrics(metrics)
+{
+}
+MetricsServer::~MetricsServer()
+{
+    Stop();
+}
+bool MetricsServer::Start(uint16_t port)
+{
+    Stop();
+#if defined _WIN32
+    WSADATA wsaData;
+    if(WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return false;
+#endif
+    started = true;
+
+    Socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrSize = sizeof(addr);
+#if !defined _WIN32
+    // A restarted game may take its port back while the old connections linger; Windows would let anyone take it
+    int reuse = 1;
+    if(s != NoSocket)
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+    if(s == NoSocket || bind(s, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, 8) != 0
+        || getsockname(s, (sockaddr*)&addr, &addrSize) != 0)
+    {
+        if(s != NoSocket)
+            CloseSocket(s);
+        Stop();
+        return false;
+    }
+    listener = (intptr_t)s;
+    this->port = ntohs(addr.sin_port);
+    stop = false;
+    thread = std::thread(&MetricsServer::Serve, this);
+    return true;
+}
+void MetricsServer::Stop()
+{
+    stop = true;
+    if(thread.joinable())
+        thread.join();
+    if(listener != -1)
+    {
+        CloseSocket((Socket)listener);
+        listener = -1;
+    }
+#if defined _WIN32
+    if(started)
+        WSACleanup();
+#endif
+    started = false;
+    port = 0;
+}
+void MetricsServer::Serve()
+{
+    // select wakes up every PollMs to check for Stop, so the listener is never closed under a blocked accept
+    Socket s = (Socket)listener;
+    while(!stop)
+    {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(s, &readable);
+        timeval timeout = { 0, PollMs * 1000 };
+        if(select((int)s + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+            continue;
+        Socket client = accept(s, nullptr, nullptr);
+        if(client != NoSocket)
+            Answer((intptr_t)client);
+    }
+}
+void MetricsServer::Answer(intptr_t client)
+{
+    // Reads up to the end of the headers, so closing doesn't reset a connection with the request still unread
+    Socket s = (Socket)client;
+    SetReceiveTimeout(s, RequestTimeoutMs);
+    std::string request;
+    char buf[512];
+    while(request.size() < MaxRequestSize && request.find("\r\n\r\n") == std::string::npos)
+    {
+        int n = (int)recv(s, buf, sizeof(buf), 0);
+        if(n <= 0)
+            break;
+        request.append(buf, (size_t)n);
+    }
+
+    // GET /path HTTP/1.x
+    size_t pathStart = request.find(' ');
+    size_t pathEnd = pathStart == std::string::npos ? pathStart : request.find(' ', pathStart + 1);
+    std::string path = pathEnd == std::string::npos ? "/" : request.substr(pathStart + 1, pathEnd - pathStart - 1);
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+
+    std::string body = json ? metrics.Json() : metrics.Text();
+    char header[160];
+    snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+        json ? "application/json" : "text/plain; version=0.0.4", body.size());
+    std::string response = header + body;
+    for(size_t sent = 0; sent < response.size(); )
+    {
+        int n = (int)send(s, response.data() + sent, (int)(response.size() - sent), SendFlags);
+        if(n <= 0)
+            break;
+        sent += (size_t)n;
+    }
+    CloseSocket(s);
+}
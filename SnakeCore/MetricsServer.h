@@ -0,0 +1,37 @@
+#pragma once
+
+// Plain-text metrics endpoint of a running game. A thread listens on 127.0.0.1 only and answers every connection
+// with one HTTP/1.0 response, Metrics::Text() or, for a path ending in .json, Metrics::Json(), then closes it.
+// So `curl localhost:port` or a Prometheus scrape reads the histograms without touching the game's threads.
+
+#include "Metrics.h"
+#include <thread>
+#include <atomic>
+
+class MetricsServer
+{
+public:
+    explicit MetricsServer(const Metrics& metrics);
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator = (const MetricsServer&) = delete;
+    ~MetricsServer();
+
+    // Starts listening, port 0 takes any free one. False if the socket can't be bound.
+    bool Start(uint16_t port);
+    void Stop();
+    uint16_t Port() const;
+
+private:
+    void Serve();
+    void Answer(intptr_t client);
+
+    const Metrics& metrics;
+    intptr_t listener = -1;  // SOCKET on Windows, a descriptor elsewhere
+    uint16_t port = 0;
+    bool started = false;    // and on Windows, Winsock was started
+    std::atomic<bool> stop{ false };
+    std::thread thread;
+};
+
+// MetricsServer class methods ------------------------------------------------------------------------------------------------
+inline uint16_t MetricsServer::Port() const { return port; }
@@ -0,0 +1,192 @@
+#include "Planner.h"
+#include "Bitboard.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    const Snake::Direction AllDirections[] = { Snake::UP, Snake::DOWN, Snake::RIGHT, Snake::LEFT };
+
+    uint32_t Distance(Point a, Point b)
+    {
+        return (uint32_t)std::abs(a.x - b.x) + (uint32_t)std::abs(a.y - b.y);
+    }
+}
+
+// Planner class methods ------------------------------------------------------------------------------------------------
+void Planner::Reset()
+{
+    plan.clear();
+    nextStep = 0;
+    expectedHead = plannedFood = { -1, -1 };
+}
+Snake::Direction Planner::Decide(const Game& game)
+{
+    if(IsPlanUsable(game))
+        ++reusedSteps;
+    else
+    {
+        Replan(game);
+        ++replans;
+    }
+
+    if(nextStep == plan.size())
+        return Fallback(game);
+    Snake::Direction d = plan[nextStep++];
+    expectedHead = Snake::Advance(game.GetSnake().GetHead(), d);
+    return d;
+}
+bool Planner::IsPlanUsable(const Game& game) const
+{
+    return nextStep < plan.size()
+        && game.GetSnake().GetHead() == expectedHead
+        && game.GetFood() == plannedFood
+        && IsSafeDirection(game, plan[nextStep]);
+}
+void Planner::Replan(const Game& game)
+{
+    plan.clear();
+    nextStep = 0;
+    plannedFood = game.GetFood();
+    if(FindPath(game, plannedFood, plan) && IsTailReachableAfter(game, plan))
+        return;
+
+    // No safe way to the food yet: take one step towards the tail and look again on the next tick
+    if(FindPath(game, game.GetSnake().GetTail(), plan))
+        plan.resize(1);
+    else
+        plan.clear();
+}
+bool Planner::FindPath(const Game& game, Point target, std::vector<Snake::Direction>& path)
+{
+    const Snake& snake = game.GetSnake();
+    // Segment i counting from the tail leaves its cell during move i + 1 (one move later if the snake is growing),
+    // and Move rejects a cell that is still occupied when checked, so it can be entered from move i + 2 on
+    freeAt.Begin(game.Width(), game.Height());
+    visits.Begin(game.Width(), game.Height());
+    uint32_t i = snake.IsGrowing() ? 3 : 2;
+    for(Point p : snake.Body())
+        freeAt.Set(p, i++);
+
+    // A* with the distance to the target as the estimate. A step changes the estimate by one, so the length plus
+    // estimate of a cell is that of the cell it was reached from or two more: cells wait on open for the current bound
+    // and on next for the one after. Taking the latest cell first heads straight for the target over open ground,
+    // so a search reaches cells in proportion to the path, not to the field. A cell is final once expanded, a shorter
+    // way to a waiting one replaces its visit and the entry left behind is skipped.
+    Point start = snake.GetHead();
+    open.clear();
+    next.clear();
+    visits.Set(start, 0);
+    open.push_back(snake.ToCell(start));
+    for(;;)
+    {
+        if(open.empty())
+        {
+            if(next.empty())
+                return false;
+            open.swap(next);
+        }
+        Point cur = snake.ToPoint(open.back());
+        open.pop_back();
+        uint32_t visit = visits.Get(cur);
+        if(visit & Expanded)
+            continue;
+        if(cur == target)
+            break;
+        visits.Set(cur, visit | Expanded);
+        uint32_t step = (visit >> VisitShift) + 1;
+        uint32_t estimate = Distance(cur, target);
+        for(auto d : AllDirections)
+        {
+            Point p = Snake::Advance(cur, d);
+            if(p.x < 0 || (uint32_t)p.x >= game.Width() || p.y < 0 || (uint32_t)p.y >= game.Height())
+                continue;
+            // Expanded cells were reached in no more steps than this
+            if((visits.Has(p) && (visits.Get(p) >> VisitShift) <= step) || (snake.IsBody(p) && freeAt.Get(p) > step))
+                continue;
+            visits.Set(p, step << VisitShift | d);
+            (Distance(p, target) < estimate ? open : next).push_back(snake.ToCell(p));
+        }
+    }
+
+    path.resize(visits.Get(target) >> VisitShift);
+    for(Point p = target; p != start; )
+    {
+        uint32_t visit = visits.Get(p);
+        Snake::Direction d = (Snake::Direction)(visit & DirectionMask);
+        path[(visit >> VisitShift) - 1] = d;
+        p = Snake::Advance(p, Snake::Opposite(d));
+    }
+    return true;
+}
+bool Planner::IsTailReachableAfter(const Game& game, const std::vector<Snake::Direction>& path)
+{
+    const Snake& snake = game.GetSnake();
+    state.resize(snake.SnapshotSize());
+    snake.Snapshot(state.data());
+    future.Restore(state.data());
+    for(auto d : path)
+    {
+        future.SetDirection(d);
+        if(!future.Move(game.Width(), game.Height()))
+            return false;
+    }
+    future.Eat();
+    if(!FitsBitboard(game.Width(), game.Height()))
+        return IsConnected(future, game.Width(), game.Height(), future.GetHead(), future.GetTail());
+
+    Bitboard free = Bitboard::FreeCells(future, game.Width(), game.Height());
+    free.Set(future.GetHead());
+    free.Set(future.GetTail());
+    return FloodFill(free, future.GetHead()).Test(future.GetTail());
+}
+bool Planner::IsConnected(const Snake& snake, uint32_t width, uint32_t height, Point from, Point to)
+{
+    // Cell by cell search through the free cells for fields too large for a Bitboard. Any way will do, so cells are
+    // marked once as they are reached and the ones closer to the target are taken first, as in FindPath.
+    visits.Begin(width, height);
+    open.clear();
+    next.clear();
+    visits.Set(from, 0);
+    open.push_back(snake.ToCell(from));
+    while(!open.empty() || !next.empty())
+    {
+        if(open.empty())
+            open.swap(next);
+        Point cur = snake.ToPoint(open.back());
+        open.pop_back();
+        uint32_t estimate = Distance(cur, to);
+        for(auto d : AllDirections)
+        {
+            Point p = Snake::Advance(cur, d);
+            if(p.x < 0 || (uint32_t)p.x >= width || p.y < 0 || (uint32_t)p.y >= height)
+                continue;
+            if(p == to)
+                return true;
+            if(visits.Has(p) || snake.IsBody(p))
+                continue;
+            visits.Set(p, 0);
+            (Distance(p, to) < estimate ? open : next).push_back(snake.ToCell(p));
+        }
+    }
+    return false;
+}
+Snake::Direction Planner::Fallback(const Game& game) const
+{
+    // Trapped: stay in the largest pocket for as long as possible
+    const Snake& snake = game.GetSnake();
+    Snake::Direction best = snake.GetDirection();
+    int64_t bestArea = -1;
+    for(auto d : AllDirections)
+    {
+        if(!IsSafeDirection(game, d))
+            continue;
+        int64_t area = snake.ReachableArea(d);
+        if(area > bestArea)
+        {
+            best = d;
+            bestArea = area;
+        }
+    }
+    return best;
+}
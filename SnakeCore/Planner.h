@@ -0,0 +1,55 @@
+#pragma once
+
+// Autopilot: shortest path to the food, taken only if the snake can still reach its tail after eating. The searches
+// head for their target and keep their marks in stamped tiles, so their time and memory follow the path and the body
+// rather than the field.
+// The plan is kept between ticks. While the snake follows it and the food stays put only the head and the tail
+// move, which the path search already accounted for, so the plan just advances by one step instead of being rebuilt.
+
+#include "Policies.h"
+#include <vector>
+
+class Planner : public Policy
+{
+public:
+    Snake::Direction Decide(const Game& game) override;
+    // Drops the current plan
+    void Reset() override;
+
+    uint64_t Replans() const;
+    uint64_t ReusedSteps() const;
+
+private:
+    bool IsPlanUsable(const Game& game) const;
+    void Replan(const Game& game);
+    bool FindPath(const Game& game, Point target, std::vector<Snake::Direction>& path);
+    bool IsTailReachableAfter(const Game& game, const std::vector<Snake::Direction>& path);
+    bool IsConnected(const Snake& snake, uint32_t width, uint32_t height, Point from, Point to);
+    Snake::Direction Fallback(const Game& game) const;
+
+private:
+    std::vector<Snake::Direction> plan;
+    uint32_t nextStep = 0;
+    Point expectedHead = { -1, -1 };
+    Point plannedFood = { -1, -1 };
+
+    // A visit: the steps to the cell, Expanded and the direction of the last step
+    static constexpr uint32_t DirectionMask = 3;
+    static constexpr uint32_t Expanded = 4;
+    static constexpr uint32_t VisitShift = 3;
+
+    // Search buffers, kept to avoid allocating on every plan. The cells are cleared by stamp, so a search only
+    // touches the body and the cells it reaches.
+    CellScratch<uint32_t> freeAt;  // first step on which the head may enter a body cell
+    CellScratch<uint32_t> visits;
+    std::vector<Snake::CellInd> open;  // cells waiting within the current bound of the search
+    std::vector<Snake::CellInd> next;  // and within the one after
+    Snake future;                // the snake after following a path
+    std::vector<uint8_t> state;  // snapshot of the snake that future starts from
+
+    uint64_t replans = 0;
+    uint64_t reusedSteps = 0;
+};
+
+inline uint64_t Planner::Replans() const { return replans; }
+inline uint64_t Planner::ReusedSteps() const { return reusedSteps; }
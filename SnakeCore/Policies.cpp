@@ -0,0 +1,99 @@
+#include "Policies.h"
+#include "Planner.h"
+#include "Mcts.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const Snake::Direction AllDirections[] = { Snake::UP, Snake::DOWN, Snake::RIGHT, Snake::LEFT };
+    constexpr uint64_t MctsSimRollouts = 256;  // per decision of an "mcts" policy made by name
+
+    Snake::Direction TurnRight(Snake::Direction d)
+    {
+        switch(d)
+        {
+            case Snake::UP: return Snake::RIGHT;
+            case Snake::RIGHT: return Snake::DOWN;
+            case Snake::DOWN: return Snake::LEFT;
+            default: return Snake::UP;
+        }
+    }
+    Snake::Direction TurnLeft(Snake::Direction d)
+    {
+        return TurnRight(TurnRight(TurnRight(d)));
+    }
+}
+
+bool IsSafeDirection(const Game& game, Snake::Direction d)
+{
+    const Snake& snake = game.GetSnake();
+    if(!snake.IsValidDirection(d))
+        return false;
+    Point p = Snake::Advance(snake.GetHead(), d);
+    return p.x >= 0 && (uint32_t)p.x < game.Width() && p.y >= 0 && (uint32_t)p.y < game.Height() && !snake.IsBody(p);
+}
+
+std::unique_ptr<Policy> CreatePolicy(const char* name, uint64_t seed)
+{
+    if(strcmp(name, "random") == 0)
+        return std::make_unique<RandomPolicy>(seed);
+    if(strcmp(name, "greedy") == 0)
+        return std::make_unique<GreedyPolicy>();
+    if(strcmp(name, "wall") == 0)
+        return std::make_unique<WallFollowerPolicy>();
+    if(strcmp(name, "autopilot") == 0)
+        return std::make_unique<Planner>();
+    if(strcmp(name, "mcts") == 0)
+    {
+        // One thread and a fixed number of rollouts, so a game plays the same on any machine and many games can run side by side
+        auto mcts = std::make_unique<MctsPolicy>(seed, 1, 14);
+        mcts->SetRolloutLimit(MctsSimRollouts);
+        return std::unique_ptr<Policy>(std::move(mcts));
+    }
+    return nullptr;
+}
+
+// RandomPolicy class methods ------------------------------------------------------------------------------------------------
+Snake::Direction RandomPolicy::Decide(const Game& game)
+{
+    Snake::Direction safe[4];
+    uint32_t nSafe = 0;
+    for(auto d : AllDirections)
+        if(IsSafeDirection(game, d))
+            safe[nSafe++] = d;
+    return nSafe ? safe[rng.Below(nSafe)] : game.GetSnake().GetDirection();
+}
+
+// GreedyPolicy class methods ------------------------------------------------------------------------------------------------
+Snake::Direction GreedyPolicy::Decide(const Game& game)
+{
+    const Snake& snake = game.GetSnake();
+    Point food = game.GetFood();
+    Snake::Direction best = snake.GetDirection();
+    int32_t bestDist = std::numeric_limits<int32_t>::max();
+    for(auto d : AllDirections)
+    {
+        if(!IsSafeDirection(game, d))
+            continue;
+        Point p = Snake::Advance(snake.GetHead(), d);
+        int32_t dist = std::abs(p.x - food.x) + std::abs(p.y - food.y);
+        if(dist < bestDist || (dist == bestDist && d == snake.GetDirection()))
+        {
+            best = d;
+            bestDist = dist;
+        }
+    }
+    return best;
+}
+
+// WallFollowerPolicy class methods ------------------------------------------------------------------------------------------------
+Snake::Direction WallFollowerPolicy::Decide(const Game& game)
+{
+    Snake::Direction d = game.GetSnake().GetDirection();
+    if(IsSafeDirection(game, d))
+        return d;
+    if(IsSafeDirection(game, TurnRight(d)))
+        return TurnRight(d);
+    return TurnLeft(d);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// Built-in players that pick the snake's direction for the next tick
+
+#include "SnakeCore.h"
+#include <memory>
+
+class Policy
+{
+public:
+    virtual ~Policy() = default;
+    virtual Snake::Direction Decide(const Game& game) = 0;
+    // Drops whatever is kept between decisions, call when the game is reset or steered by someone else
+    virtual void Reset() {}
+};
+
+// Any direction that survives the next tick, chosen uniformly
+class RandomPolicy : public Policy
+{
+public:
+    explicit RandomPolicy(uint64_t seed) : rng(seed, 1) {}
+    Snake::Direction Decide(const Game& game) override;
+
+private:
+    RandGen rng;
+};
+
+// Surviving direction that brings the head closest to the food
+class GreedyPolicy : public Policy
+{
+public:
+    Snake::Direction Decide(const Game& game) override;
+};
+
+// Goes straight until blocked, then turns right, then left, so the snake ends up tracing walls and its own body
+class WallFollowerPolicy : public Policy
+{
+public:
+    Snake::Direction Decide(const Game& game) override;
+};
+
+// True if moving in direction d doesn't end the game on the next tick
+bool IsSafeDirection(const Game& game, Snake::Direction d);
+
+// Creates a policy by name ("random", "greedy", "wall", "autopilot" or "mcts"), nullptr for an unknown name
+std::unique_ptr<Policy> CreatePolicy(const char* name, uint64_t seed);
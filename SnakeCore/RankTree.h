@@ -0,0 +1,254 @@
+#pragma once
+
+// Sorted multiset of keys that also answers "how many keys are less than this one" and "which key is the k-th",
+// all in O(log n): a B+ tree whose inner nodes keep the number of keys under each child. Keys live in leaves of
+// about 512 bytes chained in order, so a run of neighbours is read from a few cache lines rather than a pointer per
+// key. Nodes are held in two vectors and linked by index, the tree only ever grows. Equal keys are kept in the order
+// they were inserted.
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+template<typename Key>
+class RankTree
+{
+public:
+    static constexpr uint32_t LeafCapacity = (512 - 2 * sizeof(uint32_t)) / sizeof(Key);
+    static constexpr uint32_t InnerCapacity = 32;
+
+    void Insert(const Key& key);
+    void Clear();
+    uint64_t Size() const;
+    // Number of keys less than key
+    uint64_t CountLess(const Key& key) const;
+    // Calls visit(key) for the keys in order from the one at index first, until visit returns false or they end
+    template<class F>
+    void Visit(uint64_t first, F visit) const;
+
+private:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Leaf
+    {
+        uint32_t n = 0;
+        uint32_t next = None;  // the leaf of the following keys
+        Key keys[LeafCapacity];
+    };
+    // keys[i] is the least key under children[i], counts[i] the number of keys under it
+    struct Inner
+    {
+        uint32_t n = 0;
+        Key keys[InnerCapacity];
+        uint32_t children[InnerCapacity];
+        uint64_t counts[InnerCapacity];
+    };
+    // A node that overflowed gives its upper half to a new node, which its parent has to take in
+    struct Split
+    {
+        uint32_t node;   // None - no split
+        Key first;
+        uint64_t count;  // keys moved to the new node
+    };
+
+    Split InsertInto(uint32_t node, uint32_t level, const Key& key);
+
+    std::vector<Leaf> leaves;
+    std::vector<Inner> inners;
+    uint32_t root = None;
+    uint32_t height = 0;  // levels of inner nodes above the leaves
+    uint64_t size = 0;
+};
+
+// RankTree class methods ------------------------------------------------------------------------------------------------
+template<typename Key>
+constexpr uint32_t RankTree<Key>::LeafCapacity;
+template<typename Key>
+constexpr uint32_t RankTree<Key>::InnerCapacity;
+template<typename Key>
+constexpr uint32_t RankTree<Key>::None;
+
+template<typename Key>
+inline uint64_t RankTree<Key>::Size() const { return size; }
+
+template<typename Key>
+void RankTree<Key>::Insert(const Key& key)
+{
+    if(root == None)
+    {
+        leaves.emplace_back();
+        root = (uint32_t)leaves.size() - 1;
+        height = 0;
+    }
+    Split split = InsertInto(root, height, key);
+    ++size;
+    if(split.node == None)
+        return;
+
+    // The root split, the tree grows a level
+    Inner top;
+    top.n = 2;
+    top.keys[0] = height ? inners[root].keys[0] : leaves[root].keys[0];
+    top.children[0] = root;
+    top.counts[0] = size - split.count;
+    top.keys[1] = split.first;
+    top.children[1] = split.node;
+    top.counts[1] = split.count;
+    inners.push_back(top);
+    root = (uint32_t)inners.size() - 1;
+    ++height;
+}
+template<typename Key>
+void RankTree<Key>::Clear()
+{
+    leaves.clear();
+    inners.clear();
+    root = None;
+    height = 0;
+    size = 0;
+}
+template<typename Key>
+typename RankTree<Key>::Split RankTree<Key>::InsertInto(uint32_t node, uint32_t level, const Key& key)
+{
+    if(level == 0)
+    {
+        Leaf* leaf = &leaves[node];
+        uint32_t pos = (uint32_t)(std::upper_bound(leaf->keys, leaf->keys + leaf->n, key) - leaf->keys);
+        if(leaf->n < LeafCapacity)
+        {
+            std::copy_backward(leaf->keys + pos, leaf->keys + leaf->n, leaf->keys + leaf->n + 1);
+            leaf->keys[pos] = key;
+            ++leaf->n;
+            return { None, Key(), 0 };
+        }
+
+        uint32_t right = (uint32_t)leaves.size();
+        leaves.emplace_back();
+        Leaf& lo = leaves[node];
+        Leaf& hi = leaves[right];
+        uint32_t half = LeafCapacity / 2;
+        std::copy(lo.keys + half, lo.keys + lo.n, hi.keys);
+        hi.n = lo.n - half;
+        lo.n = half;
+        hi.next = lo.next;
+        lo.next = right;
+        Leaf& target = pos <= half ? lo : hi;
+        uint32_t at = pos <= half ? pos : pos - half;
+        std::copy_backward(target.keys + at, target.keys + target.n, target.keys + target.n + 1);
+        target.keys[at] = key;
+        ++target.n;
+        return { right, hi.keys[0], hi.n };
+    }
+
+    // Into the last child whose least key isn't greater, the first one if key is less than all
+    uint32_t i;
+    uint32_t child;
+    {
+        Inner& in = inners[node];
+        i = (uint32_t)(std::upper_bound(in.keys, in.keys + in.n, key) - in.keys);
+        i = i ? i - 1 : 0;
+        if(key < in.keys[i])
+            in.keys[i] = key;
+        ++in.counts[i];
+        child = in.children[i];
+    }
+    Split split = InsertInto(child, level - 1, key);
+    if(split.node == None)
+        return split;
+
+    Inner* in = &inners[node];
+    in->counts[i] -= split.count;
+    if(in->n < InnerCapacity)
+    {
+        std::copy_backward(in->keys + i + 1, in->keys + in->n, in->keys + in->n + 1);
+        std::copy_backward(in->children + i + 1, in->children + in->n, in->children + in->n + 1);
+        std::copy_backward(in->counts + i + 1, in->counts + in->n, in->counts + in->n + 1);
+        in->keys[i + 1] = split.first;
+        in->children[i + 1] = split.node;
+        in->counts[i + 1] = split.count;
+        ++in->n;
+        return { None, Key(), 0 };
+    }
+
+    // Full: the children with the new one go half to this node, half to a new one
+    Key keys[InnerCapacity + 1];
+    uint32_t children[InnerCapacity + 1];
+    uint64_t counts[InnerCapacity + 1];
+    for(uint32_t k = 0, j = 0; k <= InnerCapacity; ++k)
+    {
+        if(k == i + 1)
+        {
+            keys[k] = split.first;
+            children[k] = split.node;
+            counts[k] = split.count;
+            continue;
+        }
+        keys[k] = in->keys[j];
+        children[k] = in->children[j];
+        counts[k] = in->counts[j];
+        ++j;
+    }
+    uint32_t right = (uint32_t)inners.size();
+    inners.emplace_back();
+    Inner& lo = inners[node];
+    Inner& hi = inners[right];
+    uint32_t half = (InnerCapacity + 1) / 2;
+    lo.n = half;
+    hi.n = InnerCapacity + 1 - half;
+    uint64_t moved = 0;
+    for(uint32_t k = 0; k <= InnerCapacity; ++k)
+    {
+        Inner& to = k < half ? lo : hi;
+        uint32_t at = k < half ? k : k - half;
+        to.keys[at] = keys[k];
+        to.children[at] = children[k];
+        to.counts[at] = counts[k];
+        if(k >= half)
+            moved += counts[k];
+    }
+    return { right, hi.keys[0], moved };
+}
+template<typename Key>
+uint64_t RankTree<Key>::CountLess(const Key& key) const
+{
+    if(root == None)
+        return 0;
+    // Children before the last one whose least key is less than key hold only lesser keys, those after it none
+    uint64_t less = 0;
+    uint32_t node = root;
+    for(uint32_t level = height; level > 0; --level)
+    {
+        const Inner& in = inners[node];
+        uint32_t i = (uint32_t)(std::lower_bound(in.keys, in.keys + in.n, key) - in.keys);
+        i = i ? i - 1 : 0;
+        for(uint32_t k = 0; k < i; ++k)
+            less += in.counts[k];
+        node = in.children[i];
+    }
+    const Leaf& leaf = leaves[node];
+    return less + (uint64_t)(std::lower_bound(leaf.keys, leaf.keys + leaf.n, key) - leaf.keys);
+}
+template<typename Key>
+template<class F>
+void RankTree<Key>::Visit(uint64_t first, F visit) const
+{
+    if(first >= size)
+        return;
+    uint32_t node = root;
+    for(uint32_t level = height; level > 0; --level)
+    {
+        const Inner& in = inners[node];
+        uint32_t i = 0;
+        while(i + 1 < in.n && first >= in.counts[i])
+            first -= in.counts[i++];
+        node = in.children[i];
+    }
+    for(uint32_t pos = (uint32_t)first; node != None; node = leaves[node].next, pos = 0)
+    {
+        const Leaf& leaf = leaves[node];
+        for(; pos < leaf.n; ++pos)
+            if(!visit(leaf.keys[pos]))
+                return;
+    }
+}
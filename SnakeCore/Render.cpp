@@ -0,0 +1,162 @@
+#include "Render.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    constexpr uint32_t SnakeColor = 0xFF000000;
+    constexpr uint32_t EyeColor = 0xFFFFFFFF;
+    constexpr uint32_t FoodColor = 0xFFFF0000;
+}
+
+// FieldRenderer class methods ------------------------------------------------------------------------------------------------
+FieldRenderer::FieldRenderer(uint32_t cellSize, uint32_t background)
+    : cellSize(cellSize), background(background), sprites(cellSize, EmptyTile)
+{
+    // Plain shapes in the spirit of the game's images: a square segment, the head with an eye towards its
+    // direction, a smaller square for the tail and a round food
+    int32_t size = (int32_t)cellSize, inset = size / 8;
+    std::vector<uint32_t> image(cellSize * cellSize);
+    for(uint32_t tile = 0; tile < EmptyTile; ++tile)
+    {
+        std::fill(image.begin(), image.end(), 0);
+        for(int32_t y = 0; y < size; ++y)
+            for(int32_t x = 0; x < size; ++x)
+            {
+                uint32_t& pixel = image[y * size + x];
+                if(tile == FoodTile)
+                {
+                    int32_t dx = 2 * x + 1 - size, dy = 2 * y + 1 - size, r = size - 2 * inset;
+                    if(dx * dx + dy * dy <= r * r)
+                        pixel = FoodColor;
+                    continue;
+                }
+                int32_t border = tile >= TailTile && tile < BodyTile ? 2 * inset : inset;
+                if(x < border || y < border || x >= size - border || y >= size - border)
+                    continue;
+                pixel = SnakeColor;
+                if(tile < TailTile)
+                {
+                    Point eye = Snake::Advance({ size / 2, size / 2 }, (Snake::Direction)tile);
+                    eye = { size / 2 + (eye.x - size / 2) * size / 4, size / 2 + (eye.y - size / 2) * size / 4 };
+                    if(std::abs(x - eye.x) <= inset / 2 && std::abs(y - eye.y) <= inset / 2)
+                        pixel = EyeColor;
+                }
+            }
+        sprites.Set(tile, image.data(), cellSize, cellSize, cellSize);
+    }
+}
+void FieldRenderer::SetTile(uint32_t tile, const uint32_t* src, uint32_t width, uint32_t height, uint32_t stride, uint32_t keyColor)
+{
+    sprites.Set(tile, src, width, height, stride, keyColor);
+    Invalidate();
+}
+void FieldRenderer::SetView(uint32_t width, uint32_t height, uint32_t* storage)
+{
+    viewWidth = width;
+    viewHeight = height;
+    if(storage)
+    {
+        ownPixels.clear();
+        ownPixels.shrink_to_fit();
+        pixels = storage;
+    }
+    else
+    {
+        ownPixels.resize((size_t)PixelWidth() * PixelHeight());
+        pixels = ownPixels.data();
+    }
+    shown.resize((size_t)width * height);
+    dirty.clear();
+    Invalidate();
+}
+void FieldRenderer::Invalidate()
+{
+    std::fill(shown.begin(), shown.end(), (uint8_t)UnknownTile);
+    fullRepaint = true;
+}
+void FieldRenderer::Update(const Game& game, Point viewOrigin, bool foodShown)
+{
+    const Snake& snake = game.GetSnake();
+    Point newHead = { -1, -1 }, newTail = { -1, -1 }, newFood = { -1, -1 };
+    if(game.Width())  // a game that was never reset shows an empty field
+    {
+        auto it = snake.Body().begin();
+        newTail = *it;
+        tailDir = Snake::GetDirection(*++it, newTail);
+        newHead = snake.GetHead();
+        newFood = game.GetFood();
+    }
+    showFood = foodShown;
+    const Point changed[] = { head, tail, food, newHead, newTail, newFood };
+    bool stepped = game.Seed() == seed && (game.Ticks() == ticks || game.Ticks() == ticks + 1);
+    head = newHead;
+    tail = newTail;
+    food = newFood;
+    seed = game.Seed();
+    ticks = game.Ticks();
+
+    if(viewOrigin != origin)
+    {
+        origin = viewOrigin;
+        Invalidate();
+    }
+    if(fullRepaint || !stepped)
+    {
+        // One rectangle around whatever changed, which is the whole view after an Invalidate
+        uint32_t left = viewWidth, top = viewHeight, right = 0, bottom = 0;
+        for(uint32_t y = 0; y < viewHeight; ++y)
+            for(uint32_t x = 0; x < viewWidth; ++x)
+                if(PaintCell(game, x, y))
+                {
+                    left = std::min(left, x);
+                    top = std::min(top, y);
+                    right = std::max(right, x + 1);
+                    bottom = std::max(bottom, y + 1);
+                }
+        if(right)
+            dirty.push_back({ left * cellSize, top * cellSize, right * cellSize, bottom * cellSize });
+    }
+    else
+        for(Point p : changed)
+            PaintFieldCell(game, p);
+    fullRepaint = false;
+}
+uint8_t FieldRenderer::TileAt(const Game& game, Point p) const
+{
+    // Overlaps resolve as the game draws: the tail over the head over the body, the food only on a free cell
+    if(!game.Width() || p.x < 0 || p.y < 0 || (uint32_t)p.x >= game.Width() || (uint32_t)p.y >= game.Height())
+        return EmptyTile;
+    const Snake& snake = game.GetSnake();
+    if(p == tail)
+        return (uint8_t)(TailTile + tailDir);
+    if(p == snake.GetHead())
+        return (uint8_t)(HeadTile + snake.GetDirection());
+    if(snake.IsBody(p))
+        return BodyTile;
+    return showFood && p == game.GetFood() ? FoodTile : EmptyTile;
+}
+bool FieldRenderer::PaintCell(const Game& game, uint32_t x, uint32_t y)
+{
+    uint8_t tile = TileAt(game, { origin.x + (int32_t)x, origin.y + (int32_t)y });
+    uint8_t& old = shown[(size_t)y * viewWidth + x];
+    if(tile == old)
+        return false;
+    old = tile;
+    uint32_t stride = PixelWidth();
+    uint32_t* dst = pixels + (size_t)y * cellSize * stride + x * cellSize;
+    for(uint32_t row = 0; row < cellSize; ++row)
+        std::fill_n(dst + (size_t)row * stride, cellSize, background);
+    if(tile != EmptyTile)
+        BlendOver(dst, stride, sprites.Sprite(tile), cellSize, cellSize, cellSize);
+    ++cellsPainted;
+    return true;
+}
+void FieldRenderer::PaintFieldCell(const Game& game, Point p)
+{
+    int32_t x = p.x - origin.x, y = p.y - origin.y;
+    if(x < 0 || y < 0 || (uint32_t)x >= viewWidth || (uint32_t)y >= viewHeight)
+        return;
+    if(PaintCell(game, (uint32_t)x, (uint32_t)y))
+        dirty.push_back({ x * cellSize, y * cellSize, (x + 1) * cellSize, (y + 1) * cellSize });
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+// Software renderer of the field. It keeps a 32-bit picture (0xAARRGGBB, the layout of a 32 bpp DIB) of the visible
+// part of the field, each cell the background with the sprite of its tile blended over it, and remembers the tile
+// it last painted in every cell. An update
+// after a tick looks only at the cells a tick can change: the old and new head, the old and new tail and the old and
+// new food. A new game, a jump over several ticks or a scrolled view makes it look at every visible cell instead.
+// Either way it only paints cells whose tile differs from the one shown, and it records the painted rectangles so a
+// frontend can copy out just those.
+
+#include "SnakeCore.h"
+#include "Blit.h"
+#include <vector>
+
+// Pixel rectangle of the frame, right and bottom exclusive
+struct PixelRect
+{
+    uint32_t left;
+    uint32_t top;
+    uint32_t right;
+    uint32_t bottom;
+};
+
+class FieldRenderer
+{
+public:
+    // In the order of the game's snake images: four heads by Snake::Direction, four tails by the direction from the
+    // segment after the tail to the tail, the plain segment. Then the food and the empty cell.
+    enum Tile : uint8_t { HeadTile = 0, TailTile = 4, BodyTile = 8, FoodTile, EmptyTile, TileCount };
+
+    // Starts with plain built-in sprites, background is the opaque color of empty cells
+    FieldRenderer(uint32_t cellSize, uint32_t background);
+
+    // Replaces the sprite of a tile other than EmptyTile, see SpriteAtlas::Set
+    void SetTile(uint32_t tile, const uint32_t* pixels, uint32_t width, uint32_t height, uint32_t stride, uint32_t keyColor = NoColorKey);
+    // Sets the size of the view in cells. pixels is the caller's storage of PixelWidth() x PixelHeight() pixels
+    // for the frame, such as a DIB section; with nullptr the renderer keeps its own.
+    void SetView(uint32_t viewWidth, uint32_t viewHeight, uint32_t* pixels = nullptr);
+    // Brings the frame up to date with game seen through the view with its top left cell at viewOrigin.
+    // Call it after every tick; any other change of the game is found out by the tick count and repaints the view.
+    void Update(const Game& game, Point viewOrigin, bool showFood);
+    // Makes the next Update repaint every cell, for a frame that was drawn over
+    void Invalidate();
+
+    const uint32_t* Pixels() const;
+    uint32_t PixelWidth() const;
+    uint32_t PixelHeight() const;
+    uint32_t CellSize() const;
+    // Rectangles painted since the last ClearDirty
+    const std::vector<PixelRect>& Dirty() const;
+    void ClearDirty();
+    // Cells painted by all updates so far
+    uint64_t CellsPainted() const;
+
+private:
+    uint8_t TileAt(const Game& game, Point p) const;
+    // Paints view cell (x, y) if its tile changed, true if it did
+    bool PaintCell(const Game& game, uint32_t x, uint32_t y);
+    void PaintFieldCell(const Game& game, Point p);
+
+private:
+    enum : uint8_t { UnknownTile = TileCount };
+
+    uint32_t cellSize;
+    uint32_t background;
+    SpriteAtlas sprites;             // one per tile up to EmptyTile
+    std::vector<uint32_t> ownPixels;
+    uint32_t* pixels = nullptr;
+    uint32_t viewWidth = 0;
+    uint32_t viewHeight = 0;
+    std::vector<uint8_t> shown;      // tile painted in every view cell, UnknownTile - nothing painted yet
+    std::vector<PixelRect> dirty;
+    uint64_t cellsPainted = 0;
+
+    // The game as of the last update
+    Point origin = { 0, 0 };
+    Point head = { -1, -1 };
+    Point tail = { -1, -1 };
+    Point food = { -1, -1 };
+    uint64_t seed = 0;
+    uint32_t ticks = 0;
+    bool fullRepaint = true;
+
+    // The game being updated to, for TileAt
+    Snake::Direction tailDir = Snake::UP;
+    bool showFood = false;
+};
+
+// FieldRenderer class methods ------------------------------------------------------------------------------------------------
+inline const uint32_t* FieldRenderer::Pixels() const { return pixels; }
+inline uint32_t FieldRenderer::PixelWidth() const { return viewWidth * cellSize; }
+inline uint32_t FieldRenderer::PixelHeight() const { return viewHeight * cellSize; }
+inline uint32_t FieldRenderer::CellSize() const { return cellSize; }
+inline const std::vector<PixelRect>& FieldRenderer::Dirty() const { return dirty; }
+inline void FieldRenderer::ClearDirty() { dirty.clear(); }
+inline uint64_t FieldRenderer::CellsPainted() const { return cellsPainted; }
@@ -0,0 +1,128 @@
+#include "Replay.h"
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    const uint8_t Magic[4] = { 'S', 'N', 'K', 'R' };
+
+    void PutVarint(std::vector<uint8_t>& out, uint64_t v)
+    {
+        for(; v >= 0x80; v >>= 7)
+            out.push_back((uint8_t)(v | 0x80));
+        out.push_back((uint8_t)v);
+    }
+
+    // Advances pos past the varint, false if it runs past size or over 64 bits
+    bool GetVarint(const uint8_t* data, size_t size, size_t& pos, uint64_t& v)
+    {
+        v = 0;
+        for(uint32_t shift = 0; pos < size && shift < 64; shift += 7)
+        {
+            uint8_t b = data[pos++];
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if(!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
+
+// Replay class methods ------------------------------------------------------------------------------------------------
+void Replay::Begin(const Game& game)
+{
+    turns.clear();
+    version = RulesVersion;
+    seed = game.Seed();
+    width = game.Width();
+    height = game.Height();
+    ticks = 0;
+    lastTurn = 0;
+    dir = game.GetSnake().GetDirection();
+}
+void Replay::Record(Snake::Direction d)
+{
+    if(d != dir)
+    {
+        PutVarint(turns, (uint64_t)(ticks - lastTurn) << 2 | d);
+        lastTurn = ticks;
+        dir = d;
+    }
+    ++ticks;
+}
+void Replay::Write(std::vector<uint8_t>& out) const
+{
+    out.insert(out.end(), std::begin(Magic), std::end(Magic));
+    PutVarint(out, version);
+    for(int i = 0; i < 8; ++i)
+        out.push_back((uint8_t)(seed >> (8 * i)));
+    PutVarint(out, width);
+    PutVarint(out, height);
+    PutVarint(out, ticks);
+    out.insert(out.end(), turns.begin(), turns.end());
+}
+bool Replay::Read(const uint8_t* data, size_t size)
+{
+    size_t pos = sizeof(Magic);
+    uint64_t v = 0, w = 0, h = 0, n = 0;
+    if(size < pos + 8 || !std::equal(std::begin(Magic), std::end(Magic), data))
+        return false;
+    if(!GetVarint(data, size, pos, v) || v != RulesVersion || size < pos + 8)
+        return false;
+    uint64_t s = 0;
+    for(int i = 0; i < 8; ++i)
+        s |= (uint64_t)data[pos++] << (8 * i);
+    if(!GetVarint(data, size, pos, w) || !GetVarint(data, size, pos, h) || !GetVarint(data, size, pos, n)
+        || w < MinWidth || w > MaxWidth || h < MinHeight || h > MaxHeight || n > std::numeric_limits<uint32_t>::max())
+        return false;
+
+    version = (uint32_t)v;
+    seed = s;
+    width = (uint32_t)w;
+    height = (uint32_t)h;
+    ticks = (uint32_t)n;
+    turns.assign(data + pos, data + size);
+    lastTurn = 0;
+    dir = Snake::UP;
+    return true;
+}
+
+// ReplayPlayer class methods ------------------------------------------------------------------------------------------------
+ReplayPlayer::ReplayPlayer(const Replay& replay) : replay(replay) {}
+void ReplayPlayer::Start(Game& game)
+{
+    game.Reset(replay.Width(), replay.Height(), replay.Seed());
+    pos = 0;
+    tick = 0;
+    dir = game.GetSnake().GetDirection();
+    ReadTurn();
+}
+Game::StepResult ReplayPlayer::Step(Game& game)
+{
+    if(tick == nextTurn)
+    {
+        dir = nextDir;
+        ReadTurn();
+    }
+    ++tick;
+    game.GetSnake().SetDirection(dir);
+    return game.Step();
+}
+Game::StepResult ReplayPlayer::FastForward(Game& game)
+{
+    Game::StepResult res = Game::Moved;
+    while(!AtEnd())
+        res = Step(game);
+    return res;
+}
+void ReplayPlayer::ReadTurn()
+{
+    uint64_t v = 0;
+    if(GetVarint(replay.turns.data(), replay.turns.size(), pos, v))
+    {
+        nextTurn = tick + (uint32_t)(v >> 2);
+        nextDir = (Snake::Direction)(v & 3);
+    }
+    else
+        nextTurn = replay.Ticks();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// Compact record of one game: the header (rules version, seed, field size, number of ticks) and the turns.
+// A turn is stored as one varint holding the ticks since the previous turn shifted left by 2 with the new
+// direction in the low bits, so a straight run of up to 31 ticks costs one byte. Since Game is deterministic
+// for a given seed, replaying the turns reproduces the game exactly.
+//
+// Serialized layout, all integers little endian:
+//   "SNKR" | varint version | seed, 8 bytes | varint width | varint height | varint ticks | turns...
+
+#include "SnakeCore.h"
+#include <vector>
+
+class Replay
+{
+public:
+    // Starts a new record of game, which must have just been reset
+    void Begin(const Game& game);
+    // Appends one tick, call before every Game::Step with the direction the snake is about to take
+    void Record(Snake::Direction d);
+
+    void Write(std::vector<uint8_t>& out) const;
+    // False if data isn't a replay or was recorded under different rules
+    bool Read(const uint8_t* data, size_t size);
+
+    uint32_t Version() const;
+    uint64_t Seed() const;
+    uint32_t Width() const;
+    uint32_t Height() const;
+    uint32_t Ticks() const;
+
+private:
+    friend class ReplayPlayer;
+
+    std::vector<uint8_t> turns;
+    uint32_t version = RulesVersion;
+    uint64_t seed = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t ticks = 0;
+    uint32_t lastTurn = 0;  // tick of the last recorded turn
+    Snake::Direction dir = Snake::UP;
+};
+
+// Re-simulates a Replay tick by tick. The replay must outlive the player.
+class ReplayPlayer
+{
+public:
+    explicit ReplayPlayer(const Replay& replay);
+
+    // Resets game to the recorded start
+    void Start(Game& game);
+    // Plays the next recorded tick on game
+    Game::StepResult Step(Game& game);
+    // Plays all remaining ticks at once and returns the result of the last one
+    Game::StepResult FastForward(Game& game);
+    bool AtEnd() const;
+    uint32_t Tick() const;
+
+private:
+    void ReadTurn();
+
+private:
+    const Replay& replay;
+    size_t pos = 0;
+    uint32_t tick = 0;
+    uint32_t nextTurn = 0;  // tick on which nextDir takes over, replay.Ticks() once the turns run out
+    Snake::Direction dir = Snake::UP;
+    Snake::Direction nextDir = Snake::UP;
+};
+
+// Replay class methods ------------------------------------------------------------------------------------------------
+inline uint32_t Replay::Version() const { return version; }
+inline uint64_t Replay::Seed() const { return seed; }
+inline uint32_t Replay::Width() const { return width; }
+inline uint32_t Replay::Height() const { return height; }
+inline uint32_t Replay::Ticks() const { return ticks; }
+
+// ReplayPlayer class methods ------------------------------------------------------------------------------------------------
+inline bool ReplayPlayer::AtEnd() const { return tick == replay.Ticks(); }
+inline uint32_t ReplayPlayer::Tick() const { return tick; }
@@ -0,0 +1,69 @@
+#include "Scheduler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    class SteadyClock : public TickClock
+    {
+    public:
+        int64_t Now() const override
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    };
+}
+
+const TickClock& SteadyTickClock()
+{
+    static const SteadyClock clock;
+    return clock;
+}
+
+// TickScheduler class methods ------------------------------------------------------------------------------------------------
+constexpr int64_t TickScheduler::Forever;
+
+TickScheduler::TickScheduler(const TickClock& clock, int64_t stepNs, uint32_t maxBurst)
+    : clock(clock), step(std::max<int64_t>(stepNs, 1)), maxBurst(std::max(maxBurst, 1u)), last(clock.Now())
+{
+}
+void TickScheduler::Restart()
+{
+    last = clock.Now();
+}
+void TickScheduler::SetStep(int64_t stepNs)
+{
+    step = std::max<int64_t>(stepNs, 1);
+}
+void TickScheduler::SetPaused(bool pause)
+{
+    if(pause == paused)
+        return;
+    paused = pause;
+    if(!paused)
+        Restart();
+}
+uint32_t TickScheduler::Due()
+{
+    int64_t now = clock.Now();
+    if(paused || now - last < step)
+        return 0;
+    lateness = now - last - step;
+    uint64_t due = (uint64_t)((now - last) / step);
+    last += (int64_t)due * step;
+
+    ++jitter.samples;
+    jitter.totalNs += lateness;
+    jitter.maxNs = std::max(jitter.maxNs, lateness);
+
+    uint32_t run = (uint32_t)std::min<uint64_t>(due, maxBurst);
+    dropped += due - run;
+    ticks += run;
+    return run;
+}
+int64_t TickScheduler::Wait() const
+{
+    if(paused)
+        return Forever;
+    return std::max<int64_t>(0, last + step - clock.Now());
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Fixed timestep tick scheduling, apart from how a frontend waits. Ticks fall on a grid of whole steps from the
+// start, so lateness of one tick doesn't push back the ones after it, and the number of ticks run plus the number
+// dropped is always the number of whole steps elapsed while running. The frontend asks how long it may sleep,
+// sleeps that long or until input arrives, then asks how many ticks are due. Time comes from a TickClock, so a test
+// can drive the scheduler with a clock it sets by hand.
+
+#include <cstdint>
+
+// Monotonic time in nanoseconds from an arbitrary origin
+class TickClock
+{
+public:
+    virtual ~TickClock() = default;
+    virtual int64_t Now() const = 0;
+};
+
+// std::chrono::steady_clock, shared by all schedulers
+const TickClock& SteadyTickClock();
+
+// How late due ticks were seen, from the deadline to the Due call that handed them out
+struct TickJitter
+{
+    uint64_t samples = 0;
+    int64_t totalNs = 0;
+    int64_t maxNs = 0;
+
+    double MeanMs() const;
+    double MaxMs() const;
+};
+
+class TickScheduler
+{
+public:
+    static constexpr int64_t Forever = INT64_MAX;
+
+    // maxBurst is the most ticks one Due call hands out after a stall, the older ones are dropped
+    TickScheduler(const TickClock& clock, int64_t stepNs, uint32_t maxBurst = 1);
+
+    // Starts the grid over, the first tick is one step from now
+    void Restart();
+    // Makes the next tick one new step after the last one, the grid continues from there
+    void SetStep(int64_t stepNs);
+    // No tick is due while paused and resuming starts a fresh step, as Restart does
+    void SetPaused(bool paused);
+
+    // Ticks due by now, at most maxBurst, which the caller runs right away
+    uint32_t Due();
+    // Nanoseconds until the next tick, 0 if one is due, Forever while paused
+    int64_t Wait() const;
+    // How late the ticks of the last Due that handed any out were, the sample it added to Jitter
+    int64_t Lateness() const;
+
+    bool Paused() const;
+    int64_t Step() const;
+    uint64_t Ticks() const;    // handed out by Due
+    uint64_t Dropped() const;  // skipped after stalls
+    const TickJitter& Jitter() const;
+    void ResetJitter();
+
+private:
+    const TickClock& clock;
+    int64_t step;
+    uint32_t maxBurst;
+    int64_t last;          // time of the last tick on the grid, or of the restart
+    bool paused = false;
+    int64_t lateness = 0;
+    uint64_t ticks = 0;
+    uint64_t dropped = 0;
+    TickJitter jitter;
+};
+
+// TickJitter struct methods ------------------------------------------------------------------------------------------------
+inline double TickJitter::MeanMs() const { return samples ? totalNs / 1e6 / samples : 0.0; }
+inline double TickJitter::MaxMs() const { return maxNs / 1e6; }
+
+// TickScheduler class methods ------------------------------------------------------------------------------------------------
+inline bool TickScheduler::Paused() const { return paused; }
+inline int64_t TickScheduler::Step() const { return step; }
+inline int64_t TickScheduler::Lateness() const { return lateness; }
+inline uint64_t TickScheduler::Ticks() const { return ticks; }
+inline uint64_t TickScheduler::Dropped() const { return dropped; }
+inline const TickJitter& TickScheduler::Jitter() const { return jitter; }
+inline void TickScheduler::ResetJitter() { jitter = TickJitter(); }
@@ -0,0 +1,514 @@
+#include "ScoreJournal.h"
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#if defined _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char Magic[4] = { 'S', 'N', 'K', 'J' };
+    constexpr size_t HeaderSize = 2 * sizeof(uint32_t);       // magic, version
+    constexpr size_t EntryHeaderSize = 2 * sizeof(uint32_t);  // payload size, CRC
+    constexpr size_t RecordHeaderSize = 4 * sizeof(uint32_t);
+
+    // CRC-32 of zlib and PNG, a table of the remainders of every byte
+    uint32_t Crc32(const uint8_t* data, size_t size)
+    {
+        struct Table
+        {
+            uint32_t t[256];
+            Table()
+            {
+                for(uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t c = i;
+                    for(int k = 0; k < 8; ++k)
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    t[i] = c;
+                }
+            }
+        };
+        static const Table table;
+        uint32_t crc = 0xFFFFFFFFu;
+        for(size_t i = 0; i < size; ++i)
+            crc = table.t[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // The file mapped read-only up to limit bytes, or nothing if it can't be opened. An empty file maps to nothing as
+    // well. The part after limit can be cut off while the mapping lives.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const char* fileName, size_t limit = SIZE_MAX);
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator = (const MappedFile&) = delete;
+        ~MappedFile();
+
+        const uint8_t* Data() const { return data; }
+        size_t Size() const { return size; }
+
+    private:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+#if defined _WIN32
+    MappedFile::MappedFile(const char* fileName, size_t limit)
+    {
+        // The view keeps the file mapped once both handles are closed
+        HANDLE hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(hFile == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER fileSize = {};
+        if(GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart > 0 && limit > 0)
+        {
+            // The section is only as large as the part mapped, so the file can be truncated down to it
+            uint64_t mapSize = std::min((uint64_t)fileSize.QuadPart, (uint64_t)limit);
+            HANDLE hMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, (DWORD)(mapSize >> 32), (DWORD)mapSize, nullptr);
+            if(hMapping)
+            {
+                data = (const uint8_t*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, (SIZE_T)mapSize);
+                size = data ? (size_t)mapSize : 0;
+                CloseHandle(hMapping);
+            }
+        }
+        CloseHandle(hFile);
+    }
+    MappedFile::~MappedFile()
+    {
+        if(data)
+            UnmapViewOfFile(data);
+    }
+
+    bool SyncFile(FILE* file)
+    {
+        return fflush(file) == 0 && _commit(_fileno(file)) == 0;
+    }
+    bool MoveOver(const char* from, const char* to)
+    {
+        return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    }
+    bool Truncate(const char* fileName, uint64_t size)
+    {
+        HANDLE hFile = CreateFileA(fileName, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(hFile == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        bool ok = SetFilePointerEx(hFile, end, nullptr, FILE_BEGIN) && SetEndOfFile(hFile);
+        CloseHandle(hFile);
+        return ok;
+    }
+#else
+    MappedFile::MappedFile(const char* fileName, size_t limit)
+    {
+        int fd = open(fileName, O_RDONLY);
+        if(fd < 0)
+            return;
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0 && limit > 0)
+        {
+            size_t mapSize = std::min((uint64_t)st.st_size, (uint64_t)limit);
+            void* p = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED)
+            {
+                data = (const uint8_t*)p;
+                size = mapSize;
+            }
+        }
+        close(fd);
+    }
+    MappedFile::~MappedFile()
+    {
+        if(data)
+            munmap((void*)data, size);
+    }
+
+    bool SyncFile(FILE* file)
+    {
+        return fflush(file) == 0 && fsync(fileno(file)) == 0;
+    }
+    bool MoveOver(const char* from, const char* to)
+    {
+        if(rename(from, to) != 0)
+            return false;
+        // The rename itself is only durable once the directory is
+        std::string dir(to);
+        size_t slash = dir.rfind('/');
+        dir = slash == std::string::npos ? "." : slash == 0 ? "/" : dir.substr(0, slash);
+        int fd = open(dir.c_str(), O_RDONLY);
+        if(fd >= 0)
+        {
+            fsync(fd);
+            close(fd);
+        }
+        return true;
+    }
+    bool Truncate(const char* fileName, uint64_t size)
+    {
+        return truncate(fileName, (off_t)size) == 0;
+    }
+#endif
+
+    // Whether data is exactly a table in the resource layout
+    bool IsTable(const uint8_t* data, size_t size)
+    {
+        if(size < sizeof(uint32_t))
+            return false;
+        uint32_t count;
+        memcpy(&count, data, sizeof(count));
+        size_t pos = sizeof(uint32_t);
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t fields[4];
+            if(size - pos < RecordHeaderSize)
+                return false;
+            memcpy(fields, data + pos, sizeof(fields));
+            uint64_t recordSize = RecordHeaderSize + (uint64_t)fields[3] * sizeof(ScoreChar);
+            if(recordSize > size - pos)
+                return false;
+            pos += (size_t)recordSize;
+        }
+        return pos == size;
+    }
+
+    // Calls onEntry(payload, size) for every intact entry of a journal, returns the size of the intact part, 0 if data
+    // isn't a journal
+    template<class F>
+    size_t Scan(const uint8_t* data, size_t size, F onEntry)
+    {
+        uint32_t version;
+        if(size < HeaderSize || memcmp(data, Magic, sizeof(Magic)) != 0)
+            return 0;
+        memcpy(&version, data + sizeof(Magic), sizeof(version));
+        if(version != ScoreJournal::Version)
+            return 0;
+
+        size_t pos = HeaderSize;
+        while(size - pos >= EntryHeaderSize)
+        {
+            uint32_t header[2];
+            memcpy(header, data + pos, sizeof(header));
+            const uint8_t* payload = data + pos + EntryHeaderSize;
+            if(header[0] > size - pos - EntryHeaderSize || Crc32(payload, header[0]) != header[1]
+                || !IsTable(payload, header[0]))
+                break;
+            onEntry(payload, (size_t)header[0]);
+            pos += EntryHeaderSize + header[0];
+        }
+        return pos;
+    }
+
+    // No file by that name or an empty one, as opposed to one that can't be read
+    bool IsMissingOrEmpty(const char* fileName)
+    {
+        FILE* file = fopen(fileName, "rb");
+        if(!file)
+            return errno == ENOENT;
+        bool empty = fseek(file, 0, SEEK_END) == 0 && ftell(file) == 0;
+        fclose(file);
+        return empty;
+    }
+    bool SaveBytes(const char* fileName, const uint8_t* data, size_t size)
+    {
+        FILE* file = fopen(fileName, "wb");
+        if(!file)
+            return false;
+        bool ok = fwrite(data, 1, size, file) == size && SyncFile(file);
+        return fclose(file) == 0 && ok;
+    }
+
+    // Forgets the views that are gone
+    void DropExpired(std::vector<std::weak_ptr<const void>>& pins)
+    {
+        pins.erase(std::remove_if(pins.begin(), pins.end(), [](const std::weak_ptr<const void>& pin) { return pin.expired(); }), pins.end());
+    }
+
+    // Entry of the table of count records given back to back in records
+    std::vector<uint8_t> MakeEntry(uint32_t count, const uint8_t* records, size_t size)
+    {
+        std::vector<uint8_t> entry(EntryHeaderSize + sizeof(uint32_t) + size);
+        uint8_t* payload = entry.data() + EntryHeaderSize;
+        memcpy(payload, &count, sizeof(count));
+        if(size)
+            memcpy(payload + sizeof(count), records, size);
+        uint32_t header[2] = { (uint32_t)(sizeof(count) + size), Crc32(payload, sizeof(count) + size) };
+        memcpy(entry.data(), header, sizeof(header));
+        return entry;
+    }
+}
+
+// ScoreJournal class methods ------------------------------------------------------------------------------------------------
+constexpr uint32_t ScoreJournal::Version;
+constexpr uint32_t ScoreJournal::CompactEvery;
+
+ScoreJournal::ScoreJournal(const char* fileName) : fileName(fileName)
+{
+}
+ScoreJournal::~ScoreJournal()
+{
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        quit = true;
+    }
+    wake.notify_all();
+    if(writer.joinable())
+        writer.join();
+}
+bool ScoreJournal::Map(ScoreView& view)
+{
+    view = ScoreView();
+    // The file the writer may be about to replace or extend is left alone
+    Flush();
+
+    std::shared_ptr<MappedFile> map;
+    size_t end = 0;
+    auto scan = [this, &view, &map, &end]
+    {
+        map = std::make_shared<MappedFile>(fileName.c_str());
+        view.runs.clear();
+        view.count = 0;
+        // Offsets are uint32, a journal past 4 GB is read up to there
+        const uint8_t* data = map->Data();
+        end = Scan(data, std::min(map->Size(), (size_t)UINT32_MAX), [data, &view](const uint8_t* payload, size_t)
+        {
+            uint32_t count;
+            memcpy(&count, payload, sizeof(count));
+            view.runs.push_back({ (uint32_t)(payload - data + sizeof(count)), count });
+            view.count += count;
+        });
+    };
+    scan();
+    // Whatever isn't a journal is set aside and a new one started, a damaged tail set aside and cut off
+    if(end == 0 || end < map->Size())
+    {
+        bool found = end != 0;
+        map.reset();
+        Check();
+        if(!found)
+        {
+            view = ScoreView();
+            return false;
+        }
+        scan();
+    }
+    // The view holds compactions off while it lives, so a journal that is due for one gets it now
+    if(view.runs.size() > CompactEvery)
+    {
+        map.reset();
+        Compact();
+        Flush();
+        scan();
+    }
+    // A damaged tail that couldn't be cut off stays out of the mapping
+    if(end < map->Size())
+        map = std::make_shared<MappedFile>(fileName.c_str(), end);
+    if(!map->Data())
+    {
+        view = ScoreView();
+        return true;
+    }
+
+    view.data = map->Data();
+    view.size = end;
+    view.owner = map;
+    std::lock_guard<std::mutex> lock(guard);
+    DropExpired(pins);
+    pins.push_back(map);
+    return true;
+}
+void ScoreJournal::Append(const ScoreEntry& entry)
+{
+    ScoreBuilder one;
+    one.Add(entry);
+    Append(one);
+}
+void ScoreJournal::Append(const ScoreBuilder& records)
+{
+    Push({ false, MakeEntry(records.Count(), records.Data(), records.Size()) });
+}
+void ScoreJournal::Compact()
+{
+    Push({ true, {} });
+}
+void ScoreJournal::Push(Task task)
+{
+    std::lock_guard<std::mutex> lock(guard);
+    tasks.push_back(std::move(task));
+    if(!writer.joinable())
+        writer = std::thread(&ScoreJournal::WriterProc, this);
+    wake.notify_one();
+}
+bool ScoreJournal::Pinned()
+{
+    std::lock_guard<std::mutex> lock(guard);
+    DropExpired(pins);
+    return !pins.empty();
+}
+bool ScoreJournal::Flush()
+{
+    std::unique_lock<std::mutex> lock(guard);
+    idle.wait(lock, [this] { return tasks.empty() && !busy; });
+    return !failed;
+}
+void ScoreJournal::WriterProc()
+{
+    for(;;)
+    {
+        Task task;
+        bool quitting;
+        {
+            std::unique_lock<std::mutex> lock(guard);
+            wake.wait(lock, [this] { return quit || !tasks.empty(); });
+            quitting = quit;
+            // On the way out only the appends are still worth the wait
+            while(quitting && !tasks.empty() && tasks.front().compact)
+                tasks.pop_front();
+            if(tasks.empty())
+            {
+                idle.notify_all();
+                break;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            busy = true;
+        }
+
+        bool ok = task.compact || Write(task.entry);
+        if(!task.compact)
+            ++appends;
+        if(ok && (task.compact || appends >= CompactEvery) && !quitting)
+        {
+            // Not every system can replace a mapped file, so while a view lives the compaction waits for the next
+            // append after it is gone
+            if(Pinned())
+                appends = CompactEvery;
+            else
+                ok = Check() && Rewrite();
+        }
+
+        std::lock_guard<std::mutex> lock(guard);
+        failed = failed || !ok;
+        busy = false;
+        if(tasks.empty())
+            idle.notify_all();
+    }
+    if(file)
+        fclose(file);
+    file = nullptr;
+}
+bool ScoreJournal::Check()
+{
+    // Scores that can't be read are never thrown away, they stay in BadFileName() for a person to look at
+    if(checked)
+        return true;
+    size_t end, size;
+    {
+        MappedFile map(fileName.c_str());
+        end = Scan(map.Data(), map.Size(), [](const uint8_t*, size_t) {});
+        size = map.Size();
+        if(size == 0 && !IsMissingOrEmpty(fileName.c_str()))
+            return false;
+        if(end != 0 && end < size && !SaveBytes(BadFileName().c_str(), map.Data() + end, size - end))
+            return false;
+    }
+    if(size != 0 && end == 0)
+    {
+        if(!MoveOver(fileName.c_str(), BadFileName().c_str()))
+            return false;
+        damaged = true;
+    }
+    else if(end < size)
+    {
+        damaged = true;
+        if(!Truncate(fileName.c_str(), end))
+            return false;
+    }
+    // Missing or moved aside, a new journal is started
+    if(end == 0 && !Rewrite())
+        return false;
+    checked = true;
+    return true;
+}
+bool ScoreJournal::Open()
+{
+    if(!Check())
+        return false;
+    if(!file)
+        file = fopen(fileName.c_str(), "ab");
+    return file != nullptr;
+}
+bool ScoreJournal::Write(const std::vector<uint8_t>& entry)
+{
+    if(!Open())
+        return false;
+    if(fwrite(entry.data(), 1, entry.size(), file) == entry.size() && SyncFile(file))
+        return true;
+    // Part of the entry may have made it, the next write sets it aside
+    fclose(file);
+    file = nullptr;
+    checked = false;
+    return false;
+}
+bool ScoreJournal::Rewrite()
+{
+    if(file)
+        fclose(file);
+    file = nullptr;
+
+    // The records of the intact entries, back to back
+    std::vector<uint8_t> records;
+    uint32_t count = 0;
+    {
+        MappedFile map(fileName.c_str());
+        Scan(map.Data(), map.Size(), [&records, &count](const uint8_t* payload, size_t size)
+        {
+            uint32_t n;
+            memcpy(&n, payload, sizeof(n));
+            count += n;
+            records.insert(records.end(), payload + sizeof(n), payload + size);
+        });
+    }
+    if(records.size() > UINT32_MAX - sizeof(uint32_t))
+        return false;
+
+    std::string tempName = fileName + ".tmp";
+    FILE* temp = fopen(tempName.c_str(), "wb");
+    if(!temp)
+        return false;
+    uint32_t version = Version;
+    bool ok = fwrite(Magic, 1, sizeof(Magic), temp) == sizeof(Magic) && fwrite(&version, 1, sizeof(version), temp) == sizeof(version);
+    if(ok && count)
+    {
+        std::vector<uint8_t> entry = MakeEntry(count, records.data(), records.size());
+        ok = fwrite(entry.data(), 1, entry.size(), temp) == entry.size();
+    }
+    ok = SyncFile(temp) && ok;
+    ok = fclose(temp) == 0 && ok;
+    if(!ok || !MoveOver(tempName.c_str(), fileName.c_str()))
+    {
+        remove(tempName.c_str());
+        return false;
+    }
+    checked = true;
+    appends = 0;
+    return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// Score store of the game: an append-only journal file that only ever grows by whole checksummed entries, so a
+// crash or a full disk in the middle of a write loses at most the entry being written.
+//
+// Layout, every number a uint32 in machine order like the score table:
+//   "SNKJ" | version | entries...
+//   entry: payload size | CRC-32 of the payload | payload
+// A payload is a score table in the resource layout of Scores.h, the record count followed by the records. An
+// appended score is a table of one; compaction rewrites the journal as one table of every record.
+//
+// Map maps the file and views the records in place in the order they were added, up to the first entry that is cut
+// short or fails its checksum. Appends and compactions go to a writer thread, so the caller never waits for the disk.
+// A compaction writes the journal to a temporary file, flushes it and renames it over the old one, so the journal on
+// disk is always either the old or the new one. The writer compacts by itself every CompactEvery appends, though not
+// while a view of the journal lives.
+//
+// The journal on disk is checked once, by Map or before the first write. A missing or empty file is created. A file
+// that doesn't start as a journal, a mistyped path or one damaged from its first entry, is moved to BadFileName()
+// and a new journal started. A damaged tail, which would hide everything appended after it, is copied there and
+// cut off. Damaged() tells the caller to report it.
+
+#include "Scores.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class ScoreJournal
+{
+public:
+    static constexpr uint32_t Version = 1;
+    static constexpr uint32_t CompactEvery = 1024;  // appends between automatic compactions
+
+    explicit ScoreJournal(const char* fileName);
+    ScoreJournal(const ScoreJournal&) = delete;
+    ScoreJournal& operator = (const ScoreJournal&) = delete;
+    // Writes the appends still queued, a compaction not yet begun is dropped
+    ~ScoreJournal();
+
+    // Views the records of the journal, oldest first, the offsets counting from the start of the file. False, with
+    // the view empty, if there is no journal yet: no file, an empty one or one that isn't a journal and was moved
+    // aside. A journal due for compaction is compacted first, on the calling thread.
+    bool Map(ScoreView& view);
+    void Append(const ScoreEntry& entry);
+    // Appends the records as one entry, so either all of them make it or none
+    void Append(const ScoreBuilder& records);
+    void Compact();
+    // Waits until everything queued is written, false if a write has failed since the journal was created
+    bool Flush();
+    // Part of the file on disk couldn't be read and was moved to BadFileName()
+    bool Damaged() const;
+    std::string BadFileName() const;
+
+private:
+    struct Task
+    {
+        bool compact;
+        std::vector<uint8_t> entry;  // of an append
+    };
+
+    void Push(Task task);
+    void WriterProc();
+    // Checks the journal on disk once, on the writer thread or while it is idle
+    bool Check();
+    bool Open();
+    bool Write(const std::vector<uint8_t>& entry);
+    bool Rewrite();
+    // A view from Map still lives
+    bool Pinned();
+
+    std::string fileName;
+    FILE* file = nullptr;   // appends to the journal, writer thread only
+    bool checked = false;   // the writer has looked at the journal on disk
+    uint32_t appends = 0;   // since the last compaction
+    bool failed = false;
+    std::atomic<bool> damaged{ false };
+
+    std::mutex guard;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<Task> tasks;
+    std::vector<std::weak_ptr<const void>> pins;  // mappings of the views from Map
+    bool busy = false;      // the writer is working on a task it took off the queue
+    bool quit = false;
+    std::thread writer;     // started by the first append or compaction
+};
+
+// ScoreJournal class methods ------------------------------------------------------------------------------------------------
+inline bool ScoreJournal::Damaged() const { return damaged; }
+inline std::string ScoreJournal::BadFileName() const { return fileName + ".bad"; }
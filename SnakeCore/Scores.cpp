@@ -0,0 +1,75 @@
+#include "Scores.h"
+
+// ScoreView class methods ------------------------------------------------------------------------------------------------
+constexpr uint32_t ScoreView::RecordHeaderSize;
+
+ScoreView::ScoreView(const void* data, size_t size)
+{
+    // Offsets are uint32, a table can't be anywhere near that large anyway
+    size = size < UINT32_MAX ? size : UINT32_MAX;
+    if(!data || size < sizeof(uint32_t))
+        return;
+    this->data = (const uint8_t*)data;
+    this->size = size;
+    uint32_t total;
+    memcpy(&total, data, sizeof(total));
+    count = CountRecords(this->data + sizeof(uint32_t), size - sizeof(uint32_t), total);
+    if(count)
+        runs.push_back({ (uint32_t)sizeof(uint32_t), count });
+}
+bool ScoreView::Get(const uint8_t* data, size_t size, uint32_t offset, ScoreEntry& entry)
+{
+    if(offset % 2 != 0 || offset > size || size - offset < RecordHeaderSize)
+        return false;
+    uint32_t nameLength;
+    memcpy(&nameLength, data + offset + 3 * sizeof(uint32_t), sizeof(nameLength));
+    if((uint64_t)nameLength * sizeof(ScoreChar) > size - offset - RecordHeaderSize)
+        return false;
+    Read(data + offset, entry);
+    return true;
+}
+uint32_t ScoreView::CountRecords(const uint8_t* data, size_t size, uint32_t count)
+{
+    size_t pos = 0;
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t nameLength;
+        if(size - pos < RecordHeaderSize)
+            return i;
+        memcpy(&nameLength, data + pos + 3 * sizeof(uint32_t), sizeof(nameLength));
+        uint64_t recordSize = RecordHeaderSize + (uint64_t)nameLength * sizeof(ScoreChar);
+        if(recordSize > size - pos)
+            return i;
+        pos += (size_t)recordSize;
+    }
+    return count;
+}
+
+// ScoreBuilder class methods ------------------------------------------------------------------------------------------------
+uint32_t ScoreBuilder::Add(const ScoreEntry& entry)
+{
+    size_t offset = arena.size();
+    size_t nameSize = (size_t)entry.nameLength * sizeof(ScoreChar);
+    arena.resize(offset + ScoreView::RecordHeaderSize + nameSize);
+    uint32_t fields[4] = { entry.width, entry.height, entry.score, entry.nameLength };
+    memcpy(arena.data() + offset, fields, sizeof(fields));
+    if(nameSize)
+        memcpy(arena.data() + offset + ScoreView::RecordHeaderSize, entry.name, nameSize);
+    ++count;
+    return (uint32_t)offset;
+}
+void ScoreBuilder::Clear()
+{
+    arena.clear();
+    count = 0;
+}
+ScoreView ScoreBuilder::View() const
+{
+    ScoreView view;
+    view.data = arena.data();
+    view.size = arena.size();
+    view.count = count;
+    if(count)
+        view.runs.push_back({ 0, count });
+    return view;
+}
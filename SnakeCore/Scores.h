@@ -0,0 +1,138 @@
+#pragma once
+
+// High score records in the layout of the IDR_SCOREDATA resource and of the entries of the score journal.
+// Every number is a uint32 in machine order. A record is width | height | score | name length | name, the name in
+// UTF-16 code units without a terminator. A table is the record count followed by the records.
+//
+// Records are read where they lie: a ScoreView indexes them inside a table, a mapped journal or a ScoreBuilder, and a
+// record is addressed by its byte offset there. Records take an even number of bytes, so at an even offset of data
+// that is itself aligned, as a resource, a mapping or an allocation is, the name is aligned for ScoreChar.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+typedef wchar_t ScoreChar;  // TCHAR of the game's Unicode build
+#else
+typedef char16_t ScoreChar;
+#endif
+static_assert(sizeof(ScoreChar) == 2, "names are stored as UTF-16 code units");
+
+// A record read in place, its name pointing into the data it was read from
+struct ScoreEntry
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t score;
+    uint32_t nameLength;
+    const ScoreChar* name;  // nameLength units, not terminated
+};
+
+// Read-only records over data owned elsewhere: nothing is copied or allocated per record. Get checks the offset it is
+// given against the data, so no id can read outside of it. A view from ScoreJournal::Map keeps its mapping alive
+// itself, any other one must not outlive its data.
+class ScoreView
+{
+public:
+    static constexpr uint32_t RecordHeaderSize = 4 * sizeof(uint32_t);
+
+    ScoreView() = default;
+    // The table at data, which may be followed by padding. Records after damage are left out.
+    ScoreView(const void* data, size_t size);
+
+    uint32_t Count() const;
+    // Bytes of the data, every offset is less
+    size_t Size() const;
+    // False if no whole record with an aligned name starts at offset
+    bool Get(uint32_t offset, ScoreEntry& entry) const;
+    // Calls visit(offset, entry) for every record in order
+    template<class F>
+    void ForEach(F visit) const;
+
+private:
+    friend class ScoreJournal;
+    friend class ScoreBuilder;
+
+    // count records back to back from offset
+    struct Run
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // Reads the record at the given address, returns its size
+    static size_t Read(const uint8_t* record, ScoreEntry& entry);
+    static bool Get(const uint8_t* data, size_t size, uint32_t offset, ScoreEntry& entry);
+    // Records of a table that fit in size, counted until the first one that doesn't
+    static uint32_t CountRecords(const uint8_t* data, size_t size, uint32_t count);
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint32_t count = 0;
+    std::vector<Run> runs;              // one per table, a journal has a table per entry
+    std::shared_ptr<const void> owner;  // keeps the data alive, if the view holds it
+};
+
+// New records gathered in one growing arena in the table layout, so they are read like loaded ones and go into a table
+// or a journal entry with one copy
+class ScoreBuilder
+{
+public:
+    // Returns the offset of the record in View(). The name must not point into this builder.
+    uint32_t Add(const ScoreEntry& entry);
+    void Clear();
+    uint32_t Count() const;
+    // The records back to back, without the count of a table
+    const uint8_t* Data() const;
+    size_t Size() const;
+    bool Get(uint32_t offset, ScoreEntry& entry) const;
+    // Valid until the next Add or Clear
+    ScoreView View() const;
+
+private:
+    std::vector<uint8_t> arena;
+    uint32_t count = 0;
+};
+
+// ScoreView class methods ------------------------------------------------------------------------------------------------
+inline uint32_t ScoreView::Count() const { return count; }
+inline size_t ScoreView::Size() const { return size; }
+inline bool ScoreView::Get(uint32_t offset, ScoreEntry& entry) const { return Get(data, size, offset, entry); }
+
+inline size_t ScoreView::Read(const uint8_t* record, ScoreEntry& entry)
+{
+    // Records follow names of any length, so the fields may be misaligned
+    uint32_t fields[4];
+    memcpy(fields, record, sizeof(fields));
+    entry.width = fields[0];
+    entry.height = fields[1];
+    entry.score = fields[2];
+    entry.nameLength = fields[3];
+    entry.name = (const ScoreChar*)(record + RecordHeaderSize);
+    return RecordHeaderSize + (size_t)entry.nameLength * sizeof(ScoreChar);
+}
+template<class F>
+void ScoreView::ForEach(F visit) const
+{
+    // The runs were checked as the view was made
+    ScoreEntry entry;
+    for(const Run& run : runs)
+    {
+        size_t pos = run.offset;
+        for(uint32_t i = 0; i < run.count; ++i)
+        {
+            size_t recordSize = Read(data + pos, entry);
+            visit((uint32_t)pos, (const ScoreEntry&)entry);
+            pos += recordSize;
+        }
+    }
+}
+
+// ScoreBuilder class methods ------------------------------------------------------------------------------------------------
+inline uint32_t ScoreBuilder::Count() const { return count; }
+inline const uint8_t* ScoreBuilder::Data() const { return arena.data(); }
+inline size_t ScoreBuilder::Size() const { return arena.size(); }
+inline bool ScoreBuilder::Get(uint32_t offset, ScoreEntry& entry) const { return ScoreView::Get(arena.data(), arena.size(), offset, entry); }
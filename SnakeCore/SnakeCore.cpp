@@ -0,0 +1,329 @@
+#include "SnakeCore.h"
+#include "Bitboard.h"
+#include "Bits.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr uint32_t InitialCapacity = 64;
+
+    // Fixed parts of the snapshots, followed by the body cells from tail to head
+    struct SnakeState
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t length;
+        uint32_t dir;
+        uint32_t foodEaten;
+    };
+    struct GameState
+    {
+        RandGen rng;
+        uint64_t seed;
+        Point food;
+        uint32_t width;
+        uint32_t height;
+        uint32_t score;
+        uint32_t ticks;
+    };
+}
+
+// Takes time in proportion to the cells it reaches; the marks are kept per thread, in tiles allocated as the searches
+// reach them.
+uint32_t CountReachable(const Snake& snake, uint32_t width, uint32_t height, Point start, bool tailFree)
+{
+    const Snake::Direction directions[] = { Snake::UP, Snake::DOWN, Snake::RIGHT, Snake::LEFT };
+    thread_local CellScratch<uint8_t> seen;
+    thread_local std::vector<Snake::CellInd> queue;
+    seen.Begin(width, height);
+    queue.clear();
+    seen.Set(start, 1);
+    queue.push_back(snake.ToCell(start));
+    for(size_t i = 0; i < queue.size(); ++i)
+        for(auto d : directions)
+        {
+            Point p = Snake::Advance(snake.ToPoint(queue[i]), d);
+            if(p.x < 0 || (uint32_t)p.x >= width || p.y < 0 || (uint32_t)p.y >= height || seen.Has(p))
+                continue;
+            if(snake.IsBody(p) && !(tailFree && p == snake.GetTail()))
+                continue;
+            seen.Set(p, 1);
+            queue.push_back(snake.ToCell(p));
+        }
+    return (uint32_t)queue.size();
+}
+
+// CellSet class methods ------------------------------------------------------------------------------------------------
+constexpr uint32_t CellSet::TileSize;  // std::min binds it by reference, C++14 needs the definition
+CellSet::CellSet(const CellSet& right)
+{
+    *this = right;
+}
+CellSet& CellSet::operator = (const CellSet& right)
+{
+    if(this == &right)
+        return *this;
+    width = right.width;
+    height = right.height;
+    tilesX = right.tilesX;
+    count = right.count;
+    tiles.resize(right.tiles.size());
+    spare.reserve(tiles.size());
+    for(size_t i = 0; i < tiles.size(); ++i)
+    {
+        if(!right.tiles[i])
+            tiles[i].reset();
+        else if(tiles[i])
+            *tiles[i] = *right.tiles[i];
+        else
+            tiles[i] = std::make_unique<Tile>(*right.tiles[i]);
+    }
+    return *this;
+}
+void CellSet::Reset(uint32_t fieldWidth, uint32_t fieldHeight)
+{
+    width = fieldWidth;
+    height = fieldHeight;
+    tilesX = (width + TileSize - 1) / TileSize;
+    tiles.clear();
+    tiles.resize(tilesX * ((height + TileSize - 1) / TileSize));
+    spare.clear();
+    spare.reserve(tiles.size());
+    count = 0;
+}
+Point CellSet::SelectFree(uint32_t n) const
+{
+    for(uint32_t t = 0; ; ++t)
+    {
+        // Tiles on the right and bottom edges may be cut by the field border
+        uint32_t x0 = t % tilesX * TileSize, y0 = t / tilesX * TileSize;
+        uint32_t w = std::min(TileSize, width - x0), h = std::min(TileSize, height - y0);
+        const Tile* tile = tiles[t].get();
+        uint32_t nFree = w * h - (tile ? tile->count : 0);
+        if(n >= nFree)
+        {
+            n -= nFree;
+            continue;
+        }
+        if(!tile)
+            return { (int32_t)(x0 + n % w), (int32_t)(y0 + n / w) };
+
+        uint64_t rowMask = (w == 64) ? ~0ull : (1ull << w) - 1;
+        for(uint32_t y = 0; ; ++y)
+        {
+            uint64_t free = ~tile->rows[y] & rowMask;
+            uint32_t rowFree = PopCount(free);
+            if(n < rowFree)
+                return { (int32_t)(x0 + SelectBit(free, n)), (int32_t)(y0 + y) };
+            n -= rowFree;
+        }
+    }
+}
+
+// Snake class methods ------------------------------------------------------------------------------------------------
+Snake::Direction Snake::GetDirection(Point p1, Point p2)
+{
+    if(p1.x == p2.x)
+        return p1.y < p2.y ? Direction::UP : Direction::DOWN;
+    else
+        return p1.x < p2.x ? Direction::LEFT : Direction::RIGHT;
+}
+void Snake::Reset(uint32_t fieldWidth, uint32_t fieldHeight)
+{
+    gridWidth = fieldWidth;
+    gridHeight = fieldHeight;
+    body.assign(InitialCapacity, 0);
+    cells.Reset(fieldWidth, fieldHeight);
+
+    tailInd = 0;
+    length = 0;
+    Point p = { (int32_t)fieldWidth / 2, (int32_t)fieldHeight / 2 + 2 };
+    for(int i = 0; i < 4; ++i, --p.y)
+    {
+        body[length++] = ToCell(p);
+        cells.Set(p);
+    }
+
+    headInd = length - 1;
+    dir = Direction::UP;
+    foodEaten = false;
+}
+bool Snake::Move(uint32_t fieldWidth, uint32_t fieldHeight)
+{
+    Point nextHead = Advance(GetHead(), dir);
+
+    if(nextHead.x < 0 || (uint32_t)nextHead.x == fieldWidth
+        || nextHead.y < 0 || (uint32_t)nextHead.y == fieldHeight
+        || IsBody(nextHead))
+        return false;
+
+    // The tail cell is still occupied during the check above, so moving into it is a collision
+    if(!foodEaten)
+    {
+        cells.Clear(ToPoint(body[tailInd]));
+        tailInd = Next(tailInd);
+    }
+    else
+    {
+        if(length == Capacity())
+            Grow();
+        ++length;
+        foodEaten = false;
+    }
+    headInd = Next(headInd);
+    body[headInd] = ToCell(nextHead);
+    cells.Set(nextHead);
+    return true;
+}
+size_t Snake::SnapshotSize() const
+{
+    return sizeof(SnakeState) + length * sizeof(CellInd);
+}
+size_t Snake::Snapshot(void* storage) const
+{
+    SnakeState state = { gridWidth, gridHeight, length, (uint32_t)dir, foodEaten };
+    uint8_t* out = (uint8_t*)storage;
+    memcpy(out, &state, sizeof(state));
+    out += sizeof(state);
+
+    // The ring may wrap around, then the body is copied in two runs
+    uint32_t firstRun = std::min(length, Capacity() - tailInd);
+    memcpy(out, body.data() + tailInd, firstRun * sizeof(CellInd));
+    memcpy(out + firstRun * sizeof(CellInd), body.data(), (length - firstRun) * sizeof(CellInd));
+    return SnapshotSize();
+}
+size_t Snake::Restore(const void* storage)
+{
+    SnakeState state;
+    memcpy(&state, storage, sizeof(state));
+    const uint8_t* in = (const uint8_t*)storage + sizeof(state);
+
+    if(state.width != gridWidth || state.height != gridHeight)
+        cells.Reset(state.width, state.height);
+    else
+        for(Point p : Body())
+            cells.Clear(p);
+    gridWidth = state.width;
+    gridHeight = state.height;
+
+    uint32_t capacity = std::max(Capacity(), InitialCapacity);
+    while(capacity < state.length)
+        capacity *= 2;
+    if(capacity != Capacity())
+        body.resize(capacity);
+    memcpy(body.data(), in, state.length * sizeof(CellInd));
+    length = state.length;
+    tailInd = 0;
+    headInd = length - 1;
+    for(uint32_t i = 0; i < length; ++i)
+        cells.Set(ToPoint(body[i]));
+    dir = (Direction)state.dir;
+    foodEaten = state.foodEaten != 0;
+    return sizeof(state) + length * sizeof(CellInd);
+}
+void Snake::Grow()
+{
+    // Unroll the ring into twice the space, tail first
+    std::vector<CellInd> grown(2 * Capacity());
+    for(uint32_t i = 0, ind = tailInd; i < length; ++i, ind = Next(ind))
+        grown[i] = body[ind];
+    body.swap(grown);
+    tailInd = 0;
+    headInd = length - 1;
+}
+bool Snake::IsValidDirection(Direction testDir) const
+{
+    Point prevHead = ToPoint(body[Prev(headInd)]);
+    return (GetDirection(prevHead, GetHead()) != testDir);
+}
+uint32_t Snake::ReachableArea(Direction testDir) const
+{
+    Point nextHead = Advance(GetHead(), testDir);
+    if(!IsValidDirection(testDir) || nextHead.x < 0 || (uint32_t)nextHead.x >= gridWidth
+        || nextHead.y < 0 || (uint32_t)nextHead.y >= gridHeight || IsBody(nextHead))
+        return 0;
+
+    if(!FitsBitboard(gridWidth, gridHeight))
+        return CountReachable(*this, gridWidth, gridHeight, nextHead, !foodEaten) - 1;
+
+    Bitboard free = Bitboard::FreeCells(*this, gridWidth, gridHeight);
+    if(!foodEaten)
+        free.Set(GetTail()); // the tail moves off its cell on the same tick
+    return ::ReachableArea(free, nextHead) - 1;
+}
+
+// Game class methods ------------------------------------------------------------------------------------------------
+void Game::Reset(uint32_t fieldWidth, uint32_t fieldHeight, uint64_t gameSeed)
+{
+    width = fieldWidth;
+    height = fieldHeight;
+    seed = gameSeed;
+    score = 0;
+    ticks = 0;
+    rng.Seed(seed);
+    snake.Reset(width, height);
+    SpawnFood();
+}
+Game::StepResult Game::Step()
+{
+    StepResult res = Advance();
+    if(res == Ate)
+        SpawnFood();
+    return res;
+}
+Game::StepResult Game::Advance()
+{
+    ++ticks;
+    if(!snake.Move(width, height))
+        return Died;
+    if(snake.GetHead() != food)
+        return Moved;
+
+    snake.Eat();
+    ++score;
+    if(snake.BodySize() == width * height)
+        return Won;
+    return Ate;
+}
+size_t Game::SnapshotSize() const
+{
+    return sizeof(GameState) + snake.SnapshotSize();
+}
+size_t Game::MaxSnapshotSize(uint32_t fieldWidth, uint32_t fieldHeight)
+{
+    return sizeof(GameState) + sizeof(SnakeState) + (size_t)fieldWidth * fieldHeight * sizeof(Snake::CellInd);
+}
+size_t Game::Snapshot(void* storage) const
+{
+    GameState state = { rng, seed, food, width, height, score, ticks };
+    memcpy(storage, &state, sizeof(state));
+    return sizeof(state) + snake.Snapshot((uint8_t*)storage + sizeof(state));
+}
+void Game::Restore(const void* storage)
+{
+    GameState state;
+    memcpy(&state, storage, sizeof(state));
+    snake.Restore((const uint8_t*)storage + sizeof(state));
+    rng = state.rng;
+    seed = state.seed;
+    food = state.food;
+    width = state.width;
+    height = state.height;
+    score = state.score;
+    ticks = state.ticks;
+}
+void Game::SpawnFood()
+{
+    // While at least half of the field is free, random cells are drawn until a free one comes up, which takes
+    // fewer than two draws on average. On a fuller field the free cells are counted off tile by tile instead.
+    const CellSet& cells = snake.Cells();
+    if(cells.FreeCount() >= cells.Count())
+    {
+        do
+            food = { (int32_t)rng.Below(width), (int32_t)rng.Below(height) };
+        while(cells.Test(food));
+    }
+    else
+        food = cells.SelectFree(rng.Below(cells.FreeCount()));
+}
@@ -0,0 +1,435 @@
+#pragma once
+
+// Platform-neutral game rules shared by the window game and the headless tools
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <limits>
+
+constexpr uint32_t MinWidth = 8;
+constexpr uint32_t MinHeight = 8;
+constexpr uint32_t MaxWidth = 4096;
+constexpr uint32_t MaxHeight = 4096;
+// Changes whenever the same seed and moves could play out differently, so older replays are refused
+constexpr uint32_t RulesVersion = 1;
+
+struct Point
+{
+    int32_t x;
+    int32_t y;
+};
+
+inline bool operator == (const Point& p1, const Point& p2) { return p1.x == p2.x && p1.y == p2.y; }
+inline bool operator != (const Point& p1, const Point& p2) { return !(p1 == p2); }
+
+// PCG32 generator (64-bit LCG state, XSH RR output). Each stream number selects an independent sequence.
+class RandGen
+{
+public:
+    RandGen(uint64_t seed = 0, uint64_t stream = 0) { Seed(seed, stream); }
+    void Seed(uint64_t seed, uint64_t stream = 0)
+    {
+        state = 0;
+        inc = (stream << 1) | 1;
+        Next();
+        state += seed;
+        Next();
+    }
+    uint32_t Next()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rot = (uint32_t)(old >> 59);
+        return (xorShifted >> rot) | (xorShifted << ((0u - rot) & 31));
+    }
+    uint64_t Next64()
+    {
+        uint64_t high = Next();
+        return (high << 32) | Next();
+    }
+    // Unbiased value in [0, bound) by multiply-and-reject, bound must be nonzero
+    uint32_t Below(uint32_t bound)
+    {
+        uint64_t m = (uint64_t)Next() * bound;
+        if((uint32_t)m < bound)
+        {
+            uint32_t threshold = (0u - bound) % bound;
+            while((uint32_t)m < threshold)
+                m = (uint64_t)Next() * bound;
+        }
+        return (uint32_t)(m >> 32);
+    }
+    // New generator on its own stream, seeded from this one
+    RandGen Split()
+    {
+        uint64_t seed = Next64();
+        return RandGen(seed, Next64());
+    }
+    uint32_t operator () () { return Next(); }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+// Occupied cells of a field of any size. The field is cut into square tiles of bits, a tile is allocated when
+// its first cell is set and released when its last one is cleared, so memory follows the occupied cells rather
+// than the field area. Released tiles are kept for reuse, so a body moving across tiles doesn't allocate.
+// Per tile counts let SelectFree skip whole tiles instead of scanning every cell.
+class CellSet
+{
+public:
+    static constexpr uint32_t TileSize = 64;
+
+    CellSet() = default;
+    CellSet(const CellSet& right);
+    CellSet(CellSet&& right) = default;
+    CellSet& operator = (const CellSet& right);
+    CellSet& operator = (CellSet&& right) = default;
+
+    void Reset(uint32_t fieldWidth, uint32_t fieldHeight);
+    bool Test(Point p) const;
+    void Set(Point p);
+    void Clear(Point p);
+    uint32_t Count() const;
+    uint32_t FreeCount() const;
+    // Free cell number n counting tile by tile, each tile row by row; n must be below FreeCount()
+    Point SelectFree(uint32_t n) const;
+
+private:
+    struct Tile
+    {
+        uint64_t rows[TileSize];
+        uint32_t count;
+    };
+    uint32_t TileIndex(Point p) const;
+
+private:
+    std::vector<std::unique_ptr<Tile>> tiles;
+    std::vector<std::unique_ptr<Tile>> spare; // released tiles, all zero
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tilesX = 0;
+    uint32_t count = 0;
+};
+
+// Per-cell values of searches over a field, every cell empty at the start of a search without touching every cell:
+// a value counts only if it was set under the stamp of the current search. Like CellSet the field is cut into
+// tiles, allocated when a search first sets a cell in them and kept for the searches after, so memory follows the
+// cells the searches reach rather than the field area, and a search costs time in proportion to the cells it visits.
+template<typename T>
+class CellScratch
+{
+public:
+    static constexpr uint32_t TileSize = 64;
+
+    // Starts a search over a field of the given size
+    void Begin(uint32_t fieldWidth, uint32_t fieldHeight);
+    bool Has(Point p) const;
+    // Value of a cell that Has one
+    const T& Get(Point p) const;
+    void Set(Point p, const T& value);
+
+private:
+    struct Entry
+    {
+        uint32_t stamp;
+        T value;
+    };
+    struct Tile
+    {
+        Entry entries[TileSize * TileSize];
+    };
+    const Entry* Find(Point p) const;
+
+    std::vector<std::unique_ptr<Tile>> tiles;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tilesX = 0;
+    uint32_t stamp = 0;
+};
+
+class Snake
+{
+public:
+    enum Direction { UP, DOWN, RIGHT, LEFT }; // opposite directions differ only in the lowest bit
+    typedef uint32_t CellInd;
+
+    // Read-only view of the body from tail to head, yielding segments as field points
+    class BodyView
+    {
+    public:
+        class Iterator
+        {
+        public:
+            Iterator(const CellInd* ring, uint32_t pos, uint32_t capacity, uint32_t fieldWidth)
+                : ring(ring), pos(pos), capacity(capacity), fieldWidth(fieldWidth) {}
+            Point operator * () const
+            {
+                CellInd cell = ring[pos < capacity ? pos : pos - capacity];
+                return { (int32_t)(cell % fieldWidth), (int32_t)(cell / fieldWidth) };
+            }
+            Iterator& operator ++ () { ++pos; return *this; }
+            bool operator == (const Iterator& right) const { return pos == right.pos; }
+            bool operator != (const Iterator& right) const { return pos != right.pos; }
+
+        private:
+            const CellInd* ring;
+            uint32_t pos;
+            uint32_t capacity;
+            uint32_t fieldWidth;
+        };
+
+        BodyView(const Snake& s) : snake(s) {}
+        Iterator begin() const { return Iterator(snake.body.data(), snake.tailInd, snake.Capacity(), snake.gridWidth); }
+        Iterator end() const { return Iterator(snake.body.data(), snake.tailInd + snake.length, snake.Capacity(), snake.gridWidth); }
+        uint32_t size() const { return snake.length; }
+
+    private:
+        const Snake& snake;
+    };
+
+    // Direction of the step leading from p2 to p1
+    static Direction GetDirection(Point p1, Point p2);
+    // Neighbouring cell of p in direction d, may lie outside the field
+    static Point Advance(Point p, Direction d);
+    static Direction Opposite(Direction d);
+
+    void Reset(uint32_t fieldWidth, uint32_t fieldHeight);
+    Direction GetDirection() const;
+    void SetDirection(Direction d);
+    Point GetHead() const;
+    Point GetTail() const;
+    uint32_t BodySize() const;
+    void Eat();
+    // True if the food was eaten and the snake grows on the next move instead of moving its tail
+    bool IsGrowing() const;
+    bool Move(uint32_t fieldWidth, uint32_t fieldHeight);
+    bool IsValidDirection(Direction dir) const;
+    // Free cells the head can still reach after moving in direction dir, 0 if that move ends the game
+    uint32_t ReachableArea(Direction dir) const;
+    bool IsBody(Point testPoint) const;
+    BodyView Body() const;
+    const CellSet& Cells() const;
+    Point ToPoint(CellInd cell) const;
+    CellInd ToCell(Point p) const;
+
+    // Bytes Snapshot writes: a fixed part and the body cells
+    size_t SnapshotSize() const;
+    // Copies the state to storage and returns the bytes written
+    size_t Snapshot(void* storage) const;
+    // Takes back a state written by Snapshot and returns the bytes read. This snake's buffers are reused and only
+    // allocate when the body is longer, or covers more tiles, than ever before in this snake.
+    size_t Restore(const void* storage);
+
+private:
+    uint32_t Capacity() const;
+    uint32_t Next(uint32_t ringInd) const;
+    uint32_t Prev(uint32_t ringInd) const;
+    void Grow();
+
+private:
+    // Ring buffer of field cell indices, doubled when the body fills it so it follows the snake length
+    // rather than the field area. The body runs from tailInd to headInd inclusive.
+    std::vector<CellInd> body;
+    CellSet cells; // field cells covered by the body
+    uint32_t gridWidth = 0;
+    uint32_t gridHeight = 0;
+    uint32_t headInd = (uint32_t)-1;
+    uint32_t tailInd = 0;
+    uint32_t length = 0;
+    Direction dir = Direction::UP;
+    bool foodEaten = false;
+};
+
+static_assert(MaxWidth * MaxHeight - 1 <= std::numeric_limits<Snake::CellInd>::max(), "Snake::CellInd can't address every field cell");
+
+// One game: the snake, the food and the score, advanced one tick at a time
+class Game
+{
+public:
+    enum StepResult { Moved, Ate, Died, Won };
+
+    void Reset(uint32_t fieldWidth, uint32_t fieldHeight, uint64_t seed);
+    StepResult Step();
+    // Step without placing the next food after a meal: on Ate the caller calls SpawnFood before the game is used
+    // again. Lets a frontend time the two apart.
+    StepResult Advance();
+
+    // Plain copy of the whole state into caller's storage, for search that tries moves and goes back.
+    // Snapshot writes SnapshotSize() bytes, never more than MaxSnapshotSize(Width(), Height()), and allocates nothing.
+    // Restore accepts a snapshot of any game, see Snake::Restore for when it allocates.
+    size_t SnapshotSize() const;
+    static size_t MaxSnapshotSize(uint32_t fieldWidth, uint32_t fieldHeight);
+    size_t Snapshot(void* storage) const;
+    void Restore(const void* storage);
+    // Replaces the generator that places the food, so a search can sample food it has no way of knowing yet.
+    // The game no longer follows its seed afterwards.
+    void ReseedFood(uint64_t foodSeed);
+    // Moves the food to a random free cell, as Step does after a meal. Calling it from outside changes the game
+    // its seed would play, it is public for benchmarks.
+    void SpawnFood();
+
+    Snake& GetSnake();
+    const Snake& GetSnake() const;
+    Point GetFood() const;
+    uint32_t Width() const;
+    uint32_t Height() const;
+    uint32_t Score() const;
+    uint32_t Ticks() const;
+    uint64_t Seed() const;
+
+private:
+    Snake snake;
+    Point food = { 0, 0 };
+    RandGen rng;
+    uint64_t seed = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t score = 0;
+    uint32_t ticks = 0;
+};
+
+// Breadth-first count of the free cells of a width x height field connected to start, start included, the tail
+// counted as free if tailFree. Snake::ReachableArea uses it on fields too large for a Bitboard, it is the reference
+// the flood fill kernels are checked against.
+uint32_t CountReachable(const Snake& snake, uint32_t width, uint32_t height, Point start, bool tailFree);
+
+// CellSet class methods ------------------------------------------------------------------------------------------------
+inline uint32_t CellSet::TileIndex(Point p) const { return (uint32_t)p.y / TileSize * tilesX + (uint32_t)p.x / TileSize; }
+inline uint32_t CellSet::Count() const { return count; }
+inline uint32_t CellSet::FreeCount() const { return width * height - count; }
+inline bool CellSet::Test(Point p) const
+{
+    const Tile* tile = tiles[TileIndex(p)].get();
+    return tile && ((tile->rows[p.y % TileSize] >> (p.x % TileSize)) & 1);
+}
+inline void CellSet::Set(Point p)
+{
+    auto& tile = tiles[TileIndex(p)];
+    if(!tile)
+    {
+        if(spare.empty())
+            tile = std::make_unique<Tile>();
+        else
+        {
+            tile = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    uint64_t& row = tile->rows[p.y % TileSize];
+    uint64_t bit = 1ull << (p.x % TileSize);
+    if(row & bit)
+        return;
+    row |= bit;
+    ++tile->count;
+    ++count;
+}
+inline void CellSet::Clear(Point p)
+{
+    auto& tile = tiles[TileIndex(p)];
+    uint64_t bit = 1ull << (p.x % TileSize);
+    if(!tile || !(tile->rows[p.y % TileSize] & bit))
+        return;
+    tile->rows[p.y % TileSize] &= ~bit;
+    --count;
+    if(--tile->count == 0)
+        spare.push_back(std::move(tile));
+}
+
+// CellScratch class methods ------------------------------------------------------------------------------------------------
+template<typename T>
+constexpr uint32_t CellScratch<T>::TileSize;
+
+template<typename T>
+void CellScratch<T>::Begin(uint32_t fieldWidth, uint32_t fieldHeight)
+{
+    if(fieldWidth != width || fieldHeight != height)
+    {
+        width = fieldWidth;
+        height = fieldHeight;
+        tilesX = (width + TileSize - 1) / TileSize;
+        tiles.clear();
+        tiles.resize(tilesX * ((height + TileSize - 1) / TileSize));
+        stamp = 0;
+    }
+    // The stamp running out after 4 billion searches clears the cells for real
+    if(++stamp == 0)
+    {
+        for(auto& tile : tiles)
+            if(tile)
+                for(Entry& e : tile->entries)
+                    e.stamp = 0;
+        stamp = 1;
+    }
+}
+template<typename T>
+inline const typename CellScratch<T>::Entry* CellScratch<T>::Find(Point p) const
+{
+    const Tile* tile = tiles[(uint32_t)p.y / TileSize * tilesX + (uint32_t)p.x / TileSize].get();
+    return tile ? &tile->entries[p.y % TileSize * TileSize + p.x % TileSize] : nullptr;
+}
+template<typename T>
+inline bool CellScratch<T>::Has(Point p) const
+{
+    const Entry* e = Find(p);
+    return e && e->stamp == stamp;
+}
+template<typename T>
+inline const T& CellScratch<T>::Get(Point p) const { return Find(p)->value; }
+template<typename T>
+inline void CellScratch<T>::Set(Point p, const T& value)
+{
+    auto& tile = tiles[(uint32_t)p.y / TileSize * tilesX + (uint32_t)p.x / TileSize];
+    if(!tile)
+        tile = std::make_unique<Tile>();  // value-initialized, no cell stamped yet
+    tile->entries[p.y % TileSize * TileSize + p.x % TileSize] = { stamp, value };
+}
+
+// Snake class methods ------------------------------------------------------------------------------------------------
+inline Point Snake::Advance(Point p, Direction d)
+{
+    switch(d)
+    {
+        case Snake::UP: --p.y; break;
+        case Snake::DOWN: ++p.y; break;
+        case Snake::LEFT: --p.x; break;
+        case Snake::RIGHT: ++p.x; break;
+    }
+    return p;
+}
+inline Snake::Direction Snake::Opposite(Direction d) { return (Direction)(d ^ 1); }
+inline Snake::Direction Snake::GetDirection() const { return dir; }
+inline void Snake::SetDirection(Direction d) { dir = d; }
+inline Point Snake::GetHead() const { return ToPoint(body[headInd]); }
+inline Point Snake::GetTail() const { return ToPoint(body[tailInd]); }
+inline Snake::BodyView Snake::Body() const { return BodyView(*this); }
+inline uint32_t Snake::BodySize() const { return length; }
+inline const CellSet& Snake::Cells() const { return cells; }
+inline void Snake::Eat() { foodEaten = true; }
+inline bool Snake::IsGrowing() const { return foodEaten; }
+inline uint32_t Snake::Capacity() const { return (uint32_t)body.size(); }
+inline uint32_t Snake::Next(uint32_t ringInd) const { return ringInd + 1 == Capacity() ? 0 : ringInd + 1; }
+inline uint32_t Snake::Prev(uint32_t ringInd) const { return (ringInd == 0 ? Capacity() : ringInd) - 1; }
+inline Point Snake::ToPoint(CellInd cell) const { return { (int32_t)(cell % gridWidth), (int32_t)(cell / gridWidth) }; }
+inline Snake::CellInd Snake::ToCell(Point p) const { return (CellInd)(gridWidth * p.y + p.x); }
+inline bool Snake::IsBody(Point testPoint) const
+{
+    if(testPoint.x < 0 || (uint32_t)testPoint.x >= gridWidth || testPoint.y < 0 || (uint32_t)testPoint.y >= gridHeight)
+        return false;
+    return cells.Test(testPoint);
+}
+
+// Game class methods ------------------------------------------------------------------------------------------------
+inline Snake& Game::GetSnake() { return snake; }
+inline const Snake& Game::GetSnake() const { return snake; }
+inline Point Game::GetFood() const { return food; }
+inline uint32_t Game::Width() const { return width; }
+inline uint32_t Game::Height() const { return height; }
+inline uint32_t Game::Score() const { return score; }
+inline uint32_t Game::Ticks() const { return ticks; }
+inline uint64_t Game::Seed() const { return seed; }
+inline void Game::ReseedFood(uint64_t foodSeed) { rng.Seed(foodSeed); }
@@ -0,0 +1,101 @@
+#include "TaskPool.h"
+
+TaskPool::TaskPool(uint32_t nThreads)
+{
+    if(nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for(uint32_t i = 0; i < nThreads; ++i)
+        queues.emplace_back(std::make_unique<Queue>());
+    for(uint32_t i = 0; i < nThreads; ++i)
+        threads.emplace_back(&TaskPool::WorkerProc, this, i);
+}
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for(auto& t : threads)
+        t.join();
+}
+void TaskPool::Submit(Task task)
+{
+    // Counted before the task is in, so queued never drops below the tasks in the queues; a worker that sees the
+    // count before the task is in just looks again
+    ++pending;
+    ++queued;
+    Queue& q = *queues[nextQueue++ % queues.size()];
+    {
+        std::lock_guard<std::mutex> guard(q.lock);
+        q.tasks.emplace_back(std::move(task));
+    }
+    // A worker counts itself sleeping before it checks queued, so either it sees this task or it is counted here
+    // and, once the lock is free, waiting for the notification
+    if(sleeping != 0)
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+    }
+    wakeUp.notify_one();
+}
+void TaskPool::Wait()
+{
+    std::unique_lock<std::mutex> guard(stateLock);
+    allDone.wait(guard, [this] { return pending == 0; });
+}
+bool TaskPool::PopTask(uint32_t worker, Task& task)
+{
+    {
+        Queue& own = *queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.tasks.empty())
+        {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    for(size_t i = 1; i < queues.size(); ++i)
+    {
+        Queue& victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if(!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
+void TaskPool::WorkerProc(uint32_t worker)
+{
+    Task task;
+    for(;;)
+    {
+        if(!PopTask(worker, task))
+        {
+            // Another worker may have taken the task that woke this one, then it just waits again. Only a stopping
+            // pool with nothing left to run lets a worker go.
+            std::unique_lock<std::mutex> guard(stateLock);
+            ++sleeping;
+            wakeUp.wait(guard, [this] { return stopping || queued != 0; });
+            --sleeping;
+            if(stopping && queued == 0)
+                return;
+            continue;
+        }
+
+        task(worker);
+        task = nullptr;
+
+        if(--pending == 0)
+        {
+            std::lock_guard<std::mutex> guard(stateLock);
+            allDone.notify_all();
+        }
+    }
+}
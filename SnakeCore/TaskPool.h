@@ -0,0 +1,57 @@
+#pragma once
+
+// Fixed set of worker threads with per-worker task queues. A worker takes tasks from the front of its own queue
+// and, when that runs dry, steals from the back of the others' queues. Task counts are atomic, so submitting and
+// taking tasks only lock the queue involved; a worker that finds every queue empty goes back to sleep and only then
+// does a Submit take the lock that wakes it.
+
+#include <cstdint>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+class TaskPool
+{
+public:
+    // Task receives the index of the worker running it, in [0, Size())
+    typedef std::function<void(uint32_t)> Task;
+
+    explicit TaskPool(uint32_t nThreads = 0);
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator = (const TaskPool&) = delete;
+    ~TaskPool();
+
+    uint32_t Size() const;
+    void Submit(Task task);
+    void Wait();
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerProc(uint32_t worker);
+    bool PopTask(uint32_t worker, Task& task);
+
+private:
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex stateLock;
+    std::condition_variable wakeUp;
+    std::condition_variable allDone;
+    std::atomic<uint32_t> nextQueue{ 0 };
+    std::atomic<uint64_t> queued{ 0 };    // tasks in the queues, counted before they are in and after they leave
+    std::atomic<uint64_t> pending{ 0 };   // tasks submitted but not yet finished
+    std::atomic<uint32_t> sleeping{ 0 };  // workers waiting on wakeUp, or about to
+    bool stopping = false;                // guarded by stateLock
+};
+
+inline uint32_t TaskPool::Size() const { return (uint32_t)threads.size(); }
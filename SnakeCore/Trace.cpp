@@ -0,0 +1,153 @@
+#include "Trace.h"
+#include <cstdio>
+#include <cinttypes>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+    // Relaxed atomics, so a writer overwriting a span the flush is copying is no data race; the copy is dropped
+    struct TraceEvent
+    {
+        std::atomic<const char*> name;
+        std::atomic<int64_t> begin;
+        std::atomic<int64_t> end;
+    };
+
+    struct ThreadRing
+    {
+        TraceEvent events[Trace::RingSize];
+        std::atomic<uint64_t> head{ 0 };  // spans recorded so far, the next goes to head % RingSize
+        uint32_t tid = 0;
+        std::string name;  // under the registry lock
+    };
+
+    struct Span
+    {
+        const char* name;
+        int64_t begin;
+        int64_t end;
+        uint32_t tid;
+    };
+
+    // Rings of every thread that ever traced, kept to the end of the process so a flush can read those of threads
+    // that have exited
+    std::mutex registryLock;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    thread_local ThreadRing* threadRing = nullptr;
+    thread_local const char* threadName = nullptr;  // for the ring once the thread has one
+
+    ThreadRing& ThisThreadRing()
+    {
+        if(!threadRing)
+        {
+            auto ring = std::make_unique<ThreadRing>();
+            std::lock_guard<std::mutex> lock(registryLock);
+            ring->tid = (uint32_t)rings.size() + 1;
+            if(threadName)
+                ring->name = threadName;
+            threadRing = ring.get();
+            rings.push_back(std::move(ring));
+        }
+        return *threadRing;
+    }
+
+    // Spans of one ring as they were when it was read, oldest first
+    void CopyRing(const ThreadRing& ring, std::vector<Span>& spans)
+    {
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        uint64_t first = head > Trace::RingSize ? head - Trace::RingSize : 0;
+        size_t start = spans.size();
+        for(uint64_t i = first; i < head; ++i)
+        {
+            const TraceEvent& e = ring.events[i % Trace::RingSize];
+            spans.push_back({ e.name.load(std::memory_order_relaxed), e.begin.load(std::memory_order_relaxed),
+                e.end.load(std::memory_order_relaxed), ring.tid });
+        }
+        // The writer may have gone on meanwhile: the slot of span i is reused by span i + RingSize, which is being
+        // written once head reaches it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = ring.head.load(std::memory_order_relaxed);
+        if(now + 1 > first + Trace::RingSize)
+        {
+            uint64_t lost = std::min<uint64_t>(now + 1 - Trace::RingSize - first, head - first);
+            spans.erase(spans.begin() + start, spans.begin() + start + (size_t)lost);
+        }
+    }
+}
+
+// Trace class methods ------------------------------------------------------------------------------------------------
+constexpr uint32_t Trace::RingSize;
+std::atomic<bool> Trace::enabled{ false };
+
+void Trace::Start()
+{
+    enabled.store(true, std::memory_order_relaxed);
+}
+void Trace::Stop()
+{
+    enabled.store(false, std::memory_order_relaxed);
+}
+void Trace::NameThread(const char* name)
+{
+    threadName = name;
+    if(threadRing)
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+        threadRing->name = name;
+    }
+}
+void Trace::Record(const char* name, int64_t beginNs, int64_t endNs)
+{
+    ThreadRing& ring = ThisThreadRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    // Pairs with the fence in CopyRing: a reader that sees any of the stores below also sees head at least this far
+    // and drops the slot
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent& e = ring.events[head % RingSize];
+    e.name.store(name, std::memory_order_relaxed);
+    e.begin.store(beginNs, std::memory_order_relaxed);
+    e.end.store(endNs, std::memory_order_relaxed);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+bool Trace::WriteFile(const char* fileName)
+{
+    std::vector<Span> spans;
+    std::vector<std::pair<uint32_t, std::string>> threads;
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+        for(const auto& ring : rings)
+        {
+            CopyRing(*ring, spans);
+            threads.emplace_back(ring->tid, ring->name);
+        }
+    }
+
+    FILE* file = fopen(fileName, "wb");
+    if(!file)
+        return false;
+    // Times in microseconds from the first span, the unit of the format
+    int64_t origin = spans.empty() ? 0 : std::min_element(spans.begin(), spans.end(),
+        [](const Span& a, const Span& b) { return a.begin < b.begin; })->begin;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for(const auto& t : threads)
+    {
+        if(t.second.empty())
+            continue;
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n",
+            t.first, t.second.c_str());
+        first = false;
+    }
+    for(const auto& s : spans)
+    {
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n",
+            s.name, s.tid, (s.begin - origin) / 1e3, (s.end - s.begin) / 1e3);
+        first = false;
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Trace mode for looking into stalls: spans of the game loop recorded as they close, written out as Chrome
+// trace-event JSON that Perfetto (ui.perfetto.dev) or chrome://tracing opens.
+//
+// Every thread records into a fixed ring of its own, taken on its first span, so recording neither locks nor
+// allocates: two clock reads and three stores. The ring keeps the latest RingSize spans of its thread. While
+// tracing is off a span costs one relaxed load. WriteFile may run while other threads record; a span a thread
+// overwrites in the meantime is left out rather than written half old, half new.
+
+#include <cstdint>
+#include <atomic>
+#include "Scheduler.h"
+
+class Trace
+{
+public:
+    static constexpr uint32_t RingSize = 16384;  // spans kept per thread
+
+    static void Start();
+    static void Stop();
+    static bool Enabled();
+    // Names the calling thread in the trace, name must outlive the thread. Costs nothing until the thread traces.
+    static void NameThread(const char* name);
+    // Writes what the rings hold, false if the file can't be written
+    static bool WriteFile(const char* fileName);
+
+    // name must be a string literal, it is kept by pointer and written without escaping
+    static void Record(const char* name, int64_t beginNs, int64_t endNs);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Records the time from its construction to its destruction as one span, if tracing was on when it began
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name);
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator = (const TraceSpan&) = delete;
+    ~TraceSpan();
+
+private:
+    const char* name;
+    int64_t begin;
+};
+
+// Trace class methods ------------------------------------------------------------------------------------------------
+inline bool Trace::Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+// TraceSpan class methods ------------------------------------------------------------------------------------------------
+inline TraceSpan::TraceSpan(const char* name)
+    : name(Trace::Enabled() ? name : nullptr), begin(this->name ? SteadyTickClock().Now() : 0)
+{
+}
+inline TraceSpan::~TraceSpan()
+{
+    if(name)
+        Trace::Record(name, begin, SteadyTickClock().Now());
+}
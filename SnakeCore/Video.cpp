@@ -0,0 +1,287 @@
+#include "Video.h"
+#include "BoundedQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    uint32_t ReadLE(const uint8_t* p, uint32_t bytes)
+    {
+        uint32_t v = 0;
+        for(uint32_t i = 0; i < bytes; ++i)
+            v |= (uint32_t)p[i] << (8 * i);
+        return v;
+    }
+
+    bool ReadFile(const std::string& fileName, std::vector<uint8_t>& data)
+    {
+        FILE* file = fopen(fileName.c_str(), "rb");
+        if(!file)
+            return false;
+        uint8_t buf[4096];
+        for(size_t n; (n = fread(buf, 1, sizeof(buf), file)) != 0; )
+            data.insert(data.end(), buf, buf + n);
+        bool ok = !ferror(file);
+        fclose(file);
+        return ok;
+    }
+
+    // Top left cell of a view that keeps the head in the middle where the field allows, as the game window scrolls
+    Point ViewOrigin(const Game& game, uint32_t viewWidth, uint32_t viewHeight)
+    {
+        Point head = game.GetSnake().GetHead();
+        return { std::max(0, std::min(head.x - (int32_t)viewWidth / 2, (int32_t)(game.Width() - viewWidth))),
+                 std::max(0, std::min(head.y - (int32_t)viewHeight / 2, (int32_t)(game.Height() - viewHeight))) };
+    }
+
+    // BT.601 limited range, luma of one pixel and chroma of the sums of four
+    inline uint8_t Luma(uint32_t r, uint32_t g, uint32_t b)
+    {
+        return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+    inline uint8_t ChromaU(int32_t r4, int32_t g4, int32_t b4)
+    {
+        return (uint8_t)((-38 * r4 - 74 * g4 + 112 * b4 + (128 << 10) + 512) >> 10);
+    }
+    inline uint8_t ChromaV(int32_t r4, int32_t g4, int32_t b4)
+    {
+        return (uint8_t)((112 * r4 - 94 * g4 - 18 * b4 + (128 << 10) + 512) >> 10);
+    }
+
+    // Encodes rect of the width x height picture src into the planar 4:2:0 frame out, with the chroma of every 2x2
+    // block it touches from the block's average color. An odd last row or column pairs with itself.
+    void ToYuv420(const uint32_t* src, uint32_t width, uint32_t height, const PixelRect& rect, uint8_t* out)
+    {
+        uint32_t chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+        uint8_t* yPlane = out;
+        uint8_t* uPlane = yPlane + (size_t)width * height;
+        uint8_t* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+        for(uint32_t y = rect.top; y < rect.bottom; ++y)
+        {
+            const uint32_t* row = src + (size_t)y * width;
+            uint8_t* luma = yPlane + (size_t)y * width;
+            for(uint32_t x = rect.left; x < rect.right; ++x)
+            {
+                uint32_t p = row[x];
+                luma[x] = Luma((p >> 16) & 0xFF, (p >> 8) & 0xFF, p & 0xFF);
+            }
+        }
+        for(uint32_t cy = rect.top / 2; cy < (rect.bottom + 1) / 2; ++cy)
+        {
+            const uint32_t* row0 = src + (size_t)2 * cy * width;
+            const uint32_t* row1 = src + (size_t)std::min(2 * cy + 1, height - 1) * width;
+            for(uint32_t cx = rect.left / 2; cx < (rect.right + 1) / 2; ++cx)
+            {
+                uint32_t x0 = 2 * cx, x1 = std::min(x0 + 1, width - 1);
+                // Red and blue summed apart from green, four 8-bit values fit each 16-bit half
+                uint32_t rb = (row0[x0] & 0xFF00FF) + (row0[x1] & 0xFF00FF) + (row1[x0] & 0xFF00FF) + (row1[x1] & 0xFF00FF);
+                uint32_t g = (row0[x0] & 0xFF00) + (row0[x1] & 0xFF00) + (row1[x0] & 0xFF00) + (row1[x1] & 0xFF00);
+                int32_t r4 = (int32_t)(rb >> 16), g4 = (int32_t)(g >> 8), b4 = (int32_t)(rb & 0xFFFF);
+                uPlane[(size_t)cy * chromaWidth + cx] = ChromaU(r4, g4, b4);
+                vPlane[(size_t)cy * chromaWidth + cx] = ChromaV(r4, g4, b4);
+            }
+        }
+    }
+
+    void ToRgb(const uint32_t* src, uint32_t width, const PixelRect& rect, uint8_t* out)
+    {
+        for(uint32_t y = rect.top; y < rect.bottom; ++y)
+            for(uint32_t x = rect.left; x < rect.right; ++x)
+            {
+                uint32_t p = src[(size_t)y * width + x];
+                uint8_t* rgb = out + 3 * ((size_t)y * width + x);
+                rgb[0] = (uint8_t)(p >> 16);
+                rgb[1] = (uint8_t)(p >> 8);
+                rgb[2] = (uint8_t)p;
+            }
+    }
+
+    double Since(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+bool ReadBmp(const std::vector<uint8_t>& file, std::vector<uint32_t>& pixels, uint32_t& width, uint32_t& height)
+{
+    constexpr size_t FileHeaderSize = 14;
+    if(file.size() < FileHeaderSize + 40 || file[0] != 'B' || file[1] != 'M')
+        return false;
+    const uint8_t* info = file.data() + FileHeaderSize;
+    uint32_t offset = ReadLE(file.data() + 10, 4);
+    int32_t w = (int32_t)ReadLE(info + 4, 4), h = (int32_t)ReadLE(info + 8, 4);
+    uint32_t bpp = ReadLE(info + 14, 2), compression = ReadLE(info + 16, 4);
+    if(ReadLE(info, 4) < 40 || w <= 0 || h == 0 || h == INT32_MIN || (bpp != 24 && bpp != 32) || compression != 0)
+        return false;
+
+    // Rows are bottom up unless the height is negative, each padded to 4 bytes
+    bool topDown = h < 0;
+    width = (uint32_t)w;
+    height = (uint32_t)(topDown ? -h : h);
+    size_t stride = ((size_t)width * bpp + 31) / 32 * 4;
+    if(offset > file.size() || (file.size() - offset) / stride < height)
+        return false;
+    pixels.resize((size_t)width * height);
+    for(uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = file.data() + offset + stride * (topDown ? y : height - 1 - y);
+        for(uint32_t x = 0; x < width; ++x, row += bpp / 8)
+            pixels[(size_t)y * width + x] = 0xFF000000 | (uint32_t)row[2] << 16 | (uint32_t)row[1] << 8 | row[0];
+    }
+    return true;
+}
+bool LoadGameSprites(FieldRenderer& renderer, const std::string& dir)
+{
+    constexpr uint32_t SnakeImgCnt = 9;
+    constexpr uint32_t KeyColor = 0xFFFFFF;
+    std::vector<uint8_t> snakeFile, foodFile;
+    std::vector<uint32_t> snake, food;
+    uint32_t snakeWidth, snakeHeight, foodWidth, foodHeight;
+    if(!ReadFile(dir + "/snake_imgs.bmp", snakeFile) || !ReadBmp(snakeFile, snake, snakeWidth, snakeHeight) ||
+       !ReadFile(dir + "/food.bmp", foodFile) || !ReadBmp(foodFile, food, foodWidth, foodHeight) || snakeWidth < SnakeImgCnt)
+        return false;
+
+    uint32_t imgWidth = snakeWidth / SnakeImgCnt;
+    for(uint32_t i = 0; i < SnakeImgCnt; ++i)
+        renderer.SetTile(i, snake.data() + i * imgWidth, imgWidth, snakeHeight, snakeWidth, KeyColor);
+    renderer.SetTile(FieldRenderer::FoodTile, food.data(), foodWidth, foodHeight, foodWidth, KeyColor);
+    return true;
+}
+
+// VideoExporter class methods ------------------------------------------------------------------------------------------------
+VideoExporter::VideoExporter(uint32_t cellSize, uint32_t maxView, uint32_t poolFrames)
+    : renderer(cellSize, 0xFFC0C0C0), maxView(maxView), poolFrames(std::max(poolFrames, 1u))
+{
+}
+bool VideoExporter::Export(const Replay& replay, FILE* out, VideoFormat format, uint32_t fps, VideoStats& stats)
+{
+    uint32_t viewWidth = std::min(replay.Width(), maxView), viewHeight = std::min(replay.Height(), maxView);
+    renderer.SetView(viewWidth, viewHeight);
+    renderer.Invalidate();
+    uint32_t width = renderer.PixelWidth(), height = renderer.PixelHeight();
+    size_t pixelCount = (size_t)width * height;
+    size_t frameBytes = (format == VideoFormat::Y4M) ? pixelCount + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2) : 3 * pixelCount;
+
+    stats = VideoStats();
+    stats.width = width;
+    stats.height = height;
+
+    // Tick to tick only a few cells change, so the render stage passes on just the rectangles the renderer
+    // repainted and the convert stage keeps the whole picture and its encoding, bringing both up to date with
+    // those rectangles before it copies the encoding out. Changes go render -> convert and back through
+    // freeChanges, encoded frames convert -> write and back through freeFrames. Every queue holds a whole pool,
+    // so returning a buffer never waits.
+    struct Changes
+    {
+        std::vector<PixelRect> rects;
+        std::vector<uint32_t> pixels;  // pixels of the rectangles one after another, rows top first
+    };
+    std::vector<Changes> changes(poolFrames);
+    std::vector<std::vector<uint8_t>> frames(poolFrames, std::vector<uint8_t>(frameBytes));
+    BoundedQueue<Changes*> freeChanges(poolFrames), rendered(poolFrames);
+    BoundedQueue<std::vector<uint8_t>*> freeFrames(poolFrames), converted(poolFrames);
+    for(uint32_t i = 0; i < poolFrames; ++i)
+    {
+        changes[i].pixels.reserve(pixelCount);
+        freeChanges.Push(&changes[i]);
+        freeFrames.Push(&frames[i]);
+    }
+    std::atomic<bool> failed(false);
+    auto start = Clock::now();
+
+    std::thread renderThread([&]
+    {
+        Game game;
+        ReplayPlayer player(replay);
+        player.Start(game);
+        for(;;)
+        {
+            Changes* change = nullptr;
+            if(!freeChanges.Pop(change) || failed)
+                break;
+            auto busy = Clock::now();
+            renderer.Update(game, ViewOrigin(game, viewWidth, viewHeight), true);
+            change->rects = renderer.Dirty();
+            change->pixels.clear();
+            for(const PixelRect& rect : change->rects)
+                for(uint32_t y = rect.top; y < rect.bottom; ++y)
+                {
+                    const uint32_t* row = renderer.Pixels() + (size_t)y * width;
+                    change->pixels.insert(change->pixels.end(), row + rect.left, row + rect.right);
+                }
+            renderer.ClearDirty();
+            bool last = player.AtEnd();
+            if(!last)
+                player.Step(game);
+            stats.renderSeconds += Since(busy);
+            rendered.Push(change);
+            if(last)
+                break;
+        }
+        rendered.Close();
+    });
+    std::thread convertThread([&]
+    {
+        std::vector<uint32_t> picture(pixelCount);
+        std::vector<uint8_t> encoded(frameBytes);
+        for(Changes* change = nullptr; rendered.Pop(change); )
+        {
+            std::vector<uint8_t>* frame = nullptr;
+            freeFrames.Pop(frame);
+            auto busy = Clock::now();
+            const uint32_t* src = change->pixels.data();
+            for(const PixelRect& rect : change->rects)
+            {
+                uint32_t rectWidth = rect.right - rect.left;
+                for(uint32_t y = rect.top; y < rect.bottom; ++y, src += rectWidth)
+                    std::copy(src, src + rectWidth, &picture[(size_t)y * width + rect.left]);
+                if(format == VideoFormat::Y4M)
+                    ToYuv420(picture.data(), width, height, rect, encoded.data());
+                else
+                    ToRgb(picture.data(), width, rect, encoded.data());
+            }
+            std::copy(encoded.begin(), encoded.end(), frame->begin());
+            stats.convertSeconds += Since(busy);
+            freeChanges.Push(change);
+            converted.Push(frame);
+        }
+        converted.Close();
+    });
+
+    // Writing stays on this thread. After a failed write it keeps taking frames so the other stages can finish.
+    char header[64];
+    if(format == VideoFormat::Y4M)
+    {
+        int n = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps);
+        failed = fwrite(header, 1, n, out) != (size_t)n;
+        stats.bytes += n;
+    }
+    for(std::vector<uint8_t>* frame; converted.Pop(frame); )
+    {
+        if(!failed)
+        {
+            auto busy = Clock::now();
+            int n = (format == VideoFormat::Y4M) ? snprintf(header, sizeof(header), "FRAME\n") :
+                                                   snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+            failed = fwrite(header, 1, n, out) != (size_t)n || fwrite(frame->data(), 1, frame->size(), out) != frame->size();
+            stats.bytes += n + frame->size();
+            ++stats.frames;
+            stats.writeSeconds += Since(busy);
+        }
+        freeFrames.Push(frame);
+    }
+    if(!failed)
+        failed = fflush(out) != 0;
+
+    // A failure can leave the render thread waiting for changes the converter will never return
+    freeChanges.Close();
+    renderThread.join();
+    convertThread.join();
+    stats.seconds = Since(start);
+    return !failed;
+}
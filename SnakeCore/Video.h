@@ -0,0 +1,62 @@
+#pragma once
+
+// Offline export of a replay to raw video. The replay is re-simulated and every tick becomes one frame drawn by
+// FieldRenderer with the game's sprites, through a view that follows the head as the game window does.
+//
+// The work runs as three stages on their own threads, each handing on to the next through a BoundedQueue:
+// rendering (simulate a tick, update the field, pick out the cells it repainted), encoding (patch those cells into
+// the picture and its planar YUV 4:2:0 or packed RGB encoding, copy the encoding into a frame) and writing. A tick
+// changes a handful of cells, so only they are converted. Buffers come from fixed pools that travel around the
+// pipeline, nothing is allocated per frame and at most a pool's worth of frames is in flight.
+//
+// Y4M is a YUV4MPEG2 stream with BT.601 limited range colors. PPM is a sequence of binary P6 images one after
+// another, as ffmpeg reads with -f image2pipe.
+
+#include "SnakeCore.h"
+#include "Replay.h"
+#include "Render.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class VideoFormat { Y4M, PPM };
+
+struct VideoStats
+{
+    uint32_t width = 0;    // frame size in pixels
+    uint32_t height = 0;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    // Time each stage spent working rather than waiting on its queues
+    double renderSeconds = 0;
+    double convertSeconds = 0;
+    double writeSeconds = 0;
+};
+
+// Decodes an uncompressed 24 or 32 bpp Windows bitmap into opaque 0xAARRGGBB pixels, top row first
+bool ReadBmp(const std::vector<uint8_t>& file, std::vector<uint32_t>& pixels, uint32_t& width, uint32_t& height);
+// Replaces the renderer's sprites with snake_imgs.bmp and food.bmp from dir, the images of the game, white
+// transparent. False if either can't be read, the renderer keeps its built-in sprites then.
+bool LoadGameSprites(FieldRenderer& renderer, const std::string& dir);
+
+class VideoExporter
+{
+public:
+    // Cells are cellSize pixels, the view at most maxView x maxView cells. Each pool holds poolFrames frames.
+    VideoExporter(uint32_t cellSize = 24, uint32_t maxView = 32, uint32_t poolFrames = 8);
+
+    // Sprites and background of the frames
+    FieldRenderer& Renderer();
+
+    // Writes the start of the game and one frame after every tick, fps frames per second. False on a write error.
+    bool Export(const Replay& replay, FILE* out, VideoFormat format, uint32_t fps, VideoStats& stats);
+
+private:
+    FieldRenderer renderer;
+    uint32_t maxView;
+    uint32_t poolFrames;
+};
+
+// VideoExporter class methods ------------------------------------------------------------------------------------------------
+inline FieldRenderer& VideoExporter::Renderer() { return renderer; }
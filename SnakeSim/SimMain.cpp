@@ -0,0 +1,599 @@
+// Headless batch simulator: plays many games with a built-in policy on all cores and reports throughput
+// and score/length distributions per board size.
+//
+// SnakeSim [-n games] [-b WxH[,WxH...]] [-p random|greedy|wall|autopilot|mcts] [-t threads] [-s seed] [-i idleTicks] [-l 1] [-v batch]
+//          [-w replayPrefix] [-f forks] [-m ms]
+// SnakeSim -r replayFile
+// SnakeSim -e video.y4m|video.ppm [-r replayFile | -b WxH -p policy -s seed -i idleTicks]
+//
+// -l 1 times every policy decision and reports the decision latency distribution.
+// -v K plays on one BatchEnv of K games with random turns instead, until n games have ended, and reports the step time.
+// -w P saves the replay of the best game of every board to P-WxH.replay.
+// -r F re-simulates a saved replay, prints how the game ended and how long re-simulating it takes.
+// -f K forks every state of n games K times (snapshot, then restore into another game) and reports forks per second.
+// -m T plays n games per board with the MCTS player given T ms per move, once for every power of two threads up to
+//      the -t count (all cores by default), and reports rollouts per second and the transposition table hit rate.
+// -e V exports a game to raw video V at 30 frames per second, one frame per tick: YUV4MPEG2 unless V ends in .ppm,
+//      then a stream of binary PPM images. The game is the replay given with -r, or else one game played with -p on the
+//      first -b board. Reports the frame rate of the export and how busy each pipeline stage was.
+
+#include "../SnakeCore/SnakeCore.h"
+#include "../SnakeCore/Policies.h"
+#include "../SnakeCore/TaskPool.h"
+#include "../SnakeCore/BatchEnv.h"
+#include "../SnakeCore/Replay.h"
+#include "../SnakeCore/Mcts.h"
+#include "../SnakeCore/Video.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+    constexpr uint32_t GamesPerTask = 256;
+
+    struct Options
+    {
+        uint64_t games = 10000;
+        std::vector<std::pair<uint32_t, uint32_t>> boards = { { 8, 8 }, { 16, 16 }, { 32, 32 } };
+        std::string policy = "greedy";
+        uint32_t threads = 0;
+        uint64_t seed = 1;
+        uint32_t idleTicks = 0; // a game with no food eaten for this many ticks counts as starved, 0 - 4 * width * height
+        bool timeDecisions = false;
+        uint32_t batch = 0; // games per BatchEnv, 0 - play Game objects with the policy
+        std::string replayPrefix; // where to save the best replays, empty - don't record
+        std::string replayFile;   // replay to play back instead of simulating
+        uint32_t forks = 0;       // forks per tick in the fork benchmark, 0 - no benchmark
+        uint32_t mctsMs = 0;      // time per move in the MCTS scaling run, 0 - no such run
+        std::string videoFile;    // where to export a game as video, empty - no export
+    };
+
+    constexpr uint32_t LatencyBucketNs = 100;
+    constexpr uint32_t LatencyBuckets = 10000; // last bucket collects everything from 1 ms up
+
+    enum Outcome { Died, Won, Starved, OutcomeCount };
+
+    struct BoardStats
+    {
+        uint64_t games = 0;
+        uint64_t ticks = 0;
+        uint64_t outcomes[OutcomeCount] = {};
+        std::vector<uint64_t> scoreHist;   // number of games per final score, grown to the largest score seen
+        std::vector<uint64_t> lengthHist;  // number of games per final length, grown to the largest length seen
+        std::vector<uint64_t> decisionHist; // number of policy decisions per LatencyBucketNs of decision time
+        uint64_t decisionNs = 0;
+        uint64_t maxDecisionNs = 0;
+        Replay best;               // highest scoring game, the one with the lowest index on a tie
+        uint64_t bestGame = std::numeric_limits<uint64_t>::max();
+        uint32_t bestScore = 0;
+
+        BoardStats() : decisionHist(LatencyBuckets) {}
+        static void Add(std::vector<uint64_t>& hist, uint32_t value)
+        {
+            if(value >= hist.size())
+                hist.resize(value + 1);
+            ++hist[value];
+        }
+        static void Merge(std::vector<uint64_t>& hist, const std::vector<uint64_t>& right)
+        {
+            if(right.size() > hist.size())
+                hist.resize(right.size());
+            for(size_t i = 0; i < right.size(); ++i)
+                hist[i] += right[i];
+        }
+        void Merge(const BoardStats& right)
+        {
+            games += right.games;
+            ticks += right.ticks;
+            for(int i = 0; i < OutcomeCount; ++i)
+                outcomes[i] += right.outcomes[i];
+            Merge(scoreHist, right.scoreHist);
+            Merge(lengthHist, right.lengthHist);
+            for(size_t i = 0; i < decisionHist.size(); ++i)
+                decisionHist[i] += right.decisionHist[i];
+            decisionNs += right.decisionNs;
+            maxDecisionNs = std::max(maxDecisionNs, right.maxDecisionNs);
+            Offer(right.best, right.bestGame, right.bestScore);
+        }
+        void Offer(const Replay& replay, uint64_t game, uint32_t score)
+        {
+            if(score > bestScore || (score == bestScore && game < bestGame))
+            {
+                best = replay;
+                bestGame = game;
+                bestScore = score;
+            }
+        }
+    };
+
+    void PrintUsage()
+    {
+        printf("usage: SnakeSim [-n games] [-b WxH[,WxH...]] [-p random|greedy|wall|autopilot|mcts] [-t threads] [-s seed] [-i idleTicks] [-l 1] [-v batch]\n"
+               "                [-w replayPrefix] [-f forks] [-m ms]\n"
+               "       SnakeSim -r replayFile\n"
+               "       SnakeSim -e video.y4m|video.ppm [-r replayFile | -b WxH -p policy -s seed -i idleTicks]\n");
+    }
+
+    bool ParseBoards(const char* arg, std::vector<std::pair<uint32_t, uint32_t>>& boards)
+    {
+        boards.clear();
+        while(*arg)
+        {
+            unsigned w = 0, h = 0;
+            int n = 0;
+            if(sscanf(arg, "%ux%u%n", &w, &h, &n) != 2 || w < MinWidth || w > MaxWidth || h < MinHeight || h > MaxHeight)
+                return false;
+            boards.emplace_back(w, h);
+            arg += n;
+            if(*arg == ',')
+                ++arg;
+        }
+        return !boards.empty();
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& opt)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            const char* arg = argv[i];
+            const char* val = (i + 1 < argc) ? argv[i + 1] : nullptr;
+            if(!val || arg[0] != '-' || arg[1] == 0 || arg[2] != 0)
+                return false;
+            switch(arg[1])
+            {
+                case 'n': opt.games = strtoull(val, nullptr, 10); break;
+                case 'b': if(!ParseBoards(val, opt.boards)) return false; break;
+                case 'p': opt.policy = val; break;
+                case 't': opt.threads = (uint32_t)strtoul(val, nullptr, 10); break;
+                case 's': opt.seed = strtoull(val, nullptr, 10); break;
+                case 'i': opt.idleTicks = (uint32_t)strtoul(val, nullptr, 10); break;
+                case 'l': opt.timeDecisions = strtoul(val, nullptr, 10) != 0; break;
+                case 'v': opt.batch = (uint32_t)strtoul(val, nullptr, 10); break;
+                case 'w': opt.replayPrefix = val; break;
+                case 'r': opt.replayFile = val; break;
+                case 'f': opt.forks = (uint32_t)strtoul(val, nullptr, 10); break;
+                case 'm': opt.mctsMs = (uint32_t)strtoul(val, nullptr, 10); break;
+                case 'e': opt.videoFile = val; break;
+                default: return false;
+            }
+            ++i;
+        }
+        return opt.games != 0;
+    }
+
+    // Plays games [first, first + count) of one board, game i always gets the same seed whichever worker runs it
+    void PlayGames(const Options& opt, uint32_t width, uint32_t height, uint64_t first, uint64_t count, BoardStats& stats)
+    {
+        uint32_t idleLimit = opt.idleTicks ? opt.idleTicks : 4 * width * height;
+        bool record = !opt.replayPrefix.empty();
+        Game game;
+        Replay replay;
+        for(uint64_t i = first; i < first + count; ++i)
+        {
+            uint64_t gameSeed = RandGen(opt.seed, i).Next64();
+            auto policy = CreatePolicy(opt.policy.c_str(), gameSeed);
+            game.Reset(width, height, gameSeed);
+            if(record)
+                replay.Begin(game);
+
+            Outcome outcome = Starved;
+            uint32_t lastMeal = 0;
+            while(game.Ticks() - lastMeal < idleLimit)
+            {
+                if(opt.timeDecisions)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    Snake::Direction d = policy->Decide(game);
+                    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                    game.GetSnake().SetDirection(d);
+                    ++stats.decisionHist[std::min<uint64_t>(ns / LatencyBucketNs, LatencyBuckets - 1)];
+                    stats.decisionNs += ns;
+                    stats.maxDecisionNs = std::max(stats.maxDecisionNs, ns);
+                }
+                else
+                    game.GetSnake().SetDirection(policy->Decide(game));
+                if(record)
+                    replay.Record(game.GetSnake().GetDirection());
+                Game::StepResult res = game.Step();
+                if(res == Game::Died || res == Game::Won)
+                {
+                    outcome = (res == Game::Died) ? Died : Won;
+                    break;
+                }
+                if(res == Game::Ate)
+                    lastMeal = game.Ticks();
+            }
+
+            ++stats.games;
+            stats.ticks += game.Ticks();
+            ++stats.outcomes[outcome];
+            BoardStats::Add(stats.scoreHist, game.Score());
+            BoardStats::Add(stats.lengthHist, game.GetSnake().BodySize());
+            if(record)
+                stats.Offer(replay, i, game.Score());
+        }
+    }
+
+    // Steps a BatchEnv with random turns (never reversing) until opt.games games have ended.
+    // The turns are random, so every game ends soon and no starvation limit is applied.
+    void PlayBatch(const Options& opt, uint32_t width, uint32_t height, BoardStats& stats, double& stepSeconds, uint64_t& steps)
+    {
+        BatchEnv env(opt.batch, width, height, opt.seed);
+        RandGen turns(opt.seed, opt.batch);
+        std::vector<Snake::Direction> actions(opt.batch);
+        std::vector<Game::StepResult> results(opt.batch);
+
+        stepSeconds = 0;
+        steps = 0;
+        while(stats.games < opt.games)
+        {
+            for(uint32_t i = 0; i < opt.batch; ++i)
+            {
+                uint32_t d = env.GetDirection(i), r = turns.Below(3);
+                actions[i] = (Snake::Direction)(r == 0 ? d : ((d & 2) ^ 2) | (r - 1));
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            env.Step(actions.data(), results.data());
+            stepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ++steps;
+
+            for(uint32_t i = 0; i < opt.batch; ++i)
+            {
+                if(results[i] != Game::Died && results[i] != Game::Won)
+                    continue;
+                ++stats.games;
+                stats.ticks += env.FinalTicks(i);
+                ++stats.outcomes[results[i] == Game::Died ? Died : Won];
+                BoardStats::Add(stats.scoreHist, env.FinalScore(i));
+                BoardStats::Add(stats.lengthHist, env.FinalBodySize(i));
+            }
+        }
+    }
+
+    // Plays games with the policy and forks every state opt.forks times into a second game. Only the forks are timed;
+    // after them the fork takes the same move as the original and both must end up with the same result.
+    void ForkStates(const Options& opt, uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> storage(Game::MaxSnapshotSize(width, height));
+        Game game, fork;
+        uint64_t forks = 0, bytes = 0, mismatches = 0;
+        double seconds = 0;
+        for(uint64_t i = 0; i < opt.games; ++i)
+        {
+            uint64_t gameSeed = RandGen(opt.seed, i).Next64();
+            auto policy = CreatePolicy(opt.policy.c_str(), gameSeed);
+            game.Reset(width, height, gameSeed);
+            for(;;)
+            {
+                auto start = std::chrono::steady_clock::now();
+                for(uint32_t k = 0; k < opt.forks; ++k)
+                {
+                    bytes += game.Snapshot(storage.data());
+                    fork.Restore(storage.data());
+                }
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                forks += opt.forks;
+
+                Snake::Direction d = policy->Decide(game);
+                game.GetSnake().SetDirection(d);
+                fork.GetSnake().SetDirection(d);
+                Game::StepResult res = game.Step();
+                if(fork.Step() != res || fork.GetFood() != game.GetFood() || fork.Score() != game.Score())
+                    ++mismatches;
+                if(res == Game::Died || res == Game::Won || game.Ticks() >= 4 * width * height)
+                    break;
+            }
+        }
+        printf("\nboard %ux%u\n", width, height);
+        printf("  forks %" PRIu64 "  forks/s %.0f  ns/fork %.1f  bytes/snapshot %.1f  mismatches %" PRIu64 "\n",
+            forks, forks / seconds, seconds * 1e9 / forks, (double)bytes / forks, mismatches);
+    }
+
+    // Plays opt.games games with an MCTS player of nThreads threads and opt.mctsMs per move. The search gets the
+    // same time with any number of threads, so rollouts per second show how it scales.
+    void MctsScaling(const Options& opt, uint32_t width, uint32_t height, uint32_t nThreads)
+    {
+        uint32_t idleLimit = opt.idleTicks ? opt.idleTicks : 4 * width * height;
+        MctsPolicy mcts(opt.seed, nThreads);
+        mcts.SetBudget(opt.mctsMs / 1000.0);
+        Game game;
+        uint64_t scores = 0, ticks = 0;
+        for(uint64_t i = 0; i < opt.games; ++i)
+        {
+            game.Reset(width, height, RandGen(opt.seed, i).Next64());
+            mcts.Reset();
+            for(uint32_t lastMeal = 0; game.Ticks() - lastMeal < idleLimit; )
+            {
+                game.GetSnake().SetDirection(mcts.Decide(game));
+                Game::StepResult res = game.Step();
+                if(res == Game::Died || res == Game::Won)
+                    break;
+                if(res == Game::Ate)
+                    lastMeal = game.Ticks();
+            }
+            scores += game.Score();
+            ticks += game.Ticks();
+        }
+        double rate = mcts.Rollouts() / mcts.SearchSeconds();
+        printf("  threads %2u  rollouts/s %10.0f  per thread %9.0f  table hits %5.1f%%  mean score %.2f  ticks/game %.1f\n",
+            nThreads, rate, rate / nThreads, 100.0 * mcts.TableHits() / std::max<uint64_t>(1, mcts.TableLookups()),
+            (double)scores / opt.games, (double)ticks / opt.games);
+    }
+
+    bool SaveReplay(const std::string& fileName, const Replay& replay)
+    {
+        std::vector<uint8_t> data;
+        replay.Write(data);
+        FILE* file = fopen(fileName.c_str(), "wb");
+        if(!file)
+            return false;
+        bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    bool LoadReplay(const std::string& fileName, Replay& replay, size_t& size)
+    {
+        std::vector<uint8_t> data;
+        FILE* file = fopen(fileName.c_str(), "rb");
+        if(file)
+        {
+            uint8_t buf[4096];
+            for(size_t n; (n = fread(buf, 1, sizeof(buf), file)) != 0; )
+                data.insert(data.end(), buf, buf + n);
+            fclose(file);
+        }
+        size = data.size();
+        if(!file || !replay.Read(data.data(), data.size()))
+        {
+            fprintf(stderr, "can't read replay %s\n", fileName.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    int PlayReplayFile(const std::string& fileName)
+    {
+        Replay replay;
+        size_t size;
+        if(!LoadReplay(fileName, replay, size))
+            return 1;
+
+        Game game;
+        ReplayPlayer player(replay);
+        player.Start(game);
+        Game::StepResult res = player.FastForward(game);
+        const char* resNames[] = { "moved", "ate", "died", "won" };
+        printf("replay %s  %zu bytes  rules %u  seed %" PRIu64 "  board %ux%u  ticks %u\n", fileName.c_str(), size,
+            replay.Version(), replay.Seed(), replay.Width(), replay.Height(), replay.Ticks());
+        printf("  last tick %s  score %u  length %u\n", resNames[res], game.Score(), game.GetSnake().BodySize());
+
+        // Re-simulate for a fraction of a second to time it
+        uint64_t runs = 0;
+        auto start = std::chrono::steady_clock::now();
+        double seconds = 0;
+        for(; seconds < 0.2; seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), ++runs)
+        {
+            player.Start(game);
+            player.FastForward(game);
+        }
+        printf("  re-simulation us %.2f  ticks/s %.0f\n", seconds * 1e6 / runs, (double)replay.Ticks() * runs / seconds);
+        return 0;
+    }
+
+    int ExportVideo(const Options& opt)
+    {
+        Replay replay;
+        size_t size;
+        if(!opt.replayFile.empty())
+        {
+            if(!LoadReplay(opt.replayFile, replay, size))
+                return 1;
+        }
+        else
+        {
+            // Same game as game 0 of the first board in a simulation run
+            uint32_t width = opt.boards[0].first, height = opt.boards[0].second;
+            uint32_t idleLimit = opt.idleTicks ? opt.idleTicks : 4 * width * height;
+            uint64_t gameSeed = RandGen(opt.seed, 0).Next64();
+            auto policy = CreatePolicy(opt.policy.c_str(), gameSeed);
+            Game game;
+            game.Reset(width, height, gameSeed);
+            replay.Begin(game);
+            for(uint32_t lastMeal = 0; game.Ticks() - lastMeal < idleLimit; )
+            {
+                game.GetSnake().SetDirection(policy->Decide(game));
+                replay.Record(game.GetSnake().GetDirection());
+                Game::StepResult res = game.Step();
+                if(res == Game::Died || res == Game::Won)
+                    break;
+                if(res == Game::Ate)
+                    lastMeal = game.Ticks();
+            }
+        }
+
+        const std::string& fileName = opt.videoFile;
+        bool ppm = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".ppm") == 0;
+        FILE* file = fopen(fileName.c_str(), "wb");
+        if(!file)
+        {
+            fprintf(stderr, "can't create %s\n", fileName.c_str());
+            return 1;
+        }
+        VideoExporter exporter;
+        if(!LoadGameSprites(exporter.Renderer(), SNAKE_IMAGES_DIR))
+            fprintf(stderr, "can't load the game images from %s, using plain sprites\n", SNAKE_IMAGES_DIR);
+        VideoStats stats;
+        bool ok = exporter.Export(replay, file, ppm ? VideoFormat::PPM : VideoFormat::Y4M, 30, stats);
+        ok = fclose(file) == 0 && ok;
+        if(!ok)
+        {
+            fprintf(stderr, "can't write %s\n", fileName.c_str());
+            return 1;
+        }
+
+        printf("video %s  %s %ux%u  board %ux%u  ticks %u  seed %" PRIu64 "\n", fileName.c_str(), ppm ? "ppm" : "y4m",
+            stats.width, stats.height, replay.Width(), replay.Height(), replay.Ticks(), replay.Seed());
+        printf("  frames %" PRIu64 "  MB %.1f  seconds %.2f  frames/s %.0f  MB/s %.0f\n", stats.frames, stats.bytes / 1e6,
+            stats.seconds, stats.frames / stats.seconds, stats.bytes / 1e6 / stats.seconds);
+        printf("  busy seconds  render %.2f  convert %.2f  write %.2f\n", stats.renderSeconds, stats.convertSeconds, stats.writeSeconds);
+        return 0;
+    }
+
+    uint32_t Percentile(const std::vector<uint64_t>& hist, uint64_t total, double p)
+    {
+        uint64_t target = (uint64_t)(p * (total - 1));
+        uint64_t seen = 0;
+        for(uint32_t v = 0; v < hist.size(); ++v)
+        {
+            seen += hist[v];
+            if(seen > target)
+                return v;
+        }
+        return (uint32_t)hist.size() - 1;
+    }
+
+    void PrintDistribution(const char* name, const std::vector<uint64_t>& hist, uint64_t total)
+    {
+        uint32_t minVal = (uint32_t)hist.size(), maxVal = 0;
+        double sum = 0;
+        for(uint32_t v = 0; v < hist.size(); ++v)
+            if(hist[v])
+            {
+                minVal = std::min(minVal, v);
+                maxVal = v;
+                sum += (double)v * hist[v];
+            }
+
+        printf("  %-7s min %u  mean %.2f  p50 %u  p90 %u  p99 %u  max %u\n", name, minVal, sum / total,
+            Percentile(hist, total, 0.5), Percentile(hist, total, 0.9), Percentile(hist, total, 0.99), maxVal);
+
+        // Ten equal-width buckets over [min, max]
+        constexpr uint32_t nBuckets = 10;
+        uint32_t bucketWidth = std::max(1u, (maxVal - minVal + nBuckets) / nBuckets);
+        uint64_t buckets[nBuckets] = {};
+        for(uint32_t v = minVal; v <= maxVal; ++v)
+            buckets[std::min(nBuckets - 1, (v - minVal) / bucketWidth)] += hist[v];
+        uint64_t peak = *std::max_element(std::begin(buckets), std::end(buckets));
+        for(uint32_t b = 0; b < nBuckets && minVal + b * bucketWidth <= maxVal; ++b)
+        {
+            uint32_t lo = minVal + b * bucketWidth;
+            int bar = peak ? (int)(40 * buckets[b] / peak) : 0;
+            printf("    [%4u, %4u) %10" PRIu64 " %.*s\n", lo, lo + bucketWidth, buckets[b], bar, "########################################");
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if(!ParseOptions(argc, argv, opt) || !CreatePolicy(opt.policy.c_str(), 0))
+    {
+        PrintUsage();
+        return 1;
+    }
+    if(!opt.videoFile.empty())
+        return ExportVideo(opt);
+    if(!opt.replayFile.empty())
+        return PlayReplayFile(opt.replayFile);
+
+    if(opt.forks)
+    {
+        printf("fork benchmark  policy %s  games per board %" PRIu64 "  forks per tick %u\n", opt.policy.c_str(), opt.games, opt.forks);
+        for(const auto& board : opt.boards)
+            ForkStates(opt, board.first, board.second);
+        return 0;
+    }
+    if(opt.mctsMs)
+    {
+        uint32_t maxThreads = opt.threads ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+        printf("MCTS scaling  %u ms per move  games per board %" PRIu64 "  seed %" PRIu64 "\n", opt.mctsMs, opt.games, opt.seed);
+        for(const auto& board : opt.boards)
+        {
+            printf("\nboard %ux%u\n", board.first, board.second);
+            for(uint32_t n = 1; ; n = std::min(2 * n, maxThreads))
+            {
+                MctsScaling(opt, board.first, board.second, n);
+                if(n == maxThreads)
+                    break;
+            }
+        }
+        return 0;
+    }
+    if(opt.batch)
+    {
+        printf("batch of %u games with random turns  games per board %" PRIu64 "  seed %" PRIu64 "\n", opt.batch, opt.games, opt.seed);
+        for(const auto& board : opt.boards)
+        {
+            uint32_t width = board.first, height = board.second;
+            BoardStats total;
+            double stepSeconds = 0;
+            uint64_t steps = 0;
+            PlayBatch(opt, width, height, total, stepSeconds, steps);
+
+            printf("\nboard %ux%u\n", width, height);
+            printf("  steps %" PRIu64 "  us/step %.2f  ticks/s %.0f  ticks/game %.1f\n", steps, stepSeconds * 1e6 / steps,
+                (double)steps * opt.batch / stepSeconds, (double)total.ticks / total.games);
+            printf("  outcome died %" PRIu64 "  won %" PRIu64 "\n", total.outcomes[Died], total.outcomes[Won]);
+            PrintDistribution("score", total.scoreHist, total.games);
+            PrintDistribution("length", total.lengthHist, total.games);
+        }
+        return 0;
+    }
+
+    TaskPool pool(opt.threads);
+    printf("policy %s  games per board %" PRIu64 "  threads %u  seed %" PRIu64 "\n", opt.policy.c_str(), opt.games, pool.Size(), opt.seed);
+
+    for(const auto& board : opt.boards)
+    {
+        uint32_t width = board.first, height = board.second;
+        BoardStats total;
+        std::mutex totalLock;
+
+        auto start = std::chrono::steady_clock::now();
+        for(uint64_t first = 0; first < opt.games; first += GamesPerTask)
+        {
+            uint64_t count = std::min<uint64_t>(GamesPerTask, opt.games - first);
+            pool.Submit([&, first, count](uint32_t)
+            {
+                BoardStats stats;
+                PlayGames(opt, width, height, first, count, stats);
+                std::lock_guard<std::mutex> guard(totalLock);
+                total.Merge(stats);
+            });
+        }
+        pool.Wait();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("\nboard %ux%u\n", width, height);
+        printf("  time %.3f s  games/s %.0f  ticks/s %.0f  ticks/game %.1f\n", seconds,
+            total.games / seconds, total.ticks / seconds, (double)total.ticks / total.games);
+        printf("  outcome died %" PRIu64 "  won %" PRIu64 "  starved %" PRIu64 "\n",
+            total.outcomes[Died], total.outcomes[Won], total.outcomes[Starved]);
+        PrintDistribution("score", total.scoreHist, total.games);
+        PrintDistribution("length", total.lengthHist, total.games);
+        if(opt.timeDecisions)
+        {
+            auto toUs = [](uint32_t bucket) { return (bucket + 1) * LatencyBucketNs / 1000.0; };
+            printf("  decision us  mean %.2f  p50 <%.1f  p99 <%.1f  p99.9 <%.1f  max %.1f\n", total.decisionNs / 1000.0 / total.ticks,
+                toUs(Percentile(total.decisionHist, total.ticks, 0.5)), toUs(Percentile(total.decisionHist, total.ticks, 0.99)),
+                toUs(Percentile(total.decisionHist, total.ticks, 0.999)), total.maxDecisionNs / 1000.0);
+        }
+        if(!opt.replayPrefix.empty())
+        {
+            std::string fileName = opt.replayPrefix + "-" + std::to_string(width) + "x" + std::to_string(height) + ".replay";
+            if(SaveReplay(fileName, total.best))
+                printf("  best game %" PRIu64 " score %u saved to %s\n", total.bestGame, total.bestScore, fileName.c_str());
+            else
+                fprintf(stderr, "can't write %s\n", fileName.c_str());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,516 @@
+// Terminal frontend for POSIX systems: the same game as the window version drawn with ANSI escape codes.
+// The screen keeps what it last showed of every visible cell and each tick sends only the cells whose content
+// changed, so a tick normally costs a few dozen bytes and the game stays smooth over a slow SSH link.
+//
+// SnakeTerm [-b WxH] [-s seed] [-t tickMs] [-a 1] [-m port] [-o file] [-T file]
+//
+// Arrows or HJKL turn, P pauses, N starts a new game, A switches the autopilot, Q quits, as in the window game.
+// -a 1 starts with the autopilot on. Fields larger than the terminal scroll to follow the head.
+// On exit the number of bytes sent to the terminal is printed, and how far ticks fell behind their schedule.
+// Ticks, drawing and key presses are timed into latency histograms all along: -m serves them as plain text on
+// 127.0.0.1:port while the game runs, -o writes them to file on exit, as JSON if its name ends in .json.
+// -T traces ticks, drawing and key reading and writes the spans to file on exit as Chrome trace-event JSON.
+
+#include "../SnakeCore/SnakeCore.h"
+#include "../SnakeCore/Policies.h"
+#include "../SnakeCore/Scheduler.h"
+#include "../SnakeCore/Input.h"
+#include "../SnakeCore/Metrics.h"
+#include "../SnakeCore/MetricsServer.h"
+#include "../SnakeCore/Trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <csignal>
+#include <cerrno>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+namespace
+{
+    struct Options
+    {
+        uint32_t width = 24;
+        uint32_t height = 16;
+        uint64_t seed = 0;      // 0 - from the clock
+        uint32_t tickMs = 120;
+        bool autopilot = false;
+        uint16_t metricsPort = 0;  // 0 - no endpoint
+        std::string metricsFile;
+        std::string traceFile;     // empty - no tracing
+    };
+
+    enum CellKind : uint8_t { EmptyCell, BodyCell, HeadCell, FoodCell, UnknownCell };
+
+    // Every cell is two characters wide so it looks square; the content is the background colour
+    const char* const CellColors[] = { "\x1b[0m", "\x1b[42m", "\x1b[102m", "\x1b[41m" };
+
+    const char EnterScreen[] = "\x1b[?1049h\x1b[?25l\x1b[2J";
+    const char LeaveScreen[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+    volatile sig_atomic_t quitSignal = 0;
+    volatile sig_atomic_t resized = 0;
+
+    void OnQuitSignal(int) { quitSignal = 1; }
+    void OnResize(int) { resized = 1; }
+
+    void PrintUsage()
+    {
+        printf("usage: SnakeTerm [-b WxH] [-s seed] [-t tickMs] [-a 1] [-m port] [-o file] [-T file]\n");
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& opt)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            const char* arg = argv[i];
+            const char* val = (i + 1 < argc) ? argv[i + 1] : nullptr;
+            if(!val || arg[0] != '-' || arg[1] == 0 || arg[2] != 0)
+                return false;
+            switch(arg[1])
+            {
+                case 'b':
+                    if(sscanf(val, "%ux%u", &opt.width, &opt.height) != 2 || opt.width < MinWidth || opt.width > MaxWidth
+                        || opt.height < MinHeight || opt.height > MaxHeight)
+                        return false;
+                    break;
+                case 's': opt.seed = strtoull(val, nullptr, 10); break;
+                case 't': opt.tickMs = (uint32_t)strtoul(val, nullptr, 10); break;
+                case 'a': opt.autopilot = strtoul(val, nullptr, 10) != 0; break;
+                case 'm': opt.metricsPort = (uint16_t)strtoul(val, nullptr, 10); break;
+                case 'o': opt.metricsFile = val; break;
+                case 'T': opt.traceFile = val; break;
+                default: return false;
+            }
+            ++i;
+        }
+        return opt.tickMs != 0;
+    }
+
+    // Raw keyboard input for as long as the object lives, the previous mode comes back on destruction
+    class RawMode
+    {
+    public:
+        RawMode()
+        {
+            if(!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved) != 0)
+                return;
+            termios raw = saved;
+            raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+            raw.c_iflag &= ~(IXON | ICRNL);
+            raw.c_cc[VMIN] = 0;
+            raw.c_cc[VTIME] = 0;
+            active = tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == 0;
+        }
+        ~RawMode()
+        {
+            if(active)
+                tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved);
+        }
+        RawMode(const RawMode&) = delete;
+        RawMode& operator = (const RawMode&) = delete;
+
+    private:
+        termios saved = {};
+        bool active = false;
+    };
+
+    class Terminal
+    {
+    public:
+        Terminal(const Options& opt);
+
+        // Plays until the player quits
+        void Run();
+        uint64_t BytesSent() const { return bytesSent; }
+        uint64_t TicksPlayed() const { return ticksPlayed; }
+        const TickScheduler& Scheduler() const { return scheduler; }
+        const TurnStats& Turns() const { return turns.Stats(); }
+        const Metrics& GetMetrics() const { return metrics; }
+
+    private:
+        void NewGame();
+        void Tick();
+        // Reads whatever keys are waiting, false on quit
+        bool ReadKeys();
+        void OnKey(char c);
+        void Turn(Snake::Direction d);
+
+        // Measures the terminal, clears it and forgets everything shown so the next Draw sends the whole view
+        void Layout();
+        void Draw();
+        void UpdateViewOrigin();
+        CellKind KindAt(Point p) const;
+        void MoveCursor(uint32_t row, uint32_t col);
+        void Flush();
+
+    private:
+        Options opt;
+        TickScheduler scheduler;
+        Game game;
+        std::unique_ptr<Policy> autopilot;
+        bool useAutopilot = false;
+        bool paused = false;
+        bool over = false;
+        TurnQueue turns;                 // turns pressed, waiting for their ticks
+        uint32_t escapeRead = 0;         // bytes of an arrow key read so far, a read may end inside one
+        Metrics metrics;
+
+        uint32_t viewWidth = 0;          // visible part of the field, in cells
+        uint32_t viewHeight = 0;
+        Point viewOrigin = { 0, 0 };     // field cell shown in the top left corner
+        std::vector<uint8_t> shown;      // CellKind last sent for every view cell
+        std::string status;              // status line last sent
+
+        std::string out;                 // escape codes of the current frame, sent with one write
+        uint32_t cursorRow = 0;          // where the terminal cursor is after out, 0 - unknown
+        uint32_t cursorCol = 0;
+        const char* color = nullptr;     // background last set in out, nullptr - unknown
+
+        uint64_t bytesSent = 0;
+        uint64_t ticksPlayed = 0;
+        uint64_t gamesStarted = 0;
+    };
+
+    // Terminal class methods ------------------------------------------------------------------------------------------------
+    Terminal::Terminal(const Options& opt)
+        : opt(opt), scheduler(SteadyTickClock(), (int64_t)opt.tickMs * 1000000), useAutopilot(opt.autopilot),
+          turns(3 * scheduler.Step())
+    {
+        if(!this->opt.seed)
+            this->opt.seed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+        autopilot = CreatePolicy("autopilot", this->opt.seed);
+        NewGame();
+    }
+    void Terminal::NewGame()
+    {
+        game.Reset(opt.width, opt.height, RandGen(opt.seed, gamesStarted++).Next64());
+        autopilot->Reset();
+        paused = over = false;
+        turns.Clear();
+        scheduler.Restart();
+    }
+    void Terminal::Run()
+    {
+        out = EnterScreen;
+        Layout();
+        Draw();
+        scheduler.Restart();
+        for(;;)
+        {
+            if(quitSignal)
+                return;
+            if(resized)
+            {
+                resized = 0;
+                Layout();
+                Draw();
+            }
+            scheduler.SetPaused(paused || over);
+            if(uint32_t due = scheduler.Due())
+            {
+                metrics[Phase::TickLateness].Record(scheduler.Lateness());
+                metrics.SetTicks(scheduler.Ticks(), scheduler.Dropped());
+                for(; due && !over; --due)
+                    Tick();
+                Draw();
+                continue;
+            }
+            // Paused or over, only a key or a signal wakes it up
+            int64_t wait = scheduler.Wait();
+            int timeout = (wait == TickScheduler::Forever) ? -1 : (int)((wait + 999999) / 1000000);
+            pollfd in = { STDIN_FILENO, POLLIN, 0 };
+            if(poll(&in, 1, timeout) > 0 && !ReadKeys())
+                return;
+        }
+    }
+    void Terminal::Tick()
+    {
+        TraceSpan span("Terminal::Tick");
+        const TickClock& clock = SteadyTickClock();
+        Snake& snake = game.GetSnake();
+        if(useAutopilot)
+            snake.SetDirection(autopilot->Decide(game));
+        else if(turns.Apply(snake, clock.Now()))
+            metrics[Phase::InputToMove].Record(turns.Stats().lastLatencyNs);
+        int64_t start = clock.Now();
+        Game::StepResult res = game.Advance();
+        int64_t moved = clock.Now();
+        metrics[Phase::Simulate].Record(moved - start);
+        if(Trace::Enabled())
+            Trace::Record("Game::Advance", start, moved);
+        if(res == Game::Ate)
+        {
+            game.SpawnFood();
+            int64_t spawned = clock.Now();
+            metrics[Phase::Spawn].Record(spawned - moved);
+            if(Trace::Enabled())
+                Trace::Record("Game::SpawnFood", moved, spawned);
+        }
+        over = res == Game::Died || res == Game::Won;
+        ++ticksPlayed;
+    }
+    bool Terminal::ReadKeys()
+    {
+        TraceSpan span("Terminal::ReadKeys");
+        char buf[64];
+        ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+        if(n == 0)
+            return false;   // end of input
+        for(ssize_t i = 0; i < n; ++i)
+        {
+            char c = buf[i];
+            // Arrows arrive as ESC [ A..D, or ESC O A..D in application cursor mode, and the rest of one cut by the
+            // end of a read comes with the next. An ESC followed by anything else was a key of its own.
+            if(escapeRead == 2)
+            {
+                escapeRead = 0;
+                switch(c)
+                {
+                    case 'A': Turn(Snake::UP); break;
+                    case 'B': Turn(Snake::DOWN); break;
+                    case 'C': Turn(Snake::RIGHT); break;
+                    case 'D': Turn(Snake::LEFT); break;
+                }
+                continue;
+            }
+            if(escapeRead == 1)
+            {
+                escapeRead = c == '[' || c == 'O' ? 2 : 0;
+                if(escapeRead)
+                    continue;
+            }
+            if(c == '\x1b')
+            {
+                escapeRead = 1;
+                continue;
+            }
+            if(c == 'q' || c == 'Q' || c == 3)
+                return false;
+            OnKey(c);
+        }
+        return true;
+    }
+    void Terminal::OnKey(char c)
+    {
+        switch(c)
+        {
+            case 'k': case 'K': Turn(Snake::UP); break;
+            case 'j': case 'J': Turn(Snake::DOWN); break;
+            case 'l': case 'L': Turn(Snake::RIGHT); break;
+            case 'h': case 'H': Turn(Snake::LEFT); break;
+            case 'a': case 'A':
+                useAutopilot = !useAutopilot;
+                autopilot->Reset();
+                Draw();
+                break;
+            case 'p': case 'P':
+                paused = !paused && !over;
+                turns.Clear();
+                Draw();
+                break;
+            case 'n': case 'N':
+                NewGame();
+                Draw();
+                break;
+        }
+    }
+    void Terminal::Turn(Snake::Direction d)
+    {
+        if(!paused && !over && !useAutopilot)
+            turns.Push(d, SteadyTickClock().Now());
+    }
+    void Terminal::Layout()
+    {
+        winsize ws = {};
+        uint32_t cols = 80, rows = 24;
+        if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col && ws.ws_row)
+        {
+            cols = ws.ws_col;
+            rows = ws.ws_row;
+        }
+        // One border column on each side, the border rows and the status line
+        viewWidth = std::min(game.Width(), cols > 4 ? (cols - 2) / 2 : 1);
+        viewHeight = std::min(game.Height(), rows > 4 ? rows - 3 : 1);
+        shown.assign((size_t)viewWidth * viewHeight, UnknownCell);
+        status.clear();
+        viewOrigin = { 0, 0 };
+
+        out += "\x1b[0m\x1b[2J";
+        color = CellColors[EmptyCell];
+        std::string horizontal(2 * viewWidth, '-');
+        MoveCursor(1, 1);
+        out += '+' + horizontal + '+';
+        for(uint32_t y = 0; y < viewHeight; ++y)
+        {
+            MoveCursor(2 + y, 1);
+            out += '|';
+            MoveCursor(2 + y, 2 + 2 * viewWidth);
+            out += '|';
+        }
+        MoveCursor(2 + viewHeight, 1);
+        out += '+' + horizontal + '+';
+        cursorRow = 0;
+    }
+    void Terminal::UpdateViewOrigin()
+    {
+        // Scroll only when the head gets within a quarter of the view from its edge, then centre it
+        Point head = game.GetSnake().GetHead();
+        auto follow = [](int32_t pos, int32_t& origin, uint32_t view, uint32_t field)
+        {
+            if(view >= field)
+            {
+                origin = 0;
+                return;
+            }
+            int32_t margin = (int32_t)view / 4;
+            if(pos - origin < margin || pos - origin >= (int32_t)view - margin)
+                origin = std::min(std::max(pos - (int32_t)view / 2, 0), (int32_t)(field - view));
+        };
+        follow(head.x, viewOrigin.x, viewWidth, game.Width());
+        follow(head.y, viewOrigin.y, viewHeight, game.Height());
+    }
+    CellKind Terminal::KindAt(Point p) const
+    {
+        const Snake& snake = game.GetSnake();
+        if(p == snake.GetHead())
+            return HeadCell;
+        if(snake.IsBody(p))
+            return BodyCell;
+        return p == game.GetFood() ? FoodCell : EmptyCell;
+    }
+    void Terminal::Draw()
+    {
+        int64_t start = SteadyTickClock().Now();
+        UpdateViewOrigin();
+        for(uint32_t y = 0; y < viewHeight; ++y)
+            for(uint32_t x = 0; x < viewWidth; ++x)
+            {
+                CellKind kind = KindAt({ viewOrigin.x + (int32_t)x, viewOrigin.y + (int32_t)y });
+                uint8_t& old = shown[(size_t)y * viewWidth + x];
+                if(kind == old)
+                    continue;
+                old = kind;
+                MoveCursor(2 + y, 2 + 2 * x);
+                if(color != CellColors[kind])
+                {
+                    color = CellColors[kind];
+                    out += color;
+                }
+                out += "  ";
+                cursorCol += 2;
+            }
+
+        char line[160];
+        snprintf(line, sizeof(line), "score %u  length %u  %ux%u  %s%s", game.Score(), game.GetSnake().BodySize(),
+            game.Width(), game.Height(), useAutopilot ? "autopilot  " : "",
+            over ? (game.GetSnake().BodySize() == game.Width() * game.Height() ? "won - N new game, Q quit" : "game over - N new game, Q quit")
+                 : paused ? "paused" : "");
+        if(status != line)
+        {
+            status = line;
+            MoveCursor(3 + viewHeight, 1);
+            if(color != CellColors[EmptyCell])
+            {
+                color = CellColors[EmptyCell];
+                out += color;
+            }
+            out += status;
+            out += "\x1b[K";
+            cursorRow = 0;
+        }
+        Flush();
+        int64_t end = SteadyTickClock().Now();
+        metrics[Phase::Paint].Record(end - start);
+        if(Trace::Enabled())
+            Trace::Record("Terminal::Draw", start, end);
+    }
+    void Terminal::MoveCursor(uint32_t row, uint32_t col)
+    {
+        if(row == cursorRow && col == cursorCol)
+            return;
+        char seq[24];
+        snprintf(seq, sizeof(seq), "\x1b[%u;%uH", row, col);
+        out += seq;
+        cursorRow = row;
+        cursorCol = col;
+    }
+    void Terminal::Flush()
+    {
+        for(size_t done = 0; done < out.size(); )
+        {
+            ssize_t n = write(STDOUT_FILENO, out.data() + done, out.size() - done);
+            if(n < 0 && errno != EINTR)
+                break;
+            if(n > 0)
+                done += (size_t)n;
+        }
+        bytesSent += out.size();
+        out.clear();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if(!ParseOptions(argc, argv, opt))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = OnQuitSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGHUP, &sa, nullptr);
+    sa.sa_handler = OnResize;
+    sigaction(SIGWINCH, &sa, nullptr);
+
+    if(!opt.traceFile.empty())
+    {
+        Trace::NameThread("main");
+        Trace::Start();
+    }
+    Terminal term(opt);
+    MetricsServer server(term.GetMetrics());
+    if(opt.metricsPort && !server.Start(opt.metricsPort))
+    {
+        fprintf(stderr, "can't serve metrics on port %u\n", (unsigned)opt.metricsPort);
+        return 1;
+    }
+    {
+        RawMode raw;
+        term.Run();
+        if(write(STDOUT_FILENO, LeaveScreen, sizeof(LeaveScreen) - 1) < 0)
+            return 1;
+    }
+    uint64_t ticks = term.TicksPlayed();
+    printf("%" PRIu64 " ticks, %" PRIu64 " bytes sent, %.1f bytes per tick\n", ticks, term.BytesSent(),
+        ticks ? (double)term.BytesSent() / ticks : 0.0);
+    const TickScheduler& scheduler = term.Scheduler();
+    printf("tick lateness mean %.2f ms, max %.2f ms, %" PRIu64 " ticks dropped\n", scheduler.Jitter().MeanMs(),
+        scheduler.Jitter().MaxMs(), scheduler.Dropped());
+    const TurnStats& turns = term.Turns();
+    printf("turns applied %" PRIu64 ", ignored %" PRIu64 ", stale %" PRIu64 ", overflowed %" PRIu64 ", key to move mean %.1f ms, max %.1f ms\n",
+        turns.applied, turns.ignored, turns.stale, turns.overflowed, turns.MeanLatencyMs(), turns.MaxLatencyMs());
+    server.Stop();
+    if(!opt.metricsFile.empty() && !term.GetMetrics().WriteFile(opt.metricsFile.c_str()))
+    {
+        fprintf(stderr, "can't write %s\n", opt.metricsFile.c_str());
+        return 1;
+    }
+    if(!opt.traceFile.empty() && !Trace::WriteFile(opt.traceFile.c_str()))
+    {
+        fprintf(stderr, "can't write %s\n", opt.traceFile.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+// BlendOver, with whichever kernel the build targets, against BlendOverReference. Every destination channel value is
+// blended under every source alpha, with source channels spread over [0, alpha], in rows of an odd width so the
+// kernel's tail runs too. Prints the first pixels that differ, exits with 1 if any.
+
+#include "../SnakeCore/Blit.h"
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t RowWidth = 61;
+    constexpr uint32_t MaxReports = 10;  // mismatches printed, the rest are only counted
+
+    int failures = 0;
+
+    void CheckAllPairs()
+    {
+        std::vector<uint32_t> src, dst;
+        for(uint32_t a = 0; a < 256; ++a)
+            for(uint32_t d = 0; d < 256; ++d)
+            {
+                uint32_t b = a * d / 255, g = a - b, r = a * ((d * 7) & 0xFF) / 255;
+                src.push_back(a << 24 | r << 16 | g << 8 | b);
+                dst.push_back(d << 24 | (255 - d) << 16 | d << 8 | (d ^ 0x5A));
+            }
+        uint32_t rows = (uint32_t)(src.size() / RowWidth);
+        std::vector<uint32_t> expected = dst;
+        BlendOver(dst.data(), RowWidth, src.data(), RowWidth, RowWidth, rows);
+        BlendOverReference(expected.data(), RowWidth, src.data(), RowWidth, RowWidth, rows);
+        for(size_t i = 0; i < (size_t)rows * RowWidth; ++i)
+            if(dst[i] != expected[i] && failures++ < (int)MaxReports)
+                printf("blend kernel %s: %08X over gives %08X, the reference %08X\n", BlitKernel(), src[i], dst[i], expected[i]);
+        printf("%u pixels blended by kernel %s checked\n", rows * RowWidth, BlitKernel());
+    }
+}
+
+int main()
+{
+    CheckAllPairs();
+    if(failures)
+        printf("%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
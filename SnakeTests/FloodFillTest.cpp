@@ -0,0 +1,79 @@
+// Every flood fill kernel built for the target against CountReachable, the cell by cell count the engine uses on
+// large fields. 16 games on random fields of up to 32x32, half of them the full Bitboard in one direction or both so
+// the last row and column are used, steered by the autopilot with a random turn now and then so the body folds into
+// pockets. After every tick the region of each free cell next to the head and of a random cell is counted by every
+// kernel and by CountReachable, with the tail free and not. Prints the first mismatches, exits with 1 if any.
+
+#include "../SnakeCore/Bitboard.h"
+#include "../SnakeCore/Planner.h"
+#include <cstdio>
+
+namespace
+{
+    constexpr uint64_t Seed = 1;
+    constexpr uint32_t Games = 16;
+    constexpr uint32_t MaxReports = 10;  // mismatches printed, the rest are only counted
+
+    int failures = 0;
+
+    void CheckKernels()
+    {
+        RandGen rng(Seed, 6);
+        RandomPolicy wander(Seed);
+        Planner planner;
+        const Snake::Direction directions[] = { Snake::UP, Snake::DOWN, Snake::RIGHT, Snake::LEFT };
+        uint64_t checks = 0;
+        for(uint32_t g = 0; g < Games; ++g)
+        {
+            uint32_t width = (g & 1) ? MinWidth + rng.Below(BitboardSize - MinWidth) : BitboardSize;
+            uint32_t height = (g & 2) ? MinHeight + rng.Below(BitboardSize - MinHeight) : BitboardSize;
+            Game game;
+            game.Reset(width, height, rng.Next64());
+            planner.Reset();
+            for(Game::StepResult res = Game::Moved; res != Game::Died && res != Game::Won && game.Ticks() < 4 * width * height; )
+            {
+                const Snake& snake = game.GetSnake();
+                Point starts[5];
+                uint32_t nStarts = 0;
+                for(auto d : directions)
+                    starts[nStarts++] = Snake::Advance(snake.GetHead(), d);
+                starts[nStarts++] = { (int32_t)rng.Below(width), (int32_t)rng.Below(height) };
+                for(uint32_t i = 0; i < nStarts; ++i)
+                    for(bool tailFree : { false, true })
+                    {
+                        Point start = starts[i];
+                        if(start.x < 0 || (uint32_t)start.x >= width || start.y < 0 || (uint32_t)start.y >= height)
+                            continue;
+                        if(snake.IsBody(start) && !(tailFree && start == snake.GetTail()))
+                            continue;
+                        Bitboard free = Bitboard::FreeCells(snake, width, height);
+                        if(tailFree)
+                            free.Set(snake.GetTail());
+                        uint32_t expected = CountReachable(snake, width, height, start, tailFree);
+                        for(uint32_t k = 0; k < FloodFillKernelCount(); ++k)
+                        {
+                            uint32_t count = FloodFill(free, start, k).Count();
+                            ++checks;
+                            if(count != expected && failures++ < (int)MaxReports)
+                                printf("flood fill kernel %s: %u cells reachable from (%d, %d) on %ux%u after %u ticks of game %u, "
+                                    "CountReachable %u\n", FloodFillKernelName(k), count, start.x, start.y, width, height, game.Ticks(), g, expected);
+                        }
+                    }
+                game.GetSnake().SetDirection(rng.Below(8) == 0 ? wander.Decide(game) : planner.Decide(game));
+                res = game.Step();
+            }
+        }
+        printf("%llu counts of kernels", (unsigned long long)checks);
+        for(uint32_t k = 0; k < FloodFillKernelCount(); ++k)
+            printf(" %s", FloodFillKernelName(k));
+        printf(" checked\n");
+    }
+}
+
+int main()
+{
+    CheckKernels();
+    if(failures)
+        printf("%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
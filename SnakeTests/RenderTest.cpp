@@ -0,0 +1,103 @@
+// FieldRenderer updated tick by tick against a fresh full render of the same game. 2000 ticks of play on 8x8, 16x16
+// and 32x32 fields seen whole and on a 64x48 field through a 16x12 view that follows the head, steered by the autopilot
+// with a random turn now and then and started over when a game ends, the food blinking. After every tick each pixel
+// must match the full render, and every pixel that changed must lie in a dirty rectangle. Prints the first mismatch on
+// each field, exits with 1 if any.
+
+#include "../SnakeCore/Render.h"
+#include "../SnakeCore/Planner.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t Seed = 1;
+    constexpr uint32_t Ticks = 2000;
+    constexpr uint32_t BlockSize = 24;  // as in the game
+    constexpr uint32_t BkColor = 0xFFC0C0C0;
+
+    int failures = 0;
+
+    void Check(bool ok, const char* what, int line)
+    {
+        if(!ok)
+        {
+            printf("RenderTest.cpp:%d: %s\n", line, what);
+            ++failures;
+        }
+    }
+#define CHECK(condition) Check(condition, #condition, __LINE__)
+
+    // False on the first pixel that differs or that changed outside the dirty rectangles
+    bool CheckUpdates(uint32_t width, uint32_t height, uint32_t viewWidth, uint32_t viewHeight)
+    {
+        RandGen rng(Seed, 7);
+        RandomPolicy wander(Seed);
+        Planner planner;
+        Game game;
+        game.Reset(width, height, rng.Next64());
+        FieldRenderer renderer(BlockSize, BkColor), fresh(BlockSize, BkColor);
+        renderer.SetView(viewWidth, viewHeight);
+        fresh.SetView(viewWidth, viewHeight);
+        std::vector<uint32_t> before;
+        for(uint32_t tick = 0; tick < Ticks; ++tick)
+        {
+            Point head = game.GetSnake().GetHead();
+            Point origin = { std::min(std::max(head.x - (int32_t)viewWidth / 2, 0), (int32_t)(width - viewWidth)),
+                             std::min(std::max(head.y - (int32_t)viewHeight / 2, 0), (int32_t)(height - viewHeight)) };
+            bool showFood = (tick / 3) % 4 != 0;
+            before.assign(renderer.Pixels(), renderer.Pixels() + renderer.PixelWidth() * renderer.PixelHeight());
+            renderer.ClearDirty();
+            renderer.Update(game, origin, showFood);
+            fresh.Invalidate();
+            fresh.Update(game, origin, showFood);
+
+            size_t rowBytes = renderer.PixelWidth() * sizeof(uint32_t);
+            for(uint32_t y = 0; y < renderer.PixelHeight(); ++y)
+            {
+                const uint32_t* row = renderer.Pixels() + (size_t)y * renderer.PixelWidth();
+                if(!memcmp(row, fresh.Pixels() + (size_t)y * renderer.PixelWidth(), rowBytes)
+                    && (!tick || !memcmp(row, &before[(size_t)y * renderer.PixelWidth()], rowBytes)))
+                    continue;
+                for(uint32_t x = 0; x < renderer.PixelWidth(); ++x)
+                {
+                    size_t i = (size_t)y * renderer.PixelWidth() + x;
+                    const char* problem = nullptr;
+                    if(renderer.Pixels()[i] != fresh.Pixels()[i])
+                        problem = "differs from a full render";
+                    else if(tick && renderer.Pixels()[i] != before[i] && std::none_of(renderer.Dirty().begin(), renderer.Dirty().end(),
+                        [&](const PixelRect& r) { return x >= r.left && x < r.right && y >= r.top && y < r.bottom; }))
+                        problem = "changed outside the dirty rectangles";
+                    if(problem)
+                    {
+                        printf("pixel (%u, %u) of the %ux%u view at (%d, %d) of %ux%u %s after tick %u\n",
+                            x, y, viewWidth, viewHeight, origin.x, origin.y, width, height, problem, tick);
+                        return false;
+                    }
+                }
+            }
+
+            game.GetSnake().SetDirection(rng.Below(8) == 0 ? wander.Decide(game) : planner.Decide(game));
+            Game::StepResult res = game.Step();
+            if(res == Game::Died || res == Game::Won)
+            {
+                planner.Reset();
+                game.Reset(width, height, rng.Next64());
+            }
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    CHECK(CheckUpdates(8, 8, 8, 8));
+    CHECK(CheckUpdates(16, 16, 16, 16));
+    CHECK(CheckUpdates(32, 32, 32, 32));
+    CHECK(CheckUpdates(64, 48, 16, 12));
+    if(failures)
+        printf("%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
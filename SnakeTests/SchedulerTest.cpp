@@ -0,0 +1,181 @@
+// TickScheduler driven by a clock set by hand: ticks on the grid of whole steps, ticks plus dropped against the steps
+// elapsed under maxBurst, pausing and resuming, lateness and jitter. Prints every failed check, exits with 1 if any.
+
+#include "../SnakeCore/Scheduler.h"
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    constexpr int64_t Ms = 1000000;
+    constexpr int64_t StepNs = 10 * Ms;
+
+    class ManualClock : public TickClock
+    {
+    public:
+        int64_t Now() const override { return now; }
+        void Advance(int64_t ns) { now += ns; }
+
+    private:
+        int64_t now = 1000 * Ms;  // any origin, not 0
+    };
+
+    int failures = 0;
+
+    void Check(bool ok, const char* what, int line)
+    {
+        if(!ok)
+        {
+            printf("SchedulerTest.cpp:%d: %s\n", line, what);
+            ++failures;
+        }
+    }
+#define CHECK(condition) Check(condition, #condition, __LINE__)
+
+    void TicksOverSteps()
+    {
+        ManualClock clock;
+        TickScheduler scheduler(clock, StepNs);
+        const uint32_t steps = 1000;
+        uint32_t run = 0;
+        for(uint32_t i = 0; i < steps; ++i)
+        {
+            CHECK(scheduler.Wait() == StepNs);
+            clock.Advance(StepNs / 2);
+            CHECK(scheduler.Due() == 0);
+            CHECK(scheduler.Wait() == StepNs / 2);
+            clock.Advance(StepNs / 2);
+            CHECK(scheduler.Wait() == 0);
+            run += scheduler.Due();
+            CHECK(scheduler.Lateness() == 0);
+        }
+        CHECK(run == steps);
+        CHECK(scheduler.Ticks() == steps);
+        CHECK(scheduler.Dropped() == 0);
+    }
+
+    void TicksAndDroppedUnderBurst()
+    {
+        // Irregular waits and stalls of many steps, ticks plus dropped always match the whole steps elapsed
+        const uint32_t maxBursts[] = { 1, 3, 8 };
+        for(uint32_t maxBurst : maxBursts)
+        {
+            ManualClock clock;
+            TickScheduler scheduler(clock, StepNs, maxBurst);
+            int64_t start = clock.Now();
+            uint64_t seed = 12345, run = 0;
+            for(int i = 0; i < 10000; ++i)
+            {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                uint64_t r = seed >> 33;
+                clock.Advance(r % 8 == 0 ? (int64_t)(r % (20 * StepNs)) : (int64_t)(r % StepNs));
+                uint32_t due = scheduler.Due();
+                CHECK(due <= maxBurst);
+                run += due;
+                CHECK(scheduler.Ticks() + scheduler.Dropped() == (uint64_t)((clock.Now() - start) / StepNs));
+                CHECK(scheduler.Wait() > 0 && scheduler.Wait() <= StepNs);
+            }
+            CHECK(run == scheduler.Ticks());
+            CHECK(scheduler.Dropped() > 0);
+        }
+    }
+
+    void Paused()
+    {
+        ManualClock clock;
+        TickScheduler scheduler(clock, StepNs);
+        clock.Advance(StepNs);
+        CHECK(scheduler.Due() == 1);
+        scheduler.SetPaused(true);
+        CHECK(scheduler.Paused());
+        CHECK(scheduler.Wait() == TickScheduler::Forever);
+        clock.Advance(100 * StepNs);
+        CHECK(scheduler.Wait() == TickScheduler::Forever);
+        CHECK(scheduler.Due() == 0);
+        CHECK(scheduler.Ticks() == 1);
+        CHECK(scheduler.Dropped() == 0);
+    }
+
+    void ResumeRestartsGrid()
+    {
+        ManualClock clock;
+        TickScheduler scheduler(clock, StepNs);
+        clock.Advance(StepNs);
+        CHECK(scheduler.Due() == 1);
+        clock.Advance(StepNs / 4);
+        scheduler.SetPaused(true);
+        clock.Advance(5 * StepNs / 2);
+        scheduler.SetPaused(false);
+        // The first tick is a whole step after resuming, off the old grid and with nothing dropped for the pause
+        CHECK(!scheduler.Paused());
+        CHECK(scheduler.Wait() == StepNs);
+        clock.Advance(StepNs - 1);
+        CHECK(scheduler.Due() == 0);
+        clock.Advance(1);
+        CHECK(scheduler.Due() == 1);
+        CHECK(scheduler.Lateness() == 0);
+        CHECK(scheduler.Ticks() == 2);
+        CHECK(scheduler.Dropped() == 0);
+
+        // Restart does the same without pausing
+        clock.Advance(StepNs / 3);
+        scheduler.Restart();
+        CHECK(scheduler.Wait() == StepNs);
+        clock.Advance(StepNs);
+        CHECK(scheduler.Due() == 1);
+        CHECK(scheduler.Lateness() == 0);
+    }
+
+    void LatenessAndJitter()
+    {
+        ManualClock clock;
+        TickScheduler scheduler(clock, StepNs, 2);
+        int64_t start = clock.Now();
+        clock.Advance(StepNs + 3 * Ms);
+        CHECK(scheduler.Due() == 1);
+        CHECK(scheduler.Lateness() == 3 * Ms);
+        // Lateness doesn't move the grid: the next tick is due at two steps from the start
+        CHECK(scheduler.Wait() == start + 2 * StepNs - clock.Now());
+        clock.Advance(StepNs - 2 * Ms);
+        CHECK(scheduler.Due() == 1);
+        CHECK(scheduler.Lateness() == 1 * Ms);
+        // A Due that hands out nothing keeps the last lateness and adds no sample
+        CHECK(scheduler.Due() == 0);
+        CHECK(scheduler.Lateness() == 1 * Ms);
+
+        const TickJitter& jitter = scheduler.Jitter();
+        CHECK(jitter.samples == 2);
+        CHECK(jitter.totalNs == 4 * Ms);
+        CHECK(jitter.maxNs == 3 * Ms);
+        CHECK(std::fabs(jitter.MeanMs() - 2.0) < 1e-9);
+        CHECK(std::fabs(jitter.MaxMs() - 3.0) < 1e-9);
+
+        // A stall of three steps past the tick at two steps: two run, one dropped, late from the first deadline missed
+        clock.Advance(start + 5 * StepNs + 7 * Ms - clock.Now());
+        CHECK(scheduler.Due() == 2);
+        CHECK(scheduler.Dropped() == 1);
+        CHECK(scheduler.Lateness() == 2 * StepNs + 7 * Ms);
+        CHECK(scheduler.Wait() == start + 6 * StepNs - clock.Now());
+        CHECK(jitter.samples == 3);
+        CHECK(jitter.maxNs == 2 * StepNs + 7 * Ms);
+
+        scheduler.ResetJitter();
+        CHECK(scheduler.Jitter().samples == 0);
+        CHECK(scheduler.Jitter().totalNs == 0);
+        CHECK(scheduler.Jitter().maxNs == 0);
+        CHECK(scheduler.Jitter().MeanMs() == 0.0);
+    }
+}
+
+int main()
+{
+    TicksOverSteps();
+    TicksAndDroppedUnderBurst();
+    Paused();
+    ResumeRestartsGrid();
+    LatenessAndJitter();
+    if(failures)
+        printf("%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+// TaskPool under many short Submit and Wait rounds, after which every worker must still be running: as many tasks
+// as workers are submitted and each waits until all of them have started, which only live workers can do. Also
+// checks that every task ran once, tasks submitted by tasks included. Prints every failed check, exits with 1 if any.
+
+#include "../SnakeCore/TaskPool.h"
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    int failures = 0;
+
+    void Check(bool ok, const char* what, int line)
+    {
+        if(!ok)
+        {
+            printf("TaskPoolTest.cpp:%d: %s\n", line, what);
+            ++failures;
+        }
+    }
+#define CHECK(condition) Check(condition, #condition, __LINE__)
+
+    // True if all workers of the pool take a task at the same time within a few seconds
+    bool AllWorkersAlive(TaskPool& pool)
+    {
+        std::mutex lock;
+        std::condition_variable started;
+        uint32_t running = 0;
+        bool all = true;
+        for(uint32_t i = 0; i < pool.Size(); ++i)
+            pool.Submit([&](uint32_t)
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if(++running == pool.Size())
+                    started.notify_all();
+                else if(!started.wait_for(guard, std::chrono::seconds(5), [&] { return running == pool.Size(); }))
+                    all = false;
+            });
+        // With a worker gone the tasks left over never run and Wait would not return, so wait here with a limit
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if(!started.wait_for(guard, std::chrono::seconds(10), [&] { return running == pool.Size(); }))
+                return false;
+        }
+        pool.Wait();
+        return all;
+    }
+
+    void WorkersOutliveRounds(uint32_t nThreads)
+    {
+        TaskPool pool(nThreads);
+        std::atomic<uint64_t> ran{ 0 };
+        uint64_t submitted = 0;
+        for(uint32_t round = 0; round < 200000; ++round)
+        {
+            uint32_t n = 1 + round % 3;
+            for(uint32_t i = 0; i < n; ++i)
+            {
+                bool nested = (round + i) % 7 == 0;
+                pool.Submit([&pool, &ran, nested](uint32_t)
+                {
+                    ++ran;
+                    if(nested)
+                        pool.Submit([&ran](uint32_t) { ++ran; });
+                });
+                submitted += nested ? 2 : 1;
+            }
+            pool.Wait();
+            if(round % 500 == 0 && !AllWorkersAlive(pool))
+            {
+                Check(false, "every worker still running after Submit and Wait rounds", __LINE__);
+                return;
+            }
+        }
+        CHECK(ran == submitted);
+        CHECK(AllWorkersAlive(pool));
+    }
+}
+
+int main()
+{
+    WorkersOutliveRounds(2);
+    WorkersOutliveRounds(4);
+    WorkersOutliveRounds(8);
+    if(failures)
+        printf("%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}